@@ -0,0 +1,536 @@
+#include "arrowwriter.h"
+#include <algorithm>
+#include <charconv>
+
+#include <common/log.h>
+#include <common/utf8util.h>
+
+extern const char * LOG_FILE;
+#define LOG_SOURCE_FILE "arrowwriter.cpp"
+
+#define MAX_BATCH_VAR_SIZE (64 * 1024 * 1024)	// int32 offsets, limits memory for long texts
+
+// Arrow format constants (Schema.fbs, Message.fbs)
+#define ARROW_MAGIC "ARROW1"
+#define ARROW_CONTINUATION 0xffffffff
+#define ARROW_METADATA_V5 4
+#define ARROW_HEADER_SCHEMA 1
+#define ARROW_HEADER_RECORD_BATCH 3
+#define ARROW_TYPE_INT 2
+#define ARROW_TYPE_FLOATING_POINT 3
+#define ARROW_TYPE_BINARY 4
+#define ARROW_TYPE_UTF8 5
+#define ARROW_PRECISION_DOUBLE 2
+
+namespace {
+
+// Minimal flatbuffers builder: buffer grows from end to start, so
+// objects are created before objects referencing them (as in flatc builder).
+class fb_builder {
+public:
+	fb_builder() : buf(256), head(256), minalign(1), table_start(0) {}
+
+	// offset of last created object (from buffer end)
+	uint32_t size() const { return static_cast<uint32_t>(buf.size() - head); }
+
+	template<typename T> void push(const T val)
+	{
+		reserve(sizeof(T));
+		head -= sizeof(T);
+		memcpy(&buf[head], &val, sizeof(T));	// little endian hosts only
+	}
+
+	void push_bytes(const void * data, const size_t len)
+	{
+		reserve(len);
+		head -= len;
+		if( len )
+			memcpy(&buf[head], data, len);
+	}
+
+	// pad so that after writing extra bytes the size is aligned
+	void align(const size_t alignment, const size_t extra = 0)
+	{
+		minalign = std::max(minalign, alignment);
+		while( (size() + extra) % alignment )
+			push<uint8_t>(0);
+	}
+
+	uint32_t create_string(const std::string & str)
+	{
+		align(4, str.length() + 1);
+		push<uint8_t>(0);
+		push_bytes(str.data(), str.length());
+		push<uint32_t>(static_cast<uint32_t>(str.length()));
+		return size();
+	}
+
+	uint32_t create_offsets(const std::vector<uint32_t> & offs)
+	{
+		align(4, offs.size() * 4);
+		for( auto it = offs.rbegin(); it != offs.rend(); ++it )
+			push<uint32_t>(size() + 4 - *it);
+		push<uint32_t>(static_cast<uint32_t>(offs.size()));
+		return size();
+	}
+
+	// vector of structs (elements are aligned to 8)
+	uint32_t create_structs(const void * data, const size_t elem_size, const size_t count)
+	{
+		align(8, elem_size * count);
+		push_bytes(data, elem_size * count);
+		align(4);
+		push<uint32_t>(static_cast<uint32_t>(count));
+		return size();
+	}
+
+	void start_table()
+	{
+		fields.clear();
+		table_start = size();
+	}
+
+	template<typename T> void add(const uint16_t id, const T val)
+	{
+		align(sizeof(T));
+		push<T>(val);
+		fields.emplace_back(id, size());
+	}
+
+	void add_offset(const uint16_t id, const uint32_t off)
+	{
+		align(4);
+		push<uint32_t>(size() + 4 - off);
+		fields.emplace_back(id, size());
+	}
+
+	uint32_t end_table()
+	{
+		align(4);
+		push<int32_t>(0);	// vtable offset, patched below
+		const uint32_t table = size();
+
+		uint16_t max_id = 0;
+		for( const auto & f : fields )
+			max_id = std::max(max_id, static_cast<uint16_t>(f.first + 1));
+		std::vector<uint16_t> vt(max_id, 0);
+		for( const auto & f : fields )
+			vt[f.first] = static_cast<uint16_t>(table - f.second);
+		for( auto it = vt.rbegin(); it != vt.rend(); ++it )
+			push<uint16_t>(*it);
+		push<uint16_t>(static_cast<uint16_t>(table - table_start));
+		push<uint16_t>(static_cast<uint16_t>(4 + 2 * vt.size()));
+		const int32_t vt_off = static_cast<int32_t>(size() - table);
+		memcpy(&buf[buf.size() - table], &vt_off, sizeof(vt_off));
+		return table;
+	}
+
+	// finish with root table, result is padded to 8 bytes
+	std::string finish(const uint32_t root)
+	{
+		align(std::max(minalign, static_cast<size_t>(8)), 4);
+		push<uint32_t>(size() + 4 - root);
+		return std::string(reinterpret_cast<const char *>(&buf[head]), size());
+	}
+
+private:
+	void reserve(const size_t len)
+	{
+		if( head >= len )
+			return;
+		const size_t used = size();
+		size_t new_size = buf.size() * 2;
+		while( new_size - used < len )
+			new_size *= 2;
+		std::vector<uint8_t> nbuf(new_size);
+		memcpy(&nbuf[new_size - used], &buf[head], used);
+		buf.swap(nbuf);
+		head = new_size - used;
+	}
+
+	std::vector<uint8_t> buf;
+	size_t head;
+	size_t minalign;
+	uint32_t table_start;
+	std::vector<std::pair<uint16_t, uint32_t>> fields;	///< Field id, offset
+};
+
+uint32_t build_schema(fb_builder & b, const SQLiteDB::sq_columns & columns, const std::vector<ArrowWriter::column_type> & types)
+{
+	std::vector<uint32_t> fields;
+	for( size_t i = 0; i < columns.size(); ++i ) {
+		const uint32_t name = b.create_string(columns[i].name);
+		uint8_t type_type;
+		b.start_table();
+		switch( types[i] ) {
+		case ArrowWriter::at_int64:
+			type_type = ARROW_TYPE_INT;
+			b.add<int32_t>(0, 64);		// bitWidth
+			b.add<uint8_t>(1, 1);		// is_signed
+			break;
+		case ArrowWriter::at_double:
+			type_type = ARROW_TYPE_FLOATING_POINT;
+			b.add<int16_t>(0, ARROW_PRECISION_DOUBLE);
+			break;
+		case ArrowWriter::at_utf8:
+			type_type = ARROW_TYPE_UTF8;
+			break;
+		default:
+			type_type = ARROW_TYPE_BINARY;
+			break;
+		}
+		const uint32_t type = b.end_table();
+		// readers expect children vector even for primitive types
+		const uint32_t children = b.create_offsets(std::vector<uint32_t>());
+
+		b.start_table();
+		b.add_offset(0, name);
+		b.add<uint8_t>(1, 1);			// nullable
+		b.add<uint8_t>(2, type_type);	// type union type
+		b.add_offset(3, type);
+		b.add_offset(5, children);
+		fields.push_back(b.end_table());
+	}
+	const uint32_t fields_vec = b.create_offsets(fields);
+
+	b.start_table();
+	b.add<int16_t>(0, 0);	// little endian
+	b.add_offset(1, fields_vec);
+	return b.end_table();
+}
+
+std::string build_message(fb_builder & b, const uint8_t header_type, const uint32_t header, const int64_t body_len)
+{
+	b.start_table();
+	b.add<int64_t>(3, body_len);
+	b.add<int16_t>(0, ARROW_METADATA_V5);
+	b.add<uint8_t>(1, header_type);
+	b.add_offset(2, header);
+	return b.finish(b.end_table());
+}
+
+//! Column affinity by declared type (https://www.sqlite.org/datatype3.html#determination_of_column_affinity)
+enum column_affinity {
+	aff_integer,
+	aff_text,
+	aff_blob,
+	aff_real,
+	aff_numeric
+};
+
+column_affinity affinity(const std::string & decl_type)
+{
+	const char * t = decl_type.c_str();
+	if( StrCiStr(t, "INT") )
+		return aff_integer;
+	if( StrCiStr(t, "CHAR") || StrCiStr(t, "CLOB") || StrCiStr(t, "TEXT") )
+		return aff_text;
+	if( !t[0] || StrCiStr(t, "BLOB") )
+		return aff_blob;
+	if( StrCiStr(t, "REAL") || StrCiStr(t, "FLOA") || StrCiStr(t, "DOUB") )
+		return aff_real;
+	return aff_numeric;
+}
+
+// integers up to 2^53 are exact in double
+#define MAX_EXACT_DOUBLE_INT (int64_t(1) << 53)
+
+inline void append_padded(std::string & body, const void * data, const size_t len)
+{
+	body.append(static_cast<const char *>(data), len);
+	body.append((8 - len % 8) % 8, '\0');
+}
+
+}
+
+ArrowWriter::ArrowWriter(BufferedWriter & _out, const SQLiteDB::sq_columns & _columns, size_t _batch_rows):
+	out(_out),
+	columns(_columns),
+	batch_rows(_batch_rows),
+	data(_columns.size()),
+	rows(0),
+	written(0),
+	var_size(0),
+	started(false)
+{
+}
+
+bool ArrowWriter::ScanClasses(sqlite3 * db, const std::string & query)
+{
+	// columns are renamed by position (names may repeat in view), sum of
+	// distinct bits is their union, typeof() doesn't load text and blob values
+	std::string names, scan;
+	for( size_t i = 0; i < columns.size(); ++i ) {
+		const std::string name = "c" + std::to_string(i);
+		if( i ) {
+			names += ',';
+			scan += ',';
+		}
+		names += name;
+		scan += "sum(DISTINCT CASE typeof(" + name + ")"
+			" WHEN 'integer' THEN CASE WHEN " + name + " BETWEEN " + std::to_string(-MAX_EXACT_DOUBLE_INT) + " AND " + std::to_string(MAX_EXACT_DOUBLE_INT) +
+				" THEN " + std::to_string(cb_int) + " ELSE " + std::to_string(cb_bigint) + " END"
+			" WHEN 'real' THEN " + std::to_string(cb_float) +
+			" WHEN 'text' THEN " + std::to_string(cb_text) +
+			" WHEN 'blob' THEN " + std::to_string(cb_blob) + " END)";
+	}
+	scan = "with q(" + names + ") as (" + query + ") select " + scan + " from q";
+
+	sqlite_statement stmt(db);
+	if( stmt.prepare(scan.c_str()) != SQLITE_OK || stmt.step_execute() != SQLITE_ROW ) {
+		LOG_ERROR("Unable to scan storage classes: %s\n", sqlite3_errmsg(db));
+		return false;
+	}
+	classes.resize(columns.size());
+	for( size_t i = 0; i < columns.size(); ++i )
+		classes[i] = static_cast<unsigned>(stmt.get_int64(static_cast<int>(i)));
+	return true;
+}
+
+bool ArrowWriter::AddRow(const sqlite_statement & stmt)
+{
+	for( int i = 0; i < static_cast<int>(data.size()); ++i ) {
+		column_data & col = data[i];
+		const int cls = stmt.column_type(i);
+		col.cls.push_back(static_cast<unsigned char>(cls));
+		int64_t fixed = 0;
+		if( cls == SQLITE_INTEGER )
+			fixed = stmt.get_int64(i);
+		else if( cls == SQLITE_FLOAT ) {
+			const double val = stmt.get_double(i);
+			memcpy(&fixed, &val, sizeof(fixed));
+		} else if( cls == SQLITE_TEXT || cls == SQLITE_BLOB ) {
+			const void * ptr = cls == SQLITE_TEXT ? static_cast<const void *>(stmt.get_text(i)) : stmt.get_blob(i);
+			const size_t len = stmt.get_length(i);
+			if( len )
+				col.var.append(static_cast<const char *>(ptr), len);
+			var_size += len;
+		}
+		col.fixed.push_back(fixed);
+		col.var_end.push_back(static_cast<uint32_t>(col.var.length()));
+	}
+	if( ++rows >= batch_rows || var_size >= MAX_BATCH_VAR_SIZE )
+		return WriteBatch();
+	return true;
+}
+
+void ArrowWriter::ChooseTypes(void)
+{
+	// declared affinity first, storage classes of all values (or of first batch
+	// if they weren't scanned) only widen it: values which still don't fit
+	// chosen type fail export instead of silent conversion
+	types.resize(columns.size());
+	for( size_t i = 0; i < columns.size(); ++i ) {
+		unsigned cls_bits = 0;
+		if( i < classes.size() )
+			cls_bits = classes[i];
+		else {
+			for( size_t r = 0; r < data[i].cls.size(); ++r ) {
+				const unsigned char cls = data[i].cls[r];
+				if( cls == SQLITE_INTEGER ) {
+					const int64_t val = data[i].fixed[r];
+					cls_bits |= val < -MAX_EXACT_DOUBLE_INT || val > MAX_EXACT_DOUBLE_INT ? cb_bigint : cb_int;
+				}
+				else if( cls == SQLITE_FLOAT )
+					cls_bits |= cb_float;
+				else if( cls == SQLITE_TEXT )
+					cls_bits |= cb_text;
+				else if( cls == SQLITE_BLOB )
+					cls_bits |= cb_blob;
+			}
+		}
+		const bool has_float = (cls_bits & cb_float) != 0;
+		const bool has_bigint = (cls_bits & cb_bigint) != 0;
+		const column_affinity aff = affinity(columns[i].decl_type);
+		if( cls_bits & cb_blob )
+			types[i] = at_binary;
+		else if( (cls_bits & cb_text) || aff == aff_text || (has_float && has_bigint) )
+			types[i] = at_utf8;	// decimal text keeps both big integers and fractions
+		else if( aff == aff_integer || has_bigint )
+			types[i] = has_float ? at_double : at_int64;
+		else if( cls_bits || aff == aff_real || aff == aff_numeric )
+			types[i] = at_double;
+		else	// no affinity and no values: declared BLOB or expression
+			types[i] = columns[i].decl_type.empty() ? at_utf8 : at_binary;
+	}
+}
+
+bool ArrowWriter::ConversionError(const size_t col, const size_t row, const unsigned char cls)
+{
+	static const char * const class_names[] = { "", "INTEGER", "REAL", "TEXT", "BLOB", "NULL" };
+	static const char * const type_names[] = { "int64", "double", "utf8", "binary" };
+	char buf[256];
+	sqlite3_snprintf(sizeof(buf), buf, "row %llu: %s value can't be stored in %s column without loss",
+		static_cast<unsigned long long>(written + row + 1), class_names[cls], type_names[types[col]]);
+	const std::string msg = columns[col].name + ", " + buf;
+	error.resize(msg.length());
+	error.resize(Utf8ToWideChar(msg.c_str(), msg.length(), &error[0], 1));
+	LOG_ERROR("%s\n", msg.c_str());
+	return false;
+}
+
+bool ArrowWriter::WriteMessage(const std::string & meta, const std::string & body, block * blk)
+{
+	if( blk ) {
+		blk->offset = static_cast<int64_t>(out.Written());
+		blk->meta_len = static_cast<int32_t>(8 + meta.length());
+		blk->body_len = static_cast<int64_t>(body.length());
+	}
+	const uint32_t prefix[2] = { ARROW_CONTINUATION, static_cast<uint32_t>(meta.length()) };
+	return out.Write(prefix, sizeof(prefix)) && out.Write(meta) && out.Write(body);
+}
+
+bool ArrowWriter::WriteBatch(void)
+{
+	if( !started ) {
+		ChooseTypes();
+		if( !out.Write(ARROW_MAGIC "\0\0", 8) )
+			return false;
+		fb_builder b;
+		const uint32_t schema = build_schema(b, columns, types);
+		if( !WriteMessage(build_message(b, ARROW_HEADER_SCHEMA, schema, 0), std::string(), nullptr) )
+			return false;
+		started = true;
+	}
+	if( !rows )
+		return true;
+
+	struct field_node { int64_t length; int64_t null_count; };
+	struct buffer { int64_t offset; int64_t length; };
+	std::vector<field_node> nodes;
+	std::vector<buffer> buffers;
+	std::string body;
+	std::vector<uint8_t> validity((rows + 7) / 8);
+	std::vector<int64_t> fixed(rows);
+	std::vector<int32_t> offsets(rows + 1);
+	std::string var;
+	char num[32];
+	error.clear();
+
+	auto add_buffer = [&](const void * ptr, const size_t len) {
+		buffers.push_back({ static_cast<int64_t>(body.length()), static_cast<int64_t>(len) });
+		append_padded(body, ptr, len);
+	};
+
+	for( size_t i = 0; i < data.size(); ++i ) {
+		column_data & col = data[i];
+		const bool var_type = types[i] == at_utf8 || types[i] == at_binary;
+		std::fill(validity.begin(), validity.end(), 0);
+		int64_t null_count = 0;
+		var.clear();
+		offsets[0] = 0;
+		for( size_t r = 0; r < rows; ++r ) {
+			const unsigned char cls = col.cls[r];
+			const char * var_ptr = col.var.data() + (r ? col.var_end[r - 1] : 0);
+			const size_t var_len = col.var_end[r] - (r ? col.var_end[r - 1] : 0);
+			double dval;
+			memcpy(&dval, &col.fixed[r], sizeof(dval));
+			bool valid = cls != SQLITE_NULL;
+
+			// values with other storage class than column type are converted only if it is exact
+			if( var_type ) {
+				if( cls == SQLITE_INTEGER )
+					var += std::to_string(col.fixed[r]);
+				else if( cls == SQLITE_FLOAT ) {
+					// shortest representation which reads back to the same double
+					const std::to_chars_result res = std::to_chars(num, num + sizeof(num), dval);
+					var.append(num, res.ptr);
+				} else if( cls == SQLITE_BLOB && types[i] == at_utf8 )
+					return ConversionError(i, r, cls);
+				else if( valid )
+					var.append(var_ptr, var_len);
+				offsets[r + 1] = static_cast<int32_t>(var.length());
+			} else if( types[i] == at_int64 ) {
+				fixed[r] = 0;
+				if( cls == SQLITE_INTEGER )
+					fixed[r] = col.fixed[r];
+				else if( cls == SQLITE_FLOAT ) {
+					// -2^63 <= dval < 2^63 and no fraction
+					if( !(dval >= -9223372036854775808.0 && dval < 9223372036854775808.0) || static_cast<double>(static_cast<int64_t>(dval)) != dval )
+						return ConversionError(i, r, cls);
+					fixed[r] = static_cast<int64_t>(dval);
+				} else if( valid )
+					return ConversionError(i, r, cls);
+			} else {
+				double val = 0;
+				if( cls == SQLITE_INTEGER ) {
+					if( col.fixed[r] < -MAX_EXACT_DOUBLE_INT || col.fixed[r] > MAX_EXACT_DOUBLE_INT )
+						return ConversionError(i, r, cls);
+					val = static_cast<double>(col.fixed[r]);
+				} else if( cls == SQLITE_FLOAT )
+					val = dval;
+				else if( valid )
+					return ConversionError(i, r, cls);
+				memcpy(&fixed[r], &val, sizeof(val));
+			}
+			if( valid )
+				validity[r / 8] |= static_cast<uint8_t>(1 << (r % 8));
+			else
+				++null_count;
+		}
+
+		nodes.push_back({ static_cast<int64_t>(rows), null_count });
+		// validity bitmap may be omitted if there are no nulls
+		add_buffer(validity.data(), null_count ? validity.size() : 0);
+		if( var_type ) {
+			add_buffer(offsets.data(), (rows + 1) * sizeof(int32_t));
+			add_buffer(var.data(), var.length());
+		} else
+			add_buffer(fixed.data(), rows * sizeof(int64_t));
+
+		col.cls.clear();
+		col.fixed.clear();
+		col.var_end.clear();
+		col.var.clear();
+	}
+
+	fb_builder b;
+	const uint32_t nodes_vec = b.create_structs(nodes.data(), sizeof(field_node), nodes.size());
+	const uint32_t buffers_vec = b.create_structs(buffers.data(), sizeof(buffer), buffers.size());
+	b.start_table();
+	b.add<int64_t>(0, static_cast<int64_t>(rows));
+	b.add_offset(1, nodes_vec);
+	b.add_offset(2, buffers_vec);
+	const uint32_t batch = b.end_table();
+
+	block blk;
+	if( !WriteMessage(build_message(b, ARROW_HEADER_RECORD_BATCH, batch, static_cast<int64_t>(body.length())), body, &blk) )
+		return false;
+	batches.push_back(blk);
+	written += rows;
+	rows = 0;
+	var_size = 0;
+	return true;
+}
+
+bool ArrowWriter::Finish(void)
+{
+	if( !WriteBatch() )
+		return false;
+
+	// end of stream
+	const uint32_t eos[2] = { ARROW_CONTINUATION, 0 };
+	if( !out.Write(eos, sizeof(eos)) )
+		return false;
+
+	// footer: schema and record batches positions
+	struct footer_block { int64_t offset; int32_t meta_len; int32_t pad; int64_t body_len; };
+	std::vector<footer_block> blocks;
+	for( const auto & blk : batches )
+		blocks.push_back({ blk.offset, blk.meta_len, 0, blk.body_len });
+
+	fb_builder b;
+	const uint32_t schema = build_schema(b, columns, types);
+	const uint32_t dictionaries = b.create_structs(nullptr, sizeof(footer_block), 0);
+	const uint32_t record_batches = b.create_structs(blocks.data(), sizeof(footer_block), blocks.size());
+	b.start_table();
+	b.add<int16_t>(0, ARROW_METADATA_V5);
+	b.add_offset(1, schema);
+	b.add_offset(2, dictionaries);
+	b.add_offset(3, record_batches);
+	const std::string footer = b.finish(b.end_table());
+
+	const int32_t footer_len = static_cast<int32_t>(footer.length());
+	LOG_INFO("%u record batches\n", static_cast<unsigned>(batches.size()));
+	return out.Write(footer) && out.Write(&footer_len, sizeof(footer_len)) && out.Write(ARROW_MAGIC, 6);
+}
@@ -0,0 +1,105 @@
+#ifndef __ARROWWRITER_H__
+#define __ARROWWRITER_H__
+
+#include "bufwriter.h"
+#include "sqlite/sqlitedb.h"
+#include <vector>
+#include <string>
+
+// Arrow IPC file writer (columnar format, metadata V5) without external
+// dependencies. Rows are collected to record batches with typed column buffers,
+// memory use is limited by batch size.
+class ArrowWriter {
+public:
+	//! Arrow column types.
+	enum column_type {
+		at_int64,
+		at_double,
+		at_utf8,
+		at_binary
+	};
+
+	/**
+	 * Read storage classes of all query values before the first row is added,
+	 * so column types don't depend on the first batch only.
+	 * \param db database
+	 * \param query select query of exported rows
+	 * \return false on read error (types are chosen by the first batch)
+	 */
+	bool ScanClasses(sqlite3 * db, const std::string & query);
+
+	/**
+	 * Add row, full batch is written to file.
+	 * \param stmt statement with current row
+	 * \return false on write error or if value can't be stored in column type without loss
+	 */
+	bool AddRow(const sqlite_statement & stmt);
+
+	/**
+	 * Write last batch and file footer.
+	 * \return false on write error or if value can't be stored in column type without loss
+	 */
+	bool Finish(void);
+
+	/**
+	 * Get conversion error description.
+	 * \return error text, empty if last fail was write error
+	 */
+	const std::wstring & Error(void) const { return error; }
+
+	/**
+	 * Constructor.
+	 * \param out output file
+	 * \param columns columns description (declared affinity, storage classes of values refine it)
+	 * \param batch_rows maximum number of rows in record batch
+	 */
+	ArrowWriter(BufferedWriter & out, const SQLiteDB::sq_columns & columns, size_t batch_rows = DEFAULT_BATCH_ROWS);
+
+	static const size_t DEFAULT_BATCH_ROWS = 64 * 1024;
+
+private:
+	//! Cell values of one column in current batch (SQLite storage classes, converted on batch write).
+	struct column_data {
+		std::vector<unsigned char> cls;	///< Storage class
+		std::vector<int64_t> fixed;		///< Integer or double bits
+		std::vector<uint32_t> var_end;	///< End of text/blob in var
+		std::string var;				///< Text and blob data
+	};
+
+	//! Arrow message block (file footer).
+	struct block {
+		int64_t offset;
+		int32_t meta_len;
+		int64_t body_len;
+	};
+
+	bool WriteBatch(void);
+	void ChooseTypes(void);
+	bool ConversionError(const size_t col, const size_t row, const unsigned char cls);
+	bool WriteMessage(const std::string & meta, const std::string & body, block * blk);
+
+	BufferedWriter & out;
+	const SQLiteDB::sq_columns & columns;
+	const size_t batch_rows;
+
+	//! Storage classes found in column (bit mask).
+	enum class_bits {
+		cb_int = 1,
+		cb_float = 2,
+		cb_text = 4,
+		cb_blob = 8,
+		cb_bigint = 16	///< Integer not exact in double
+	};
+
+	std::vector<column_type> types;	///< Chosen on first batch write
+	std::vector<unsigned> classes;	///< Storage classes of all values (if scanned)
+	std::vector<column_data> data;
+	size_t rows;		///< Rows in current batch
+	uint64_t written;	///< Rows in written batches
+	size_t var_size;	///< Size of text/blob data in current batch
+	bool started;		///< File magic and schema are written
+	std::vector<block> batches;
+	std::wstring error;	///< Conversion error
+};
+
+#endif /* __ARROWWRITER_H__ */
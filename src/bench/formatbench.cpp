@@ -0,0 +1,278 @@
+// Row formatters benchmark: in-memory table exported to csv, jsonl and sql
+// by the previous per-row functions (format branch and per-cell conversions)
+// and by format_rows. SQLite step time is measured separately and subtracted,
+// output of both paths is compared for jsonl and sql (csv quoting changed).
+
+#include "rowformat.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define ROWS 200000
+#define RUNS 5
+
+namespace {
+
+double now()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Previous per-row functions (before row formatter classes)
+namespace previous {
+
+void get_text(const sqlite_statement& stmt, const int idx, std::string& data)
+{
+	if (stmt.column_type(idx) == SQLITE_BLOB) {
+		const int blob_len = stmt.get_length(idx);
+		data = "[";
+		data += std::to_string(blob_len);
+		data += "]:0x";
+		const unsigned char* blob_data = static_cast<const unsigned char*>(stmt.get_blob(idx));
+		for (int j = 0; j < blob_len && j < MAX_BLOB_LENGTH; ++j) {
+			char h[3];
+			snprintf(h, sizeof(h)/sizeof(h[0]), "%02x", blob_data[j]);
+			data += h;
+		}
+		if (blob_len >= MAX_BLOB_LENGTH)
+			data += "...";
+	}
+	else {
+		const char* txt = stmt.get_text(idx);
+		data = txt ? txt : std::string();
+		//Replace unreadable symbols
+		const size_t len = data.length();
+		for (size_t i = 0; i < len; ++i) {
+			char& sym = data[i];
+			if (static_cast<unsigned char>(sym) < ' ')
+				sym = ' ';
+		}
+	}
+}
+
+void format_csv_row(const sqlite_statement& stmt, const SQLiteDB::sq_columns& columns, std::string& out, std::string& col_data)
+{
+	for (int i = 0; i < static_cast<int>(columns.size()); ++i) {
+		get_text(stmt, i, col_data);
+		const bool use_quote = columns[i].type == SQLiteDB::ct_text && col_data.find(';') != std::string::npos;
+		if (use_quote) {
+			out += '"';
+			//Replace quote by double quote
+			size_t qpos = 0;
+			while ((qpos = col_data.find('"', qpos)) != std::string::npos) {
+				col_data.insert(qpos, 1, '"');
+				qpos += 2;
+			}
+		}
+		out += col_data;
+		if (use_quote)
+			out += '"';
+		if (i != static_cast<int>(columns.size()) - 1)
+			out += ';';
+	}
+	out += "\n";
+}
+
+void format_jsonl_row(const sqlite_statement& stmt, const std::vector<std::string>& keys, std::string& out)
+{
+	for (int i = 0; i < static_cast<int>(keys.size()); ++i) {
+		out += keys[i];
+		switch (stmt.column_type(i)) {
+			case SQLITE_INTEGER:
+				out += stmt.get_text(i);
+				break;
+			case SQLITE_FLOAT:
+				append_json_number(out, stmt.get_double(i));
+				break;
+			case SQLITE_TEXT:
+				out += '"';
+				append_json_string(out, stmt.get_text(i), stmt.get_length(i));
+				out += '"';
+				break;
+			case SQLITE_BLOB: {
+				const size_t len = stmt.get_length(i);
+				const size_t pos = out.length();
+				out.resize(pos + BASE64_ENCODED_SIZE(len) + 2);
+				out[pos] = '"';
+				const size_t enc_len = Base64Encode(stmt.get_blob(i), len, &out[pos + 1]);
+				out[pos + 1 + enc_len] = '"';
+				break;
+			}
+			default:
+				out += "null";
+				break;
+		}
+	}
+	out += keys.empty() ? "{}\n" : "}\n";
+}
+
+struct sql_batch {
+	size_t rows = 0;
+	size_t bytes = 0;
+};
+
+void finish_sql_batch(std::string& out, sql_batch& batch)
+{
+	if (batch.rows)
+		out += ";\n";
+	batch.rows = 0;
+	batch.bytes = 0;
+}
+
+void format_sql_row(const sqlite_statement& stmt, const std::string& prefix, const size_t columns, std::string& out, sql_batch& batch)
+{
+	const size_t start = out.length();
+	if (batch.rows)
+		out += ",\n(";
+	else {
+		out += prefix;
+		out += "\n(";
+	}
+	for (int i = 0; i < static_cast<int>(columns); ++i) {
+		if (i)
+			out += ',';
+		append_sql_value(stmt, i, out);
+	}
+	out += ')';
+	batch.bytes += out.length() - start;
+	if (++batch.rows >= SQL_BATCH_ROWS || batch.bytes >= SQL_BATCH_SIZE)
+		finish_sql_batch(out, batch);
+}
+
+}
+
+//Output is kept only for comparison, otherwise it is dropped by chunks (as written to file)
+struct sink {
+	bool keep = false;
+	std::string all;
+	size_t bytes = 0;
+
+	bool operator()(std::string& out)
+	{
+		if (out.size() < 64 * 1024)
+			return true;
+		drop(out);
+		return true;
+	}
+	void drop(std::string& out)
+	{
+		bytes += out.size();
+		if (keep)
+			all += out;
+		out.clear();
+	}
+};
+
+bool create_table(sqlite3* db)
+{
+	//Integer key, short text (some with separators and quotes), real and mostly NULL blob
+	const std::string query =
+		"create table t(id integer primary key, name text, v real, b blob);"
+		"with recursive s(i) as (select 1 union all select i+1 from s where i<" + std::to_string(ROWS) + ") "
+		"insert into t select i, 'name ' || i || CASE WHEN i % 10 = 0 THEN '; \"quoted\"' ELSE '' END, i / 7.0, "
+		"CASE WHEN i % 20 = 0 THEN randomblob(16) END from s;";
+	return sqlite3_exec(db, query.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+}
+
+double step_time(sqlite3* db)
+{
+	sqlite_statement stmt(db);
+	stmt.prepare("select * from t");
+	const double start = now();
+	while (stmt.step_execute() == SQLITE_ROW) {}
+	return now() - start;
+}
+
+//Best time of runs, output is kept by extra run (not timed)
+template <class Run>
+double best_time(Run run, sink& out)
+{
+	double best = 1e9;
+	for (int i = 0; i <= RUNS; ++i) {
+		out.keep = i == RUNS;
+		out.all.clear();
+		out.bytes = 0;
+		const double start = now();
+		run();
+		if (!out.keep)
+			best = std::min(best, now() - start);
+	}
+	return best;
+}
+
+}
+
+int main()
+{
+	sqlite3* db;
+	if (sqlite3_open(":memory:", &db) != SQLITE_OK || !create_table(db)) {
+		printf("Unable to create table: %s\n", sqlite3_errmsg(db));
+		return 1;
+	}
+	SQLiteDB::sq_columns columns(4);
+	const char* names[] = { "id", "name", "v", "b" };
+	const SQLiteDB::col_type types[] = { SQLiteDB::ct_integer, SQLiteDB::ct_text, SQLiteDB::ct_float, SQLiteDB::ct_blob };
+	for (size_t i = 0; i < columns.size(); ++i) {
+		columns[i].name = names[i];
+		columns[i].type = types[i];
+	}
+
+	double step = 1e9;
+	for (int i = 0; i < RUNS; ++i)
+		step = std::min(step, step_time(db));
+	const double cells = static_cast<double>(ROWS) * columns.size();
+	printf("%d rows, step %.0f ms\n", ROWS, step * 1000);
+
+	int failed = 0;
+	const row_format formats[] = { rf_csv, rf_jsonl, rf_sql };
+	const char* format_names[] = { "csv", "jsonl", "sql" };
+	for (size_t f = 0; f < sizeof(formats) / sizeof(formats[0]); ++f) {
+		format_options opts;
+		opts.fmt = formats[f];
+		opts.columns = columns.size();
+		opts.keys = jsonl_keys(columns);
+		opts.insert = sql_insert_prefix("t", columns);
+		sink prev_out, new_out;
+
+		const double prev_time = best_time([&]() {
+			sqlite_statement stmt(db);
+			stmt.prepare("select * from t");
+			std::string out, col_data;
+			previous::sql_batch batch;
+			while (stmt.step_execute() == SQLITE_ROW) {
+				if (opts.fmt == rf_csv)
+					previous::format_csv_row(stmt, columns, out, col_data);
+				else if (opts.fmt == rf_jsonl)
+					previous::format_jsonl_row(stmt, opts.keys, out);
+				else
+					previous::format_sql_row(stmt, opts.insert, columns.size(), out, batch);
+				prev_out(out);
+			}
+			previous::finish_sql_batch(out, batch);
+			prev_out.drop(out);
+		}, prev_out);
+
+		const double new_time = best_time([&]() {
+			sqlite_statement stmt(db);
+			stmt.prepare("select * from t");
+			std::string out;
+			int state;
+			auto next_row = []() { return true; };
+			format_rows(opts, stmt, nullptr, out, next_row, new_out, state);
+			new_out.drop(out);
+		}, new_out);
+
+		const bool same = prev_out.all == new_out.all;
+		if (formats[f] != rf_csv && !same) {
+			printf("FAIL %s: output differs from previous functions\n", format_names[f]);
+			failed = 1;
+		}
+		printf("%-6s previous %7.1f Mcells/s   format_rows %7.1f Mcells/s   x%.1f   %zu bytes%s\n", format_names[f],
+			cells / std::max(prev_time - step, 1e-6) / 1e6, cells / std::max(new_time - step, 1e-6) / 1e6,
+			std::max(prev_time - step, 1e-6) / std::max(new_time - step, 1e-6), new_out.bytes, same ? "" : " (differs)");
+	}
+	sqlite3_close(db);
+	return failed;
+}
@@ -0,0 +1,151 @@
+// Utf8ToWideChar benchmark: panel cells (512 bytes) converted by the old path
+// (copy with terminating zero, mbstowcs, control characters loop) and by
+// Utf8ToWideChar. Decoder output is checked first, including invalid input.
+
+#include <common/utf8util.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <locale.h>
+#include <time.h>
+
+#define CELL_SIZE 512
+#define CELLS 4096
+#define MIN_SECONDS 2.0
+
+static int failed = 0;
+
+static double Now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void Check(const char* name, const char* src, size_t len, const wchar_t* expected, size_t expectedLen)
+{
+	wchar_t dst[64];
+	const size_t n = Utf8ToWideChar(src, len, dst, 1);
+	if( n != expectedLen || memcmp(dst, expected, n * sizeof(wchar_t)) != 0 ) {
+		printf("FAIL %s: %zu characters, expected %zu\n", name, n, expectedLen);
+		failed = 1;
+	}
+}
+
+#define CHECK(name, src, ...) do { \
+	const wchar_t expected[] = { __VA_ARGS__ }; \
+	Check(name, src, sizeof(src) - 1, expected, sizeof(expected) / sizeof(expected[0])); \
+} while( 0 )
+
+static void CheckInvalid(void)
+{
+	CHECK("ascii with controls", "a\tb\n", L'a', L' ', L'b', L' ');
+	CHECK("two bytes", "\xd0\x96", 0x416);
+	CHECK("three bytes", "\xe2\x82\xac", 0x20ac);
+	CHECK("four bytes", "\xf0\x9f\x98\x80", 0x1f600);
+	CHECK("truncated two bytes", "\xd0", 0xfffd);
+	CHECK("truncated three bytes", "\xe2\x82", 0xfffd, 0xfffd);
+	CHECK("truncated four bytes", "\xf0\x9f\x98" "a", 0xfffd, 0xfffd, 0xfffd, L'a');
+	CHECK("overlong slash", "\xc0\xaf", 0xfffd, 0xfffd);
+	CHECK("overlong three bytes", "\xe0\x80\xaf", 0xfffd, 0xfffd, 0xfffd);
+	CHECK("overlong four bytes", "\xf0\x80\x80\xaf", 0xfffd, 0xfffd, 0xfffd, 0xfffd);
+	CHECK("surrogate", "\xed\xa0\x80", 0xfffd, 0xfffd, 0xfffd);
+	CHECK("above U+10FFFF", "\xf4\x90\x80\x80", 0xfffd, 0xfffd, 0xfffd, 0xfffd);
+	CHECK("stray continuation", "a\x80z", L'a', 0xfffd, L'z');
+}
+
+// Old path: cell copied to zero terminated string, converted by libc and filtered
+static size_t OldPath(const char* src, size_t len, wchar_t* dst, char* tmp)
+{
+	memcpy(tmp, src, len);
+	tmp[len] = 0;
+	const size_t n = mbstowcs(dst, tmp, len + 1);
+	if( n == (size_t)-1 )
+		return 0;
+	for( size_t i = 0; i < n; ++i ) {
+		if( dst[i] < L' ' )
+			dst[i] = L' ';
+	}
+	return n;
+}
+
+// Cells of one pattern: ASCII text or Cyrillic words separated by ASCII
+static char* MakeCells(int cyrillic)
+{
+	static const char ascii[] = "The quick brown fox jumps over the lazy dog 0123456789. ";
+	static const char mixed[] = "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, world 42 \xd0\xbc\xd0\xb8\xd1\x80! ";
+	const char* pattern = cyrillic ? mixed : ascii;
+	const size_t plen = strlen(pattern);
+	char* cells = malloc((size_t)CELLS * CELL_SIZE);
+	for( size_t c = 0; c < CELLS; ++c ) {
+		char* cell = cells + c * CELL_SIZE;
+		size_t i = 0;
+		// whole characters only: cut before a lead byte which doesn't fit
+		while( i < CELL_SIZE ) {
+			const size_t p = (c + i) % plen;
+			const unsigned char b = (unsigned char)pattern[p];
+			const size_t n = b < 0x80 ? 1 : b >= 0xe0 ? 3 : 2;
+			if( (b & 0xc0) == 0x80 || i + n > CELL_SIZE ) {
+				cell[i++] = ' ';
+				continue;
+			}
+			memcpy(cell + i, pattern + p, n);
+			i += n;
+		}
+	}
+	return cells;
+}
+
+static void Run(const char* name, int cyrillic)
+{
+	char* cells = MakeCells(cyrillic);
+	wchar_t* dst = malloc(CELL_SIZE * sizeof(wchar_t));
+	wchar_t* ref = malloc((CELL_SIZE + 1) * sizeof(wchar_t));
+	char* tmp = malloc(CELL_SIZE + 1);
+
+	for( size_t c = 0; c < CELLS; ++c ) {
+		const char* cell = cells + c * CELL_SIZE;
+		const size_t n = Utf8ToWideChar(cell, CELL_SIZE, dst, 1);
+		if( OldPath(cell, CELL_SIZE, ref, tmp) != n || memcmp(dst, ref, n * sizeof(wchar_t)) != 0 ) {
+			printf("FAIL %s: cell %zu differs from mbstowcs\n", name, c);
+			failed = 1;
+			break;
+		}
+	}
+
+	double speed[2];
+	for( int path = 0; path < 2; ++path ) {
+		size_t bytes = 0, chars = 0;
+		const double start = Now();
+		double elapsed;
+		do {
+			for( size_t c = 0; c < CELLS; ++c ) {
+				const char* cell = cells + c * CELL_SIZE;
+				chars += path ? Utf8ToWideChar(cell, CELL_SIZE, dst, 1) : OldPath(cell, CELL_SIZE, ref, tmp);
+			}
+			bytes += (size_t)CELLS * CELL_SIZE;
+			elapsed = Now() - start;
+		} while( elapsed < MIN_SECONDS );
+		speed[path] = bytes / elapsed / (1024 * 1024);
+		if( !chars )
+			failed = 1;
+	}
+	printf("%-10s mbstowcs %8.1f MB/s   Utf8ToWideChar %8.1f MB/s   x%.1f\n", name, speed[0], speed[1], speed[1] / speed[0]);
+
+	free(tmp);
+	free(ref);
+	free(dst);
+	free(cells);
+}
+
+int main(void)
+{
+	if( !setlocale(LC_CTYPE, "C.UTF-8") && !setlocale(LC_CTYPE, "en_US.UTF-8") ) {
+		printf("UTF-8 locale is not available\n");
+		return 1;
+	}
+	CheckInvalid();
+	Run("ascii", 0);
+	Run("cyrillic", 1);
+	return failed;
+}
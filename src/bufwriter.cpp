@@ -0,0 +1,153 @@
+#include "bufwriter.h"
+#include <utils.h>
+#include <cerrno>
+#include <cstdlib>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <common/log.h>
+
+extern const char * LOG_FILE;
+#define LOG_SOURCE_FILE "bufwriter.cpp"
+
+#define BUFFER_ALIGN 4096
+#define DROP_CACHE_SIZE (64 * 1024 * 1024)
+
+BufferedWriter::BufferedWriter(size_t buffer_size):
+	fd(-1),
+	sequential(false),
+	error(0),
+	buffer(nullptr),
+	capacity((std::max(buffer_size, static_cast<size_t>(1)) + BUFFER_ALIGN - 1) & ~static_cast<size_t>(BUFFER_ALIGN - 1)),
+	used(0),
+	offset(0),
+	dropped(0)
+{
+	if( posix_memalign(reinterpret_cast<void **>(&buffer), BUFFER_ALIGN, capacity) != 0 ) {
+		buffer = nullptr;
+		capacity = 0;
+	}
+}
+
+BufferedWriter::~BufferedWriter()
+{
+	if( fd != -1 )
+		close(fd);
+	free(buffer);
+}
+
+bool BufferedWriter::Open(const wchar_t * file_name, unsigned flags)
+{
+	if( !buffer )
+		return Fail(ENOMEM);
+
+	const std::string name = Wide2MB(file_name);
+	const int oflags = O_WRONLY | O_CREAT | O_CLOEXEC | ((flags & bw_append) ? O_APPEND : O_TRUNC);
+	fd = open(name.c_str(), oflags, 0666);
+	if( fd == -1 )
+		return Fail(errno);
+
+	sequential = (flags & bw_sequential) != 0;
+#ifdef POSIX_FADV_SEQUENTIAL
+	if( sequential )
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	return true;
+}
+
+bool BufferedWriter::WriteLarge(const void * data, size_t size)
+{
+	const char * src = static_cast<const char *>(data);
+	while( size ) {
+		if( used == capacity && !Flush() )
+			return false;
+		//Big block goes to file directly if buffer is empty
+		if( !used && size >= capacity ) {
+			if( !WriteBlock(src, size) )
+				return false;
+			offset += size;
+			DropCache();
+			return true;
+		}
+		const size_t part = std::min(size, capacity - used);
+		memcpy(buffer + used, src, part);
+		used += part;
+		src += part;
+		size -= part;
+	}
+	return true;
+}
+
+bool BufferedWriter::Flush(void)
+{
+	if( fd == -1 )
+		return Fail(EBADF);
+	if( error )
+		return false;
+	if( !used )
+		return true;
+
+	if( !WriteBlock(buffer, used) )
+		return false;
+	offset += used;
+	used = 0;
+	DropCache();
+	return true;
+}
+
+bool BufferedWriter::WriteBlock(const char * data, size_t size)
+{
+	while( size ) {
+		const ssize_t res = write(fd, data, size);
+		if( res < 0 ) {
+			if( errno == EINTR )
+				continue;
+			return Fail(errno);
+		}
+		data += res;
+		size -= res;
+	}
+	return true;
+}
+
+void BufferedWriter::DropCache(void)
+{
+#ifdef POSIX_FADV_DONTNEED
+	//Exported file is not read back, don't push other data out of page cache
+	if( sequential && offset - dropped >= DROP_CACHE_SIZE ) {
+#ifdef SYNC_FILE_RANGE_WRITE
+		sync_file_range(fd, dropped, offset - dropped, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+#endif
+		posix_fadvise(fd, dropped, offset - dropped, POSIX_FADV_DONTNEED);
+		dropped = offset;
+	}
+#endif
+}
+
+bool BufferedWriter::Close(void)
+{
+	if( fd == -1 )
+		return !error;
+
+	bool res = Flush();
+	if( close(fd) != 0 && res )
+		res = Fail(errno);
+	fd = -1;
+	used = 0;
+	return res;
+}
+
+bool BufferedWriter::Fail(int err)
+{
+	if( !error ) {
+		error = err;
+		LOG_ERROR("write failed: %s\n", strerror(err));
+	}
+	return false;
+}
+
+std::wstring BufferedWriter::ErrorText(void) const
+{
+	return MB2Wide(strerror(error));
+}
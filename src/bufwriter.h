@@ -0,0 +1,68 @@
+#ifndef __BUFWRITER_H__
+#define __BUFWRITER_H__
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+
+// Output file with large aligned buffer: data is written by big blocks
+// instead of syscall per row.
+class BufferedWriter {
+public:
+	//! Open flags.
+	enum open_flags {
+		bw_default = 0,
+		bw_sequential = 1,	///< posix_fadvise sequential, drop written pages from cache (file is not read back)
+		bw_append = 2		///< append to existing file instead of truncate
+	};
+
+	bool Open(const wchar_t * file_name, unsigned flags = bw_default);
+	// flush buffer and close file
+	bool Close(void);
+	bool Flush(void);
+
+	bool Write(const void * data, size_t size)
+	{
+		if( size <= capacity - used ) {
+			memcpy(buffer + used, data, size);
+			used += size;
+			return true;
+		}
+		return WriteLarge(data, size);
+	};
+	bool Write(const std::string & s) { return Write(s.data(), s.length()); };
+	bool Write(char c) { return used < capacity || Flush() ? (buffer[used++] = c, true) : false; };
+
+	bool IsOpen(void) const { return fd != -1; };
+	// bytes written to file (including buffered)
+	uint64_t Written(void) const { return offset + used; };
+	// errno of first failed operation (0 if no errors)
+	int Error(void) const { return error; };
+	std::wstring ErrorText(void) const;
+
+	explicit BufferedWriter(size_t buffer_size = DEFAULT_BUFFER_SIZE);
+	~BufferedWriter();
+
+	BufferedWriter(const BufferedWriter &) = delete;
+	BufferedWriter & operator=(const BufferedWriter &) = delete;
+
+	static const size_t DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024;
+
+private:
+	bool WriteLarge(const void * data, size_t size);
+	bool WriteBlock(const char * data, size_t size);
+	void DropCache(void);
+	bool Fail(int err);
+
+	int fd;
+	bool sequential;
+	int error;
+
+	char * buffer;
+	size_t capacity;
+	size_t used;
+	uint64_t offset;	///< bytes already written to file
+	uint64_t dropped;	///< bytes released from page cache
+};
+
+#endif /* __BUFWRITER_H__ */
@@ -0,0 +1,98 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct arena_block {
+	struct arena_block * next;
+	size_t size;
+	size_t used;
+};
+
+struct arena {
+	struct arena_block * head;	// current block (allocations go here)
+	size_t block_size;
+	size_t total;
+};
+
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+#define ARENA_HDR_SIZE ARENA_ROUND(sizeof(struct arena_block))
+
+static struct arena_block * arena_new_block(struct arena * a, size_t size)
+{
+	struct arena_block * b = (struct arena_block *)malloc(ARENA_HDR_SIZE + size);
+	if( !b )
+		return 0;
+	b->next = 0;
+	b->size = size;
+	b->used = 0;
+	a->total += ARENA_HDR_SIZE + size;
+	return b;
+}
+
+extern struct arena * arena_create(size_t block_size)
+{
+	struct arena * a = (struct arena *)malloc(sizeof(struct arena));
+	if( !a )
+		return 0;
+	a->head = 0;
+	a->total = 0;
+	a->block_size = ARENA_ROUND(block_size ? block_size : ARENA_DEFAULT_BLOCK_SIZE);
+	return a;
+}
+
+extern void arena_destroy(struct arena * a)
+{
+	if( !a )
+		return;
+	while( a->head ) {
+		struct arena_block * next = a->head->next;
+		free(a->head);
+		a->head = next;
+	}
+	free(a);
+}
+
+extern void * arena_alloc(struct arena * a, size_t size)
+{
+	struct arena_block * b = a->head;
+	size = ARENA_ROUND(size ? size : 1);
+
+	if( b && b->size - b->used >= size ) {
+		void * p = (char *)b + ARENA_HDR_SIZE + b->used;
+		b->used += size;
+		return p;
+	}
+
+	// big allocation - own block behind the current one, current block stays in use
+	if( b && size > a->block_size / 4 ) {
+		struct arena_block * big = arena_new_block(a, size);
+		if( !big )
+			return 0;
+		big->used = size;
+		big->next = b->next;
+		b->next = big;
+		return (char *)big + ARENA_HDR_SIZE;
+	}
+
+	b = arena_new_block(a, size > a->block_size ? size : a->block_size);
+	if( !b )
+		return 0;
+	b->next = a->head;
+	a->head = b;
+	b->used = size;
+	return (char *)b + ARENA_HDR_SIZE;
+}
+
+extern wchar_t * arena_wcsdup(struct arena * a, const wchar_t * s)
+{
+	const size_t size = (wcslen(s) + 1) * sizeof(wchar_t);
+	wchar_t * p = (wchar_t *)arena_alloc(a, size);
+	if( p )
+		memcpy(p, s, size);
+	return p;
+}
+
+extern size_t arena_size(const struct arena * a)
+{
+	return a->total;
+}
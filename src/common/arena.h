@@ -0,0 +1,33 @@
+#ifndef __COMMON_ARENA_H__
+#define __COMMON_ARENA_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <wchar.h>
+
+// bump allocator: many small allocations, all released at once
+
+struct arena;
+
+#define ARENA_DEFAULT_BLOCK_SIZE (1024*1024)
+#define ARENA_ALIGN (2*sizeof(void *))
+
+// block_size 0 - ARENA_DEFAULT_BLOCK_SIZE
+extern struct arena * arena_create(size_t block_size);
+extern void arena_destroy(struct arena * a);
+
+// memory aligned to ARENA_ALIGN, nullptr on out of memory
+extern void * arena_alloc(struct arena * a, size_t size);
+extern wchar_t * arena_wcsdup(struct arena * a, const wchar_t * s);
+
+// total bytes allocated by arena blocks
+extern size_t arena_size(const struct arena * a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __COMMON_ARENA_H__
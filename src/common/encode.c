@@ -0,0 +1,147 @@
+#include "encode.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+size_t JsonEscapeScan(const char* _src, size_t len)
+{
+	const unsigned char* src = (const unsigned char*)_src;
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i ctrl_max = _mm_set1_epi8(0x1f);
+	for( ; i + 16 <= len; i += 16 ) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		// unsigned v <= 0x1f
+		const __m128i ctrl = _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl_max), ctrl_max);
+		const __m128i esc = _mm_or_si128(ctrl, _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)));
+		const int mask = _mm_movemask_epi8(esc);
+		if( mask )
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for( ; i < len; ++i ) {
+		if( src[i] < 0x20 || src[i] == '"' || src[i] == '\\' )
+			return i;
+	}
+	return len;
+}
+
+size_t CsvQuoteScan(const char* _src, size_t len, char sep)
+{
+	const unsigned char* src = (const unsigned char*)_src;
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i separator = _mm_set1_epi8(sep);
+	const __m128i ctrl_max = _mm_set1_epi8(0x1f);
+	for( ; i + 16 <= len; i += 16 ) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i ctrl = _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl_max), ctrl_max);
+		const __m128i spec = _mm_or_si128(ctrl, _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, separator)));
+		const int mask = _mm_movemask_epi8(spec);
+		if( mask )
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for( ; i < len; ++i ) {
+		if( src[i] < 0x20 || src[i] == '"' || src[i] == (unsigned char)sep )
+			return i;
+	}
+	return len;
+}
+
+size_t CsvDelimScan(const char* _src, size_t len, char sep)
+{
+	const unsigned char* src = (const unsigned char*)_src;
+	size_t i = 0;
+#if defined(__SSE2__)
+	const __m128i separator = _mm_set1_epi8(sep);
+	const __m128i cr = _mm_set1_epi8('\r');
+	const __m128i lf = _mm_set1_epi8('\n');
+	for( ; i + 16 <= len; i += 16 ) {
+		const __m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		const __m128i delim = _mm_or_si128(_mm_cmpeq_epi8(v, separator), _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+		const int mask = _mm_movemask_epi8(delim);
+		if( mask )
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for( ; i < len; ++i ) {
+		if( src[i] == (unsigned char)sep || src[i] == '\r' || src[i] == '\n' )
+			return i;
+	}
+	return len;
+}
+
+size_t JsonEscapeChar(unsigned char c, char* dst)
+{
+	static const char hex[] = "0123456789abcdef";
+	dst[0] = '\\';
+	switch( c ) {
+	case '"': dst[1] = '"'; return 2;
+	case '\\': dst[1] = '\\'; return 2;
+	case '\b': dst[1] = 'b'; return 2;
+	case '\f': dst[1] = 'f'; return 2;
+	case '\n': dst[1] = 'n'; return 2;
+	case '\r': dst[1] = 'r'; return 2;
+	case '\t': dst[1] = 't'; return 2;
+	default:
+		break;
+	}
+	dst[1] = 'u';
+	dst[2] = '0';
+	dst[3] = '0';
+	dst[4] = hex[c >> 4];
+	dst[5] = hex[c & 0xf];
+	return 6;
+}
+
+size_t Base64Encode(const void* _src, size_t len, char* dst)
+{
+	static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	const unsigned char* src = (const unsigned char*)_src;
+	char* out = dst;
+	size_t i = 0;
+	for( ; i + 3 <= len; i += 3 ) {
+		const unsigned int v = ((unsigned int)src[i] << 16) | ((unsigned int)src[i+1] << 8) | src[i+2];
+		out[0] = alphabet[v >> 18];
+		out[1] = alphabet[(v >> 12) & 0x3f];
+		out[2] = alphabet[(v >> 6) & 0x3f];
+		out[3] = alphabet[v & 0x3f];
+		out += 4;
+	}
+	if( i < len ) {
+		unsigned int v = (unsigned int)src[i] << 16;
+		if( i + 1 < len )
+			v |= (unsigned int)src[i+1] << 8;
+		out[0] = alphabet[v >> 18];
+		out[1] = alphabet[(v >> 12) & 0x3f];
+		out[2] = i + 1 < len ? alphabet[(v >> 6) & 0x3f] : '=';
+		out[3] = '=';
+		out += 4;
+	}
+	return (size_t)(out - dst);
+}
+
+size_t HexEncode(const void* _src, size_t len, char* dst)
+{
+	static const char hex_table[] =
+		"000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+		"202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+		"404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+		"606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+		"808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+		"a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+		"c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+		"e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+	const unsigned char* src = (const unsigned char*)_src;
+	for( size_t i = 0; i < len; ++i ) {
+		const char* h = hex_table + src[i] * 2;
+		dst[i * 2] = h[0];
+		dst[i * 2 + 1] = h[1];
+	}
+	return len * 2;
+}
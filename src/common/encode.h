@@ -0,0 +1,39 @@
+#ifndef __COMMON_ENCODE_H__
+#define __COMMON_ENCODE_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Return position of the first byte which must be escaped in JSON string
+// (quote, backslash, control characters) or len if there are no such bytes.
+size_t JsonEscapeScan(const char* src, size_t len);
+
+// Return position of the first byte which must be quoted or replaced in CSV field
+// (separator, quote, control characters) or len if there are no such bytes.
+size_t CsvQuoteScan(const char* src, size_t len, char sep);
+
+// Return position of the first field or record delimiter of unquoted CSV field
+// (separator, CR, LF) or len if there are no such bytes.
+size_t CsvDelimScan(const char* src, size_t len, char sep);
+
+// Write JSON escape sequence for byte c (dst must hold 6 bytes), return its length.
+size_t JsonEscapeChar(unsigned char c, char* dst);
+
+#define BASE64_ENCODED_SIZE(len) (((len) + 2) / 3 * 4)
+
+// Encode data to base64 (with padding) without terminating zero,
+// dst must hold BASE64_ENCODED_SIZE(len) bytes, return number of bytes written.
+size_t Base64Encode(const void* src, size_t len, char* dst);
+
+// Encode data to lowercase hex without terminating zero,
+// dst must hold len * 2 bytes, return number of bytes written.
+size_t HexEncode(const void* src, size_t len, char* dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __COMMON_ENCODE_H__
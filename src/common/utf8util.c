@@ -1,5 +1,14 @@
 #include "utf8util.h"
 #include <stdlib.h>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <immintrin.h>
+#define UTF8_AVX2_DISPATCH
+#endif
 
 char* StrToLwrExt(char* _pString)
 {
@@ -1730,3 +1739,147 @@ unsigned char* pExtChar = 0;
     }
     return _pString;
 }
+
+/* Pure ASCII runs are widened by SIMD blocks, control characters are replaced
+   in the same pass. Return number of bytes processed (multiple of block size). */
+
+#if defined(__SSE2__)
+static size_t AsciiToWideCharSse2(const unsigned char* src, size_t len, wchar_t* dst, int replaceCtrl)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i space = _mm_set1_epi8(' ');
+	size_t i = 0;
+	for( ; i + 16 <= len; i += 16 ) {
+		__m128i v = _mm_loadu_si128((const __m128i*)(src + i));
+		if( _mm_movemask_epi8(v) )
+			break;
+		if( replaceCtrl ) {
+			const __m128i ctrl = _mm_cmplt_epi8(v, space);
+			v = _mm_or_si128(_mm_andnot_si128(ctrl, v), _mm_and_si128(ctrl, space));
+		}
+		const __m128i lo = _mm_unpacklo_epi8(v, zero);
+		const __m128i hi = _mm_unpackhi_epi8(v, zero);
+#if WCHAR_MAX > 0xffff
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128((__m128i*)(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+#else
+		_mm_storeu_si128((__m128i*)(dst + i), lo);
+		_mm_storeu_si128((__m128i*)(dst + i + 8), hi);
+#endif
+	}
+	return i;
+}
+#endif
+
+#if defined(UTF8_AVX2_DISPATCH) && WCHAR_MAX > 0xffff
+__attribute__((target("avx2")))
+static size_t AsciiToWideCharAvx2(const unsigned char* src, size_t len, wchar_t* dst, int replaceCtrl)
+{
+	const __m256i space = _mm256_set1_epi8(' ');
+	size_t i = 0;
+	for( ; i + 32 <= len; i += 32 ) {
+		__m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+		if( _mm256_movemask_epi8(v) )
+			break;
+		if( replaceCtrl )
+			v = _mm256_blendv_epi8(v, space, _mm256_cmpgt_epi8(space, v));
+		const __m128i lo = _mm256_castsi256_si128(v);
+		const __m128i hi = _mm256_extracti128_si256(v, 1);
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_cvtepu8_epi32(lo));
+		_mm256_storeu_si256((__m256i*)(dst + i + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(lo, 8)));
+		_mm256_storeu_si256((__m256i*)(dst + i + 16), _mm256_cvtepu8_epi32(hi));
+		_mm256_storeu_si256((__m256i*)(dst + i + 24), _mm256_cvtepu8_epi32(_mm_srli_si128(hi, 8)));
+	}
+	return i;
+}
+
+static int HasAvx2(void)
+{
+	static int avx2 = -1;
+	if( avx2 < 0 ) {
+		__builtin_cpu_init();
+		avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+	}
+	return avx2;
+}
+#endif
+
+static size_t AsciiToWideChar(const unsigned char* src, size_t len, wchar_t* dst, int replaceCtrl)
+{
+#if defined(UTF8_AVX2_DISPATCH) && WCHAR_MAX > 0xffff
+	if( len >= 32 && HasAvx2() )
+		return AsciiToWideCharAvx2(src, len, dst, replaceCtrl);
+#endif
+#if defined(__SSE2__)
+	return AsciiToWideCharSse2(src, len, dst, replaceCtrl);
+#else
+	(void)src; (void)len; (void)dst; (void)replaceCtrl;
+	return 0;
+#endif
+}
+
+size_t Utf8ToWideChar(const char* _src, size_t srcLen, wchar_t* dst, int replaceCtrl)
+{
+	const unsigned char* src = (const unsigned char*)_src;
+	size_t i = 0, o = 0;
+
+	while( i < srcLen ) {
+		if( src[i] < 0x80 ) {
+			if( srcLen - i >= 16 ) {
+				const size_t n = AsciiToWideChar(src + i, srcLen - i, dst + o, replaceCtrl);
+				i += n;
+				o += n;
+				if( i >= srcLen )
+					break;
+			}
+			// ascii tail or non-ascii inside block
+			while( i < srcLen && src[i] < 0x80 ) {
+				dst[o++] = (replaceCtrl && src[i] < ' ') ? L' ' : (wchar_t)src[i];
+				i++;
+			}
+			continue;
+		}
+
+		uint32_t cp = 0xfffd;
+		size_t n = 1;
+		const unsigned char c = src[i];
+		if( c >= 0xc2 && c <= 0xdf ) {
+			if( i + 1 < srcLen && (src[i+1] & 0xc0) == 0x80 ) {
+				cp = ((uint32_t)(c & 0x1f) << 6) | (src[i+1] & 0x3f);
+				n = 2;
+			}
+		} else if( c >= 0xe0 && c <= 0xef ) {
+			if( i + 2 < srcLen && (src[i+1] & 0xc0) == 0x80 && (src[i+2] & 0xc0) == 0x80 ) {
+				const uint32_t v = ((uint32_t)(c & 0x0f) << 12) | ((uint32_t)(src[i+1] & 0x3f) << 6) | (src[i+2] & 0x3f);
+				// overlong and surrogates are invalid
+				if( v >= 0x800 && (v < 0xd800 || v > 0xdfff) ) {
+					cp = v;
+					n = 3;
+				}
+			}
+		} else if( c >= 0xf0 && c <= 0xf4 ) {
+			if( i + 3 < srcLen && (src[i+1] & 0xc0) == 0x80 && (src[i+2] & 0xc0) == 0x80 && (src[i+3] & 0xc0) == 0x80 ) {
+				const uint32_t v = ((uint32_t)(c & 0x07) << 18) | ((uint32_t)(src[i+1] & 0x3f) << 12) |
+							((uint32_t)(src[i+2] & 0x3f) << 6) | (src[i+3] & 0x3f);
+				if( v >= 0x10000 && v <= 0x10ffff ) {
+					cp = v;
+					n = 4;
+				}
+			}
+		}
+		i += n;
+#if WCHAR_MAX > 0xffff
+		dst[o++] = (wchar_t)cp;
+#else
+		if( cp >= 0x10000 ) {
+			cp -= 0x10000;
+			dst[o++] = (wchar_t)(0xd800 + (cp >> 10));
+			dst[o++] = (wchar_t)(0xdc00 + (cp & 0x3ff));
+		} else
+			dst[o++] = (wchar_t)cp;
+#endif
+	}
+	return o;
+}
@@ -1,4 +1,5 @@
 #include <string.h>
+#include <wchar.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,6 +13,11 @@ int StrnCiCmp(const char* s1, const char* s2, size_t ztCount);
 int StrCiCmp(const char* s1, const char* s2);
 char* StrCiStr(const char* s1, const char* s2);
 
+// Convert UTF-8 to wchar_t without terminating zero, invalid sequences are
+// replaced by U+FFFD, control characters (< 0x20) by space if replaceCtrl.
+// dst must hold at least srcLen characters, return number of characters written.
+size_t Utf8ToWideChar(const char* src, size_t srcLen, wchar_t* dst, int replaceCtrl);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,224 @@
+#include "csvreader.h"
+#include <utils.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <common/log.h>
+#include <common/encode.h>
+
+extern const char * LOG_FILE;
+#define LOG_SOURCE_FILE "csvreader.cpp"
+
+CsvReader::CsvReader(size_t buffer_size):
+	fd(-1),
+	error(0),
+	sep(','),
+	eof(false),
+	buffer(nullptr),
+	capacity(buffer_size < 2 ? 2 : buffer_size),
+	begin(0),
+	end(0),
+	base(0),
+	size(0),
+	records(0)
+{
+	buffer = static_cast<char *>(malloc(capacity));
+	if( !buffer )
+		capacity = 0;
+}
+
+CsvReader::~CsvReader()
+{
+	Close();
+	free(buffer);
+}
+
+bool CsvReader::Open(const wchar_t * file_name, char separator)
+{
+	if( !buffer )
+		return Fail(ENOMEM);
+
+	const std::string name = Wide2MB(file_name);
+	fd = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if( fd == -1 || fstat(fd, &st) != 0 )
+		return Fail(errno);
+	size = st.st_size;
+	sep = separator;
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	//Skip UTF-8 BOM
+	while( end < 3 && !eof ) {
+		if( !Fill() )
+			return false;
+	}
+	if( end >= 3 && memcmp(buffer, "\xef\xbb\xbf", 3) == 0 )
+		begin = 3;
+	return true;
+}
+
+void CsvReader::Close(void)
+{
+	if( fd != -1 )
+		close(fd);
+	fd = -1;
+}
+
+bool CsvReader::ReadRecord(std::vector<Field> & fields)
+{
+	for( ;; ) {
+		if( error || (eof && begin == end) )
+			return false;
+		if( !Parse(fields) ) {
+			if( !Fill() )
+				return false;
+			continue;
+		}
+		++records;
+		if( fields.size() > 1 || fields[0].size )
+			return true;
+	}
+}
+
+// Move unparsed tail to the buffer start and read next block,
+// buffer grows if the tail (one record) doesn't leave space for reading
+bool CsvReader::Fill(void)
+{
+	if( fd == -1 )
+		return Fail(EBADF);
+
+	if( begin ) {
+		memmove(buffer, buffer + begin, end - begin);
+		base += begin;
+		end -= begin;
+		begin = 0;
+	}
+	//One byte is reserved for terminating zero of the last field
+	if( end + 1 >= capacity ) {
+		char * grown = static_cast<char *>(realloc(buffer, capacity * 2));
+		if( !grown )
+			return Fail(ENOMEM);
+		buffer = grown;
+		capacity *= 2;
+	}
+	for( ;; ) {
+		const ssize_t res = read(fd, buffer + end, capacity - 1 - end);
+		if( res < 0 ) {
+			if( errno == EINTR )
+				continue;
+			return Fail(errno);
+		}
+		if( !res )
+			eof = true;
+		end += res;
+		return true;
+	}
+}
+
+// Parse record at begin, return false if record is not complete in buffer
+bool CsvReader::Parse(std::vector<Field> & fields)
+{
+	spans.clear();
+	size_t i = begin;
+	for( ;; ) {
+		Span span = { i, 0, false };
+		bool quoted = false;
+		if( i < end && buffer[i] == '"' ) {
+			size_t j = i + 1;
+			for( ;; ) {
+				const char * quote = static_cast<const char *>(memchr(buffer + j, '"', end - j));
+				if( !quote ) {
+					if( !eof )
+						return false;
+					j = end;	//Not closed quote: rest of file
+					break;
+				}
+				j = quote - buffer;
+				if( j + 1 == end && !eof )
+					return false;
+				if( j + 1 < end && buffer[j + 1] == '"' ) {
+					span.escaped = true;
+					j += 2;
+					continue;
+				}
+				break;
+			}
+			//Text after closing quote: field is read as unquoted
+			const size_t next = j < end ? j + 1 : end;
+			if( next == end || buffer[next] == sep || buffer[next] == '\r' || buffer[next] == '\n' ) {
+				span.start = i + 1;
+				span.size = j - span.start;
+				i = next;
+				quoted = true;
+			}
+			else
+				span.escaped = false;
+		}
+		if( !quoted ) {
+			const size_t j = i + CsvDelimScan(buffer + i, end - i, sep);
+			if( j == end && !eof )
+				return false;
+			span.size = j - span.start;
+			i = j;
+		}
+		spans.push_back(span);
+
+		if( i == end )
+			break;
+		if( buffer[i] == sep ) {
+			++i;
+			continue;
+		}
+		//CR, LF or CRLF ends record
+		if( buffer[i] == '\r' ) {
+			if( i + 1 == end && !eof )
+				return false;
+			if( ++i < end && buffer[i] == '\n' )
+				++i;
+		}
+		else
+			++i;
+		break;
+	}
+
+	//Record is complete: remove quotes escaping and terminate fields in place
+	fields.resize(spans.size());
+	for( size_t n = 0; n < spans.size(); ++n ) {
+		char * data = buffer + spans[n].start;
+		size_t len = spans[n].size;
+		if( spans[n].escaped ) {
+			size_t out = 0;
+			for( size_t k = 0; k < len; ++k ) {
+				data[out++] = data[k];
+				if( data[k] == '"' )
+					++k;
+			}
+			len = out;
+		}
+		data[len] = 0;
+		fields[n].data = data;
+		fields[n].size = len;
+	}
+	begin = i;
+	return true;
+}
+
+bool CsvReader::Fail(int err)
+{
+	if( !error ) {
+		error = err;
+		LOG_ERROR("read failed: %s\n", strerror(err));
+	}
+	return false;
+}
+
+std::wstring CsvReader::ErrorText(void) const
+{
+	return MB2Wide(strerror(error));
+}
@@ -0,0 +1,67 @@
+#ifndef __CSVREADER_H__
+#define __CSVREADER_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// CSV/TSV file reader: file is read by big blocks and records are parsed
+// in place (fields point into the buffer, no copy per field).
+class CsvReader {
+public:
+	struct Field {
+		const char * data;	///< zero terminated field text (quotes removed)
+		size_t size;
+	};
+
+	bool Open(const wchar_t * file_name, char separator);
+	void Close(void);
+
+	// read next record (empty lines are skipped), fields are valid until the next call;
+	// return false on end of file or error
+	bool ReadRecord(std::vector<Field> & fields);
+
+	// file size and bytes parsed (for progress)
+	uint64_t Size(void) const { return size; };
+	uint64_t Offset(void) const { return base + begin; };
+	// number of records read
+	uint64_t Records(void) const { return records; };
+	// errno of first failed operation (0 if no errors)
+	int Error(void) const { return error; };
+	std::wstring ErrorText(void) const;
+
+	explicit CsvReader(size_t buffer_size = DEFAULT_BUFFER_SIZE);
+	~CsvReader();
+
+	CsvReader(const CsvReader &) = delete;
+	CsvReader & operator=(const CsvReader &) = delete;
+
+	static const size_t DEFAULT_BUFFER_SIZE = 4 * 1024 * 1024;
+
+private:
+	struct Span {
+		size_t start;
+		size_t size;
+		bool escaped;	///< quoted field with doubled quotes
+	};
+
+	bool Fill(void);
+	bool Parse(std::vector<Field> & fields);
+	bool Fail(int err);
+
+	int fd;
+	int error;
+	char sep;
+	bool eof;
+
+	char * buffer;
+	size_t capacity;
+	size_t begin;	///< start of unparsed data
+	size_t end;		///< end of read data
+	uint64_t base;	///< file offset of buffer start
+	uint64_t size;
+	uint64_t records;
+	std::vector<Span> spans;
+};
+
+#endif /* __CSVREADER_H__ */
@@ -20,8 +20,10 @@
 #include "editor.h"
 #include "exporter.h"
 #include "progress.h"
+#include "bufwriter.h"
 #include <cassert>
 #include <utils.h>
+#include <farkeys.h>
 
 #include <cstdlib>
 
@@ -32,8 +34,10 @@
 extern const char * LOG_FILE;
 #define LOG_SOURCE_FILE "editor.cpp"
 
-editor::editor(std::unique_ptr<SQLiteDB> & db, const char* table_name)
-: _db(db), _table_name(table_name ? table_name : std::string())
+#define BLOB_CHUNK_SIZE (1024 * 1024)
+
+editor::editor(std::unique_ptr<SQLiteDB> & db, const char* table_name, const char* rowid)
+: _db(db), _table_name(table_name ? table_name : std::string()), _rowid(rowid)
 {
 	assert(_db->GetDb());
 }
@@ -44,38 +48,99 @@ void editor::update() const
 
 	//Get edited row id
 	auto ppi = GetCurrentPanelItem();
-	if( ppi ) {
-		if( Plugin::FSF.LStricmp(ppi->FindData.lpwszFileName, L"..") == 0 ) {
-			FreePanelItem(ppi);
-			return;
-		}
-		FreePanelItem(ppi);
-	} else
+	if( !ppi )
+		return;
+	const bool up_dir = Plugin::FSF.LStricmp(ppi->FindData.lpwszFileName, L"..") == 0;
+	const sqlite3_int64 row_id = static_cast<sqlite3_int64>(ppi->FindData.nPhysicalSize);
+	FreePanelItem(ppi);
+	if( up_dir )
 		return;
-
-	const uint64_t row_id = ppi->FindData.nPhysicalSize;
 
 	//Read current row data
 	std::vector<field> db_data;
+	if( !read_row(row_id, db_data) )
+		return;
 
-	std::string query = "select * from ";
-	query += _table_name;
-	query += " where rowid=";
-	query += std::to_string(row_id);
+	//Blobs are written from dialog by F4, so panel is updated even if row edit is canceled
+	bool blobs_changed = false;
+	const bool updated = edit(db_data, false, row_id, &blobs_changed) && exec_update(std::to_string(row_id).c_str(), db_data);
+	if( updated || blobs_changed ) {
+		Plugin::psi.Control(PANEL_ACTIVE, FCTL_UPDATEPANEL, 0, 0);
+		PanelRedrawInfo pri;
+		memset(&pri, 0, sizeof(pri));
+		Plugin::psi.Control(PANEL_ACTIVE, FCTL_REDRAWPANEL, 0, (LONG_PTR)&pri);
+	}
+}
+
+bool editor::view_blob() const
+{
+	assert(!_table_name.empty());
+
+	auto ppi = GetCurrentPanelItem();
+	if( !ppi )
+		return false;
+	const bool up_dir = Plugin::FSF.LStricmp(ppi->FindData.lpwszFileName, L"..") == 0;
+	const sqlite3_int64 row_id = static_cast<sqlite3_int64>(ppi->FindData.nPhysicalSize);
+	FreePanelItem(ppi);
+	if( up_dir )
+		return false;
+
+	std::vector<field> db_data;
+	if( !read_row(row_id, db_data) )
+		return true;
 
-	sqlite_statement stmt(_db->GetDb());
-	if( stmt.prepare(query.c_str()) != SQLITE_OK || stmt.step_execute() != SQLITE_ROW ) {
+	std::vector<std::string> blobs;
+	std::vector<std::wstring> names;
+	for( auto & item : db_data ) {
+		if( item.blob ) {
+			blobs.push_back(item.column.name);
+			names.push_back(MB2Wide(item.column.name.c_str()));
+		}
+	}
+	if( blobs.empty() )
+		return false;
+
+	int idx = 0;
+	if( blobs.size() > 1 ) {
+		std::vector<FarMenuItem> menu_items(names.size());
+		memset(&menu_items.front(), 0, sizeof(FarMenuItem) * menu_items.size());
+		for( size_t i = 0; i < names.size(); ++i )
+			menu_items[i].Text = names[i].c_str();
+		idx = Plugin::psi.Menu(Plugin::psi.ModuleNumber, -1, -1, 0, FMENU_WRAPMODE | FMENU_AUTOHIGHLIGHT, GetMsg(ps_blob_select), nullptr, nullptr, nullptr, nullptr, &menu_items.front(), static_cast<int>(menu_items.size()));
+		if( idx < 0 )
+			return true;
+	}
+
+	open_blob(row_id, blobs[idx], false);
+	return true;
+}
+
+bool editor::read_row(const sqlite3_int64 row_id, std::vector<field>& db_data) const
+{
+	//Blobs are replaced by NULL and read by incremental I/O, so big blobs are not loaded
+	SQLiteDB::sq_columns columns;
+	std::string query;
+	if( _db->ReadColumnDescription(_table_name.c_str(), columns) )
+		query = exporter::select_query(_table_name, columns, true, _rowid.c_str()) + " where " + _rowid + "=?";
+
+	sqlite_statement stmt(_db->GetDb(), _db->GetStmtCache());
+	if( query.empty() ||
+		stmt.prepare(query.c_str()) != SQLITE_OK ||
+		stmt.bind(1, row_id) != SQLITE_OK ||
+		stmt.step_execute() != SQLITE_ROW ) {
 		const std::wstring query_descr = MB2Wide(query.c_str());
 		const std::wstring err_descr = _db->LastError();
 		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), _db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str()};
 		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
-		return;
+		return false;
 	}
-	const int col_num = stmt.column_count();
+	const int col_num = static_cast<int>(columns.size());
+	const char* blob_flags = stmt.get_text(col_num + 1);
 	for (int i = 0; i < col_num; ++i) {
 		field f;
-		f.column.name = stmt.column_name(i);
-		switch (stmt.column_type(i)) {
+		f.column.name = columns[i].name;
+		f.blob = blob_flags && blob_flags[i] == '1';
+		switch (f.blob ? SQLITE_BLOB : stmt.column_type(i)) {
 			case SQLITE_INTEGER: f.column.type = SQLiteDB::ct_integer; break;
 			case SQLITE_FLOAT: f.column.type = SQLiteDB::ct_float; break;
 			case SQLITE3_TEXT: f.column.type = SQLiteDB::ct_text; break;
@@ -83,17 +148,17 @@ void editor::update() const
 			default:
 				f.column.type = SQLiteDB::ct_blob; break;
 		}
-		exporter::get_text(stmt, i, f.value);
+		if( !f.blob )
+			exporter::get_text(stmt, i, f.value);
+		else if( !get_blob_text(row_id, f.column.name, f.value) ) {
+			const std::wstring err_descr = _db->LastError();
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), _db->GetDbName().c_str(), err_descr.c_str()};
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+			return false;
+		}
 		db_data.push_back(f);
 	}
-	stmt.close();
-
-	if( edit(db_data, false) && exec_update(std::to_string(row_id).c_str(), db_data) ) {
-		Plugin::psi.Control(PANEL_ACTIVE, FCTL_UPDATEPANEL, 0, 0);
-		PanelRedrawInfo pri;
-		memset(&pri, 0, sizeof(pri));
-		Plugin::psi.Control(PANEL_ACTIVE, FCTL_REDRAWPANEL, 0, (LONG_PTR)&pri);
-	}
+	return true;
 }
 
 void editor::insert() const
@@ -129,8 +194,13 @@ void editor::insert() const
 }
 
 
-bool editor::edit(std::vector<field>& db_data, const bool create_mode) const
+bool editor::edit(std::vector<field>& db_data, const bool create_mode, const sqlite3_int64 row_id /*= 0*/, bool* blobs_changed /*= nullptr*/) const
 {
+	edit_context ctx;
+	ctx.ed = this;
+	ctx.row_id = row_id;
+	ctx.changed = false;
+
 	//Calculate dialog's size
 	size_t max_wnd_width = 80;
 	SMALL_RECT rc_far_wnd;
@@ -188,6 +258,8 @@ bool editor::edit(std::vector<field>& db_data, const bool create_mode) const
 		dlg_items.push_back(row_ctl.semi);
 		dlg_items.push_back(row_ctl.field);
 		editor_fields.insert(make_pair(item.column.name, static_cast<int>(dlg_items.size()) - 1));
+		if( item.blob && !create_mode )
+			ctx.blobs.insert(make_pair(static_cast<int>(dlg_items.size()) - 1, item.column.name));
 	}
 
 	size_t last_pos = y_pos;
@@ -209,8 +281,10 @@ bool editor::edit(std::vector<field>& db_data, const bool create_mode) const
 	dlg_item.Flags = DIF_CENTERGROUP;
 	dlg_items.push_back(dlg_item);
 
-	const HANDLE dlg = Plugin::psi.DialogInit(Plugin::psi.ModuleNumber, -1, -1, dlg_width, dlg_height, nullptr, &dlg_items.front(), dlg_items.size(), 0, 0, nullptr, 0);
+	const HANDLE dlg = Plugin::psi.DialogInit(Plugin::psi.ModuleNumber, -1, -1, dlg_width, dlg_height, nullptr, &dlg_items.front(), dlg_items.size(), 0, 0, &editor::edit_dlg_proc, reinterpret_cast<LONG_PTR>(&ctx));
 	const auto rc = Plugin::psi.DialogRun(dlg);
+	if( blobs_changed )
+		*blobs_changed = ctx.changed;
 	if (rc < 0 || rc == static_cast<int>(dlg_items.size()) - 1 /* cancel */) {
 		Plugin::psi.DialogFree(dlg);
 		for( auto & item : dlg_items ) {
@@ -224,6 +298,8 @@ bool editor::edit(std::vector<field>& db_data, const bool create_mode) const
 	db_data.clear();
 
 	for( std::map<std::string, int>::const_iterator it = editor_fields.begin(); it != editor_fields.end(); ++it) {
+		if( ctx.blobs.find(it->second) != ctx.blobs.end() )
+			continue;	//Blob description (blob itself is written by editor)
 		if( Plugin::psi.SendDlgMessage(dlg, DM_EDITUNCHANGEDFLAG, it->second, static_cast<LONG_PTR>(-1)) == 0 ) {
 			field f;
 			f.column.name = it->first;
@@ -242,6 +318,178 @@ bool editor::edit(std::vector<field>& db_data, const bool create_mode) const
 	return !db_data.empty();
 }
 
+LONG_PTR WINAPI editor::edit_dlg_proc(HANDLE dlg, int msg, int param1, LONG_PTR param2)
+{
+	if( msg == DN_KEY && (param2 == KEY_F3 || param2 == KEY_F4) ) {
+		edit_context* ctx = reinterpret_cast<edit_context*>(Plugin::psi.SendDlgMessage(dlg, DM_GETDLGDATA, 0, 0));
+		const auto it = ctx->blobs.find(param1);
+		if( it != ctx->blobs.end() ) {
+			if( ctx->ed->open_blob(ctx->row_id, it->second, param2 == KEY_F4) ) {
+				ctx->changed = true;
+				std::string blob_text;
+				if( ctx->ed->get_blob_text(ctx->row_id, it->second, blob_text) ) {
+					const std::wstring txt = MB2Wide(blob_text.c_str());
+					Plugin::psi.SendDlgMessage(dlg, DM_SETTEXTPTR, param1, reinterpret_cast<LONG_PTR>(txt.c_str()));
+				}
+			}
+			return TRUE;
+		}
+	}
+	return Plugin::psi.DefDlgProc(dlg, msg, param1, param2);
+}
+
+bool editor::open_blob(const sqlite3_int64 row_id, const std::string& column, const bool edit_mode) const
+{
+	const std::wstring tmp_file_name = exporter::get_temp_file_name(L"bin");
+	if( !blob_to_file(row_id, column, tmp_file_name.c_str()) ) {
+		DeleteFile(tmp_file_name.c_str());
+		return false;
+	}
+
+	const std::wstring title = MB2Wide((_table_name + '.' + column).c_str());
+	if( !edit_mode ) {
+		Plugin::psi.Viewer(tmp_file_name.c_str(), title.c_str(), 0, 0, -1, -1, VF_DISABLEHISTORY | VF_DELETEONLYFILEONCLOSE, CP_AUTODETECT);
+		return false;
+	}
+
+	bool changed = false;
+	if( Plugin::psi.Editor(tmp_file_name.c_str(), title.c_str(), 0, 0, -1, -1, EF_DISABLEHISTORY, 1, 1, CP_AUTODETECT) == EEC_MODIFIED )
+		changed = file_to_blob(tmp_file_name.c_str(), row_id, column);
+	DeleteFile(tmp_file_name.c_str());
+	return changed;
+}
+
+bool editor::get_blob_text(const sqlite3_int64 row_id, const std::string& column, std::string& data) const
+{
+	sqlite3_blob* blob = nullptr;
+	if( sqlite3_blob_open(_db->GetDb(), "main", _table_name.c_str(), column.c_str(), row_id, 0, &blob) != SQLITE_OK )
+		return false;
+	const bool rc = exporter::get_blob_text(blob, data);
+	sqlite3_blob_close(blob);
+	return rc;
+}
+
+bool editor::blob_to_file(const sqlite3_int64 row_id, const std::string& column, const wchar_t* file_name) const
+{
+	sqlite3_blob* blob = nullptr;
+	if( sqlite3_blob_open(_db->GetDb(), "main", _table_name.c_str(), column.c_str(), row_id, 0, &blob) != SQLITE_OK ) {
+		const std::wstring err_descr = _db->LastError();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), _db->GetDbName().c_str(), err_descr.c_str()};
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return false;
+	}
+
+	const int size = sqlite3_blob_bytes(blob);
+	progress prg_wnd(ps_blob_read, size);
+
+	BufferedWriter file;
+	int rc = SQLITE_OK;
+	bool written = file.Open(file_name);
+	if( written ) {
+		std::vector<char> chunk(std::min(size, BLOB_CHUNK_SIZE));
+		for( int offset = 0; offset < size; ) {
+			const int len = std::min(size - offset, BLOB_CHUNK_SIZE);
+			if( (rc = sqlite3_blob_read(blob, &chunk.front(), len, offset)) != SQLITE_OK || !(written = file.Write(&chunk.front(), len)) )
+				break;
+			offset += len;
+			prg_wnd.update(offset);
+			if( progress::aborted() ) {
+				sqlite3_blob_close(blob);
+				return false;
+			}
+		}
+		written = written && file.Close();
+	}
+	const std::wstring err_descr = rc != SQLITE_OK ? _db->LastError() : file.ErrorText();
+	sqlite3_blob_close(blob);
+	if( rc == SQLITE_OK && written )
+		return true;
+
+	prg_wnd.hide();
+	const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(rc != SQLITE_OK ? ps_err_read : ps_err_writef), rc != SQLITE_OK ? _db->GetDbName().c_str() : file_name, err_descr.c_str()};
+	Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+	return false;
+}
+
+bool editor::file_to_blob(const wchar_t* file_name, const sqlite3_int64 row_id, const std::string& column) const
+{
+	LARGE_INTEGER file_size;
+	HANDLE file = CreateFile(file_name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if( file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &file_size) ) {
+		if( file != INVALID_HANDLE_VALUE )
+			CloseHandle(file);
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_readf), file_name };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return false;
+	}
+
+	progress prg_wnd(ps_blob_write, file_size.QuadPart);
+
+	//Blob is written in savepoint: partially written blob is rolled back on error
+	std::string query = "update '";
+	query += _table_name;
+	query += "' set \"";
+	query += column;
+	query += "\"=zeroblob(?) where ";
+	query += _rowid;
+	query += "=?";
+
+	sqlite3_blob* blob = nullptr;
+	bool read_err = false, aborted = false;
+	int rc = _db->ExecuteQuery("savepoint blob_write") ? SQLITE_OK : SQLITE_ERROR;
+	if( rc == SQLITE_OK )
+		rc = sqlite3_blob_open(_db->GetDb(), "main", _table_name.c_str(), column.c_str(), row_id, 1, &blob);
+	if( rc == SQLITE_OK && sqlite3_blob_bytes(blob) != file_size.QuadPart ) {
+		//Blob size can't be changed by incremental I/O: replace it by zero-filled blob of new size
+		sqlite_statement stmt(_db->GetDb(), _db->GetStmtCache());
+		if( (rc = stmt.prepare(query.c_str())) == SQLITE_OK &&
+			(rc = stmt.bind(1, static_cast<sqlite3_int64>(file_size.QuadPart))) == SQLITE_OK &&
+			(rc = stmt.bind(2, row_id)) == SQLITE_OK )
+			rc = stmt.step_execute() == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+		if( rc == SQLITE_OK )
+			rc = sqlite3_blob_reopen(blob, row_id);
+	}
+	if( rc == SQLITE_OK ) {
+		std::vector<char> chunk(static_cast<size_t>(std::min(file_size.QuadPart, static_cast<LONGLONG>(BLOB_CHUNK_SIZE))));
+		for( LONGLONG offset = 0; offset < file_size.QuadPart; ) {
+			DWORD len = 0;
+			if( !ReadFile(file, &chunk.front(), static_cast<DWORD>(std::min(file_size.QuadPart - offset, static_cast<LONGLONG>(chunk.size()))), &len, nullptr) || !len ) {
+				read_err = true;
+				break;
+			}
+			if( (rc = sqlite3_blob_write(blob, &chunk.front(), static_cast<int>(len), static_cast<int>(offset))) != SQLITE_OK )
+				break;
+			offset += len;
+			prg_wnd.update(offset);
+			if( (aborted = progress::aborted()) )
+				break;
+		}
+	}
+	const std::wstring err_descr = _db->LastError();
+	if( blob )
+		sqlite3_blob_close(blob);
+	CloseHandle(file);
+
+	if( rc == SQLITE_OK && !read_err && !aborted ) {
+		LOG_INFO("blob written: %s.%s rowid=%lld size=%lld\n", _table_name.c_str(), column.c_str(), static_cast<long long>(row_id), static_cast<long long>(file_size.QuadPart));
+		return _db->ExecuteQuery("release blob_write");
+	}
+
+	_db->ExecuteQuery("rollback to blob_write");
+	_db->ExecuteQuery("release blob_write");
+	prg_wnd.hide();
+	if( read_err ) {
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_readf), file_name };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+	}
+	else if( !aborted ) {
+		const std::wstring query_descr = MB2Wide(query.c_str());
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), _db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str()};
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+	}
+	return false;
+}
+
 bool editor::remove(PluginPanelItem* items, const size_t items_count) const
 {
 	if( items_count == 1 && items->FindData.lpwszFileName && Plugin::FSF.LStricmp(items->FindData.lpwszFileName, L"..") == 0 )
@@ -279,7 +527,9 @@ bool editor::remove(PluginPanelItem* items, const size_t items_count) const
 	else {
 		std::string query = "delete from ";
 		query += _table_name;
-		query += " where rowid in (";
+		query += " where ";
+		query += _rowid;
+		query += " in (";
 		for (size_t i = 0; i < items_count; ++i) {
 			if( i )
 				query += ',';
@@ -317,8 +567,9 @@ bool editor::exec_update(const char* row_id, const std::vector<field>& db_data)
 			query += it->column.name;
 			query += "=?";
 		}
-		query += " where rowid=";
-		query += row_id;
+		query += " where ";
+		query += _rowid;
+		query += "=?";
 	}
 	else {
 		//Insert query
@@ -339,7 +590,7 @@ bool editor::exec_update(const char* row_id, const std::vector<field>& db_data)
 		query += ')';
 	}
 
-	sqlite_statement stmt(_db->GetDb());
+	sqlite_statement stmt(_db->GetDb(), _db->GetStmtCache());
 	if( stmt.prepare(query.c_str()) != SQLITE_OK ) {
 		const std::wstring query_descr = MB2Wide(query.c_str());
 		const std::wstring err_descr = _db->LastError();
@@ -365,6 +616,13 @@ bool editor::exec_update(const char* row_id, const std::vector<field>& db_data)
 			return false;
 		}
 	}
+	if (row_id && row_id[0] && stmt.bind(++idx, static_cast<sqlite3_int64>(std::atoll(row_id))) != SQLITE_OK) {
+		const std::wstring query_descr = MB2Wide(query.c_str());
+		const std::wstring err_descr = _db->LastError();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), _db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str()};
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return false;
+	}
 	if( stmt.step_execute() != SQLITE_DONE ) {
 		const std::wstring query_descr = MB2Wide(query.c_str());
 		const std::wstring err_descr = _db->LastError();
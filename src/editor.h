@@ -24,6 +24,7 @@
 #include "plugin.h"
 #include "farpanel.h"
 #include <sqlite/sqlitedb.h>
+#include <map>
 
 class editor : FarPanel
 {
@@ -32,8 +33,9 @@ public:
 	 * Constructor.
 	 * \param db DB instance
 	 * \param table_name edited table name
+	 * \param rowid rowid alias not hidden by column name (rows are identified by panel item rowid)
 	 */
-	editor(std::unique_ptr<SQLiteDB> & db, const char* table_name);
+	editor(std::unique_ptr<SQLiteDB> & db, const char* table_name, const char* rowid = "rowid");
 
 	int ProcessKey(HANDLE hPlugin, int key, unsigned int controlState, bool & change) override {return 0;};
 	int GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber) override {return 0;};
@@ -48,6 +50,12 @@ public:
 	 */
 	void update() const;
 
+	/**
+	 * View blob of current row (if row has several blobs, column is selected by menu).
+	 * \return false if current row has no blobs
+	 */
+	bool view_blob() const;
+
 	/**
 	 * Remove (drop) tables/views/rows etc.
 	 * \param items far panel items list
@@ -61,15 +69,75 @@ private:
 	struct field {
 		SQLiteDB::sq_column column;
 		std::string value;
+		bool blob = false;	///< Value is blob (description only, blob is read by incremental I/O)
 	};
 
+	//! Row edit dialog data
+	struct edit_context {
+		const editor*				ed;			///< Editor instance
+		sqlite3_int64				row_id;		///< Edited row id
+		std::map<int, std::string>	blobs;		///< Blob fields (dialog item id - column name)
+		bool						changed;	///< Blob was written
+	};
+
+	/**
+	 * Read row data, blobs are not loaded.
+	 * \param row_id row id
+	 * \param db_data DB data
+	 * \return operation result state (false on error)
+	 */
+	bool read_row(const sqlite3_int64 row_id, std::vector<field>& db_data) const;
+
 	/**
 	 * Edit (GUI).
 	 * \param db_data DB data map (column-type-value)
 	 * \param create_mode mode (true for create new row)
+	 * \param row_id edited row id (for F3/F4 on blob fields)
+	 * \param blobs_changed set if blob was written from editor
 	 * \return false if user canceled operation
 	 */
-	bool edit(std::vector<field>& db_data, const bool create_mode) const;
+	bool edit(std::vector<field>& db_data, const bool create_mode, const sqlite3_int64 row_id = 0, bool* blobs_changed = nullptr) const;
+
+	/**
+	 * Row edit dialog procedure (F3/F4 on blob field opens viewer/editor).
+	 */
+	static LONG_PTR WINAPI edit_dlg_proc(HANDLE dlg, int msg, int param1, LONG_PTR param2);
+
+	/**
+	 * Open blob in viewer or editor, edited blob is written back.
+	 * \param row_id row id
+	 * \param column column name
+	 * \param edit_mode true to open editor
+	 * \return true if blob was changed
+	 */
+	bool open_blob(const sqlite3_int64 row_id, const std::string& column, const bool edit_mode) const;
+
+	/**
+	 * Get blob description.
+	 * \param row_id row id
+	 * \param column column name
+	 * \param data blob description
+	 * \return operation result state (false on error)
+	 */
+	bool get_blob_text(const sqlite3_int64 row_id, const std::string& column, std::string& data) const;
+
+	/**
+	 * Copy blob to file by chunks.
+	 * \param row_id row id
+	 * \param column column name
+	 * \param file_name output file name
+	 * \return operation result state (false on error)
+	 */
+	bool blob_to_file(const sqlite3_int64 row_id, const std::string& column, const wchar_t* file_name) const;
+
+	/**
+	 * Write file to blob by chunks (blob is recreated by zeroblob if size is changed).
+	 * \param file_name input file name
+	 * \param row_id row id
+	 * \param column column name
+	 * \return operation result state (false on error)
+	 */
+	bool file_to_blob(const wchar_t* file_name, const sqlite3_int64 row_id, const std::string& column) const;
 
 	struct row_control {
 		FarDialogItem label;
@@ -105,6 +173,7 @@ private:
 private:
 	std::unique_ptr<SQLiteDB> & 	_db;	///< DB instance
 	std::string			_table_name;	///< Edited table name
+	std::string			_rowid;		///< Rowid alias used in queries
 };
 
 #endif // __EDITOR_H__
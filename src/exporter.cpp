@@ -19,19 +19,42 @@
 
 #include "exporter.h"
 #include "progress.h"
+#include "bufwriter.h"
+#include "arrowwriter.h"
+#include "rowformat.h"
 #include <cassert>
 #include <utils.h>
 
-#include <locale>
-#include <codecvt>
+#include <cstdio>
+#include <cerrno>
+#include <cmath>
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <charconv>
 
 #include <common/log.h>
+#include <common/arena.h>
+#include <common/utf8util.h>
+#include <common/encode.h>
 
 extern const char * LOG_FILE;
 #define LOG_SOURCE_FILE "exporter.cpp"
 
-#define MAX_BLOB_LENGTH 100
 #define MAX_TEXT_LENGTH 1024
+#define SPILL_MEMORY_SIZE (16 * 1024 * 1024)
+#define SPILL_IO_SIZE (1024 * 1024)
+#define PARALLEL_MIN_ROWS 100000
+#define PARALLEL_MAX_THREADS 16
+#define PARALLEL_RANGES_PER_THREAD 4
+#define PARALLEL_CHUNK_SIZE (1024 * 1024)
+#define PARALLEL_MAX_CHUNKS 8	// per range, limits memory while previous ranges are written
+#define PARALLEL_WAIT_MS 100
+#define FORMAT_CHUNK_SIZE (64 * 1024)	// formatted rows are written by chunks
 
 
 exporter::exporter(std::unique_ptr<SQLiteDB> & db)
@@ -74,14 +97,14 @@ bool exporter::export_data() const
 	dst_file_name += db_object_name;
 	dst_file_name += L".txt";
 
-	FarDialogItem dlg_items[10];
+	FarDialogItem dlg_items[15];
 	memset(dlg_items, 0, sizeof(dlg_items));
 
 	dlg_items[0].Type = DI_DOUBLEBOX;
 	dlg_items[0].X1 = 3;
 	dlg_items[0].X2 = 56;
 	dlg_items[0].Y1 = 1;
-	dlg_items[0].Y2 = 8;
+	dlg_items[0].Y2 = 11;
 	dlg_items[0].PtrData = GetMsg(ps_exp_title);
 
 	dlg_items[1].Type = DI_TEXT;
@@ -110,45 +133,85 @@ bool exporter::export_data() const
 
 	dlg_items[5].Type = DI_RADIOBUTTON;
 	dlg_items[5].X1 = 21;
-	dlg_items[5].X2 = 29;
+	dlg_items[5].X2 = 28;
 	dlg_items[5].Y1 = 5;
 	dlg_items[5].PtrData = L"CSV";
 	dlg_items[5].Selected = 1;
 
 	dlg_items[6].Type = DI_RADIOBUTTON;
-	dlg_items[6].X1 = 30;
-	dlg_items[6].X2 = 44;
+	dlg_items[6].X1 = 29;
+	dlg_items[6].X2 = 37;
 	dlg_items[6].Y1 = 5;
 	dlg_items[6].PtrData = GetMsg(ps_exp_fmt_text);
 
-	dlg_items[7].Type = DI_TEXT;
-	dlg_items[7].Y1 = 6;
-	dlg_items[7].Flags = DIF_SEPARATOR;
+	dlg_items[7].Type = DI_RADIOBUTTON;
+	dlg_items[7].X1 = 38;
+	dlg_items[7].X2 = 46;
+	dlg_items[7].Y1 = 5;
+	dlg_items[7].PtrData = L"JSONL";
 
-	dlg_items[8].Type = DI_BUTTON;
-	dlg_items[8].PtrData = GetMsg(ps_exp_exp);
-	dlg_items[8].Y1 = 7;
-	dlg_items[8].Flags = DIF_CENTERGROUP;
-	dlg_items[8].Focus = 1;
-	dlg_items[8].DefaultButton = 1;
+	dlg_items[8].Type = DI_RADIOBUTTON;
+	dlg_items[8].X1 = 47;
+	dlg_items[8].X2 = 54;
+	dlg_items[8].Y1 = 5;
+	dlg_items[8].PtrData = L"SQL";
 
+	dlg_items[9].Type = DI_RADIOBUTTON;
+	dlg_items[9].X1 = 21;
+	dlg_items[9].X2 = 30;
+	dlg_items[9].Y1 = 6;
+	dlg_items[9].PtrData = L"Arrow";
 
-	dlg_items[9].Type = DI_BUTTON;
-	dlg_items[9].PtrData = GetMsg(ps_cancel);
-	dlg_items[9].Y1 = 7;
-	dlg_items[9].Flags = DIF_CENTERGROUP;
+	dlg_items[10].Type = DI_CHECKBOX;
+	dlg_items[10].X1 = 5;
+	dlg_items[10].X2 = 54;
+	dlg_items[10].Y1 = 7;
+	dlg_items[10].PtrData = GetMsg(ps_exp_parts);
 
-	const HANDLE dlg = Plugin::psi.DialogInit(Plugin::psi.ModuleNumber, -1, -1, 60, 10, nullptr, dlg_items, sizeof(dlg_items) / sizeof(dlg_items[0]), 0, 0, nullptr, (LONG_PTR)0);
+	dlg_items[11].Type = DI_CHECKBOX;
+	dlg_items[11].X1 = 5;
+	dlg_items[11].X2 = 54;
+	dlg_items[11].Y1 = 8;
+	dlg_items[11].PtrData = GetMsg(ps_exp_blobs);
+
+	dlg_items[12].Type = DI_TEXT;
+	dlg_items[12].Y1 = 9;
+	dlg_items[12].Flags = DIF_SEPARATOR;
+
+	dlg_items[13].Type = DI_BUTTON;
+	dlg_items[13].PtrData = GetMsg(ps_exp_exp);
+	dlg_items[13].Y1 = 10;
+	dlg_items[13].Flags = DIF_CENTERGROUP;
+	dlg_items[13].Focus = 1;
+	dlg_items[13].DefaultButton = 1;
+
+
+	dlg_items[14].Type = DI_BUTTON;
+	dlg_items[14].PtrData = GetMsg(ps_cancel);
+	dlg_items[14].Y1 = 10;
+	dlg_items[14].Flags = DIF_CENTERGROUP;
+
+	const HANDLE dlg = Plugin::psi.DialogInit(Plugin::psi.ModuleNumber, -1, -1, 60, 13, nullptr, dlg_items, sizeof(dlg_items) / sizeof(dlg_items[0]), 0, 0, nullptr, (LONG_PTR)0);
 	const intptr_t rc = Plugin::psi.DialogRun(dlg);
-	if (rc < 0 || rc == 9 /* cancel */) {
+	if (rc < 0 || rc == 14 /* cancel */) {
 		Plugin::psi.DialogFree(dlg);
 		FreePanelItem(ppi);
 		return false;
 	}
 	dst_file_name = reinterpret_cast<const wchar_t*>(Plugin::psi.SendDlgMessage(dlg, DM_GETCONSTTEXTPTR, 2, (LONG_PTR)0));
-	const format fmt = Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, 5, (LONG_PTR)0) == BSTATE_CHECKED ? fmt_csv : fmt_text;
+	format fmt = fmt_csv;
+	if (Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, 6, (LONG_PTR)0) == BSTATE_CHECKED)
+		fmt = fmt_text;
+	else if (Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, 7, (LONG_PTR)0) == BSTATE_CHECKED)
+		fmt = fmt_jsonl;
+	else if (Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, 8, (LONG_PTR)0) == BSTATE_CHECKED)
+		fmt = fmt_sql;
+	else if (Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, 9, (LONG_PTR)0) == BSTATE_CHECKED)
+		fmt = fmt_arrow;
+	const bool parts = Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, 10, (LONG_PTR)0) == BSTATE_CHECKED;
+	const bool whole_blobs = Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, 11, (LONG_PTR)0) == BSTATE_CHECKED;
 	Plugin::psi.DialogFree(dlg);
-	auto ret = export_data(db_object_name, fmt, dst_file_name.c_str());
+	auto ret = export_data(db_object_name, fmt, dst_file_name.c_str(), parts, whole_blobs);
 	FreePanelItem(ppi);
 	return ret;
 }
@@ -157,186 +220,838 @@ bool exporter::export_data() const
 bool exporter::export_data(const wchar_t* db_object, const format fmt, std::wstring& file_name) const
 {
 	assert(db_object && db_object[0]);
-	file_name = get_temp_file_name(fmt == fmt_csv ? L"csv" : L"txt");
-	return export_data(db_object, fmt, file_name.c_str());
+	const wchar_t* ext[] = { L"csv", L"txt", L"jsonl", L"sql", L"arrow" };
+	file_name = get_temp_file_name(ext[fmt]);
+	return export_data(db_object, fmt, file_name.c_str(), false, false, true);
+}
+
+
+namespace {
+
+//Rows of text export (kept until all column widths are known), memory then temporary file
+class row_spill
+{
+public:
+	explicit row_spill(const size_t memory_size = SPILL_MEMORY_SIZE) : _memory_size(memory_size), _file(nullptr), _pos(0) {}
+	~row_spill() { if (_file) fclose(_file); }
+
+	bool add(const std::string& cell)
+	{
+		const uint32_t len = static_cast<uint32_t>(cell.length());
+		_buff.append(reinterpret_cast<const char*>(&len), sizeof(len));
+		_buff += cell;
+		return _buff.size() < _memory_size || flush();
+	}
+
+	bool rewind()
+	{
+		_pos = 0;
+		if (!_file)
+			return true;
+		if (!flush() || fseek(_file, 0, SEEK_SET) != 0)
+			return false;
+		return true;
+	}
+
+	bool next(std::string& cell)
+	{
+		uint32_t len;
+		if (!read(&len, sizeof(len)))
+			return false;
+		cell.resize(len);
+		return !len || read(&cell.front(), len);
+	}
+
+private:
+	bool flush()
+	{
+		if (!_file) {
+			_file = tmpfile();
+			if (!_file)
+				return false;
+			setvbuf(_file, nullptr, _IOFBF, SPILL_IO_SIZE);
+			LOG_INFO("spill rows to temporary file\n");
+		}
+		const bool res = _buff.empty() || fwrite(_buff.data(), 1, _buff.size(), _file) == _buff.size();
+		_buff.clear();
+		return res;
+	}
+
+	bool read(void* data, size_t size)
+	{
+		if (_file)
+			return fread(data, 1, size, _file) == size;
+		if (_pos + size > _buff.size())
+			return false;
+		memcpy(data, _buff.data() + _pos, size);
+		_pos += size;
+		return true;
+	}
+
+	const size_t	_memory_size;	///< Maximum size of rows in memory
+	std::string	_buff;	///< Rows (or write buffer if file is used)
+	FILE*		_file;	///< Temporary file
+	size_t		_pos;	///< Read position in memory buffer
+};
+
+//Number of UTF-8 characters
+size_t utf8_length(const std::string& s)
+{
+	size_t len = 0;
+	for (const char c : s)
+		len += (static_cast<unsigned char>(c) & 0xc0) != 0x80;
+	return len;
+}
+
+//Cut or pad with spaces to number of UTF-8 characters
+void utf8_resize(std::string& s, const size_t len)
+{
+	size_t chars = 0;
+	for (size_t i = 0; i < s.length(); ++i) {
+		if ((static_cast<unsigned char>(s[i]) & 0xc0) != 0x80 && chars++ == len) {
+			s.erase(i);
+			return;
+		}
+	}
+	s.append(len - chars, ' ');
+}
+
+//Text cell width (with separating spaces)
+inline size_t text_width(const std::vector<size_t>& widths, const size_t i)
+{
+	return widths[i] + (i && i != widths.size() - 1 ? 2 : 1);
+}
+
+//Initial width of text columns (names)
+std::vector<size_t> text_header_width(const SQLiteDB::sq_columns& columns)
+{
+	std::vector<size_t> widths(columns.size());
+	for (size_t i = 0; i < columns.size(); ++i)
+		widths[i] = std::min(utf8_length(columns[i].name), static_cast<size_t>(MAX_TEXT_LENGTH));
+	return widths;
+}
+
+//Save text row to spill and update columns width
+bool scan_text_row(const sqlite_statement& stmt, std::vector<size_t>& widths, row_spill& spill, std::string& col_data)
+{
+	for (int i = 0; i < static_cast<int>(widths.size()); ++i) {
+		exporter::get_text(stmt, i, col_data);
+		const size_t width = utf8_length(col_data);
+		if (widths[i] < width)
+			widths[i] = std::min(width, static_cast<size_t>(MAX_TEXT_LENGTH));
+		if (!spill.add(col_data))
+			return false;
+	}
+	return true;
+}
+
+//Text header: columns names and separator
+void format_text_header(const SQLiteDB::sq_columns& columns, const std::vector<size_t>& widths, std::string& out)
+{
+	for (size_t i = 0; i < columns.size(); ++i) {
+		std::string col_name;
+		if (i)
+			col_name = ' ';
+		col_name += columns[i].name;
+		utf8_resize(col_name, text_width(widths, i));
+		out += col_name;
+		if (i != columns.size() - 1)
+			out += "│";//0x2502;
+	}
+	out += "\n";
+
+	for (size_t i = 0; i < columns.size(); ++i) {
+		for (size_t j = text_width(widths, i); j; --j)
+			out += "─";//0x2500
+		if (i != columns.size() - 1)
+			out += "┼";//0x253C;
+	}
+	out += "\n";
+}
+
+//Text row from spill
+bool format_text_row(row_spill& spill, const std::vector<size_t>& widths, std::string& out, std::string& col_data)
+{
+	for (size_t i = 0; i < widths.size(); ++i) {
+		if (!spill.next(col_data))
+			return false;
+		if (i)
+			col_data.insert(0, 1, ' ');
+		utf8_resize(col_data, text_width(widths, i));
+		if (utf8_length(col_data) > MAX_TEXT_LENGTH) {
+			utf8_resize(col_data, MAX_TEXT_LENGTH - 3);
+			col_data += "...";
+		}
+		out += col_data;
+		if (i != widths.size() - 1)
+			out += "│";//0x2502;
+	}
+	out += "\n";
+	return true;
+}
+
+//Table export split by rowid ranges, each worker reads its ranges on own read-only connection.
+//Read transactions of all connections are started while main connection holds write lock (no commits),
+//so all workers read the same database state.
+class parallel_export
+{
+public:
+	enum result {
+		pr_ok,
+		pr_cancelled,
+		pr_read_error,
+		pr_write_error
+	};
+
+	parallel_export(SQLiteDB& db, const std::string& db_object, const char* rowid, const SQLiteDB::sq_columns& columns, const exporter::format fmt, const format_options& opts)
+	: _db(db), _table(db_object), _columns(columns), _opts(opts), _fmt(fmt), _parts(false), _out_flags(0), _next_db(0), _next(0), _cancel(false), _rows(0), _running(0), _result(pr_ok)
+	{
+		_query = exporter::select_query(db_object, columns, opts.stream_blobs, rowid) + " where " + rowid + " between ? and ?";
+	}
+
+	~parallel_export() { join(); }
+
+	/**
+	 * Export table.
+	 * \param min_rowid minimal rowid of the table
+	 * \param max_rowid maximal rowid of the table
+	 * \param threads number of workers
+	 * \param file_name output file name
+	 * \param parts write each part to separate file (name.NNN.ext)
+	 * \param out_flags BufferedWriter open flags of output files
+	 * \param prg progress window
+	 * \param header text before data (single file only)
+	 * \param footer text after data (single file only)
+	 * \return operation result
+	 */
+	result run(const sqlite3_int64 min_rowid, const sqlite3_int64 max_rowid, const size_t threads, const wchar_t* file_name, const bool parts, const unsigned out_flags,
+		progress& prg, const std::string& header, const std::string& footer);
+
+	const std::wstring& error_text() const { return _error_text; }
+	const std::wstring& error_file() const { return _error_file; }
+
+private:
+	struct range {
+		sqlite3_int64 from, to;
+		std::deque<std::string> chunks;	///< Formatted data waiting for ordered output
+		bool done = false;				///< All chunks are pushed
+		row_spill spill;				///< Text cells
+		std::vector<size_t> widths;		///< Text columns width
+		uint64_t rows = 0;				///< Rows in range
+		std::unique_ptr<BufferedWriter> part;	///< Part file
+		std::wstring part_name;			///< Part file name
+		range(const sqlite3_int64 f, const sqlite3_int64 t, const size_t spill_size) : from(f), to(t), spill(spill_size) {}
+	};
+
+	bool open_readers(const size_t count);
+	void read_worker();
+	void format_worker();
+	bool read_range(SQLiteDB& db, sqlite_statement& stmt, const size_t idx, std::string& chunk, std::string& col_data);
+	bool format_range(range& r, const std::vector<size_t>& widths, std::string& chunk, std::string& col_data);
+	bool emit(range& r, std::string& chunk);
+	bool finish_range(range& r);
+	bool start(void (parallel_export::*worker)(), const size_t threads);
+	void wait(progress& prg, BufferedWriter* out);
+	void join();
+	void fail(const result res, const std::wstring& text, const std::wstring& file = std::wstring());
+	void spill_error();
+
+	SQLiteDB&				_db;
+	std::string				_query;
+	const std::string		_table;
+	const SQLiteDB::sq_columns&	_columns;
+	const format_options&	_opts;
+	const exporter::format	_fmt;
+	bool					_parts;
+	unsigned				_out_flags;
+	std::wstring			_file_name;
+	std::vector<std::unique_ptr<SQLiteDB>>	_readers;	///< Connections of read workers (open read transaction)
+	std::atomic<size_t>		_next_db;	///< Next reader connection
+	std::vector<size_t>		_widths;	///< Text columns width of all ranges
+
+	std::vector<std::unique_ptr<range>>	_ranges;
+	std::vector<std::thread>	_threads;
+	std::atomic<size_t>		_next;		///< Next range to process
+	std::atomic<bool>		_cancel;
+	std::atomic<uint64_t>	_rows;		///< Processed rows (progress)
+
+	std::mutex				_lock;
+	std::condition_variable	_cv;
+	size_t					_running;	///< Number of running workers
+	result					_result;
+	std::wstring			_error_text;
+	std::wstring			_error_file;
+};
+
+parallel_export::result parallel_export::run(const sqlite3_int64 min_rowid, const sqlite3_int64 max_rowid, const size_t threads, const wchar_t* file_name, const bool parts, const unsigned out_flags,
+	progress& prg, const std::string& header, const std::string& footer)
+{
+	_file_name = file_name;
+	_parts = parts;
+	_out_flags = out_flags;
+
+	//Split rowids to equal ranges, more ranges than workers to balance gaps in rowids
+	const uint64_t span = static_cast<uint64_t>(max_rowid) - static_cast<uint64_t>(min_rowid);
+	size_t count = parts ? threads : threads * PARALLEL_RANGES_PER_THREAD;
+	if (span < count)
+		count = static_cast<size_t>(span) + 1;
+	const uint64_t len = span / count;
+	const uint64_t rest = span % count;
+	const size_t spill_size = std::max(static_cast<size_t>(SPILL_MEMORY_SIZE / count), static_cast<size_t>(SPILL_IO_SIZE));
+	uint64_t from = static_cast<uint64_t>(min_rowid);
+	for (size_t i = 0; i < count; ++i) {
+		const uint64_t to = from + len + (i < rest ? 1 : 0) + (i == count - 1 ? 1 : 0) - 1;
+		_ranges.emplace_back(new range(static_cast<sqlite3_int64>(from), static_cast<sqlite3_int64>(to), spill_size));
+		from = to + 1;
+	}
+	//Rows added out of rowid range before read transactions are started
+	_ranges.front()->from = INT64_MIN;
+	_ranges.back()->to = INT64_MAX;
+	LOG_INFO("rowid %lld-%lld, %u ranges, %u threads\n", static_cast<long long>(min_rowid), static_cast<long long>(max_rowid), static_cast<unsigned>(count), static_cast<unsigned>(threads));
+
+	if (!open_readers(threads))
+		return _result;
+
+	//CSV, JSON and part files are formatted while reading
+	if (_fmt != exporter::fmt_text || parts) {
+		BufferedWriter out;
+		if (!parts) {
+			if (!out.Open(file_name, _out_flags)) {
+				fail(pr_write_error, out.ErrorText(), _file_name);
+				return _result;
+			}
+			out.Write(header);
+		}
+		if (start(&parallel_export::read_worker, threads))
+			wait(prg, parts ? nullptr : &out);
+		if (!parts && _result == pr_ok && (!out.Write(footer) || !out.Close()))
+			fail(pr_write_error, out.ErrorText(), _file_name);
+		return _result;
+	}
+
+	//Text file: all ranges must be read to get columns width, then ranges are formatted in parallel
+	if (!start(&parallel_export::read_worker, threads))
+		return _result;
+	wait(prg, nullptr);
+	if (_result != pr_ok)
+		return _result;
+
+	_widths = text_header_width(_columns);
+	for (const auto& r : _ranges) {
+		for (size_t i = 0; i < _widths.size(); ++i)
+			_widths[i] = std::max(_widths[i], r->widths[i]);
+	}
+
+	BufferedWriter out;
+	if (!out.Open(file_name, _out_flags)) {
+		fail(pr_write_error, out.ErrorText(), _file_name);
+		return _result;
+	}
+	std::string text_header;
+	format_text_header(_columns, _widths, text_header);
+	out.Write(text_header);
+	if (start(&parallel_export::format_worker, threads))
+		wait(prg, &out);
+	if (_result == pr_ok && !out.Close())
+		fail(pr_write_error, out.ErrorText(), _file_name);
+	return _result;
+}
+
+bool parallel_export::start(void (parallel_export::*worker)(), const size_t threads)
+{
+	_next = 0;
+	_rows = 0;
+	_running = threads;
+	for (size_t i = 0; i < threads; ++i) {
+		try {
+			_threads.emplace_back(worker, this);
+		} catch (const std::system_error& e) {
+			LOG_ERROR("can't start worker: %s\n", e.what());
+			{
+				std::lock_guard<std::mutex> lk(_lock);
+				_running -= threads - i;
+			}
+			//Started workers process all ranges
+			if (i)
+				break;
+			fail(pr_read_error, MB2Wide(e.what()));
+			return false;
+		}
+	}
+	return true;
+}
+
+void parallel_export::wait(progress& prg, BufferedWriter* out)
+{
+	//Ranges are written to output file in order
+	size_t idx = 0;
+	std::deque<std::string> chunks;
+	for (;;) {
+		bool finished;
+		bool range_done = false;
+		{
+			std::unique_lock<std::mutex> lk(_lock);
+			range* r = out && idx < _ranges.size() ? _ranges[idx].get() : nullptr;
+			_cv.wait_for(lk, std::chrono::milliseconds(PARALLEL_WAIT_MS), [&] { return !_running || (r && (r->done || !r->chunks.empty())); });
+			if (r) {
+				chunks.swap(r->chunks);
+				range_done = r->done;
+			}
+			finished = !_running;
+		}
+		_cv.notify_all();
+
+		for (const auto& chunk : chunks) {
+			if (!out->Write(chunk)) {
+				fail(pr_write_error, out->ErrorText(), _file_name);
+				break;
+			}
+		}
+		chunks.clear();
+		if (range_done)
+			++idx;
+
+		prg.update(_rows.load(std::memory_order_relaxed));
+		if (!_cancel && progress::aborted())
+			fail(pr_cancelled, std::wstring());
+
+		if (finished && (!out || idx == _ranges.size() || _cancel))
+			break;
+	}
+	join();
+}
+
+void parallel_export::join()
+{
+	for (auto& thread : _threads)
+		thread.join();
+	_threads.clear();
+}
+
+void parallel_export::fail(const result res, const std::wstring& text, const std::wstring& file)
+{
+	{
+		std::lock_guard<std::mutex> lk(_lock);
+		if (_result == pr_ok) {
+			_result = res;
+			_error_text = text;
+			_error_file = file;
+		}
+		_cancel = true;
+	}
+	_cv.notify_all();
+}
+
+void parallel_export::spill_error()
+{
+	fail(pr_write_error, MB2Wide(strerror(errno)), L"tmpfile()");
+}
+
+bool parallel_export::open_readers(const size_t count)
+{
+	//Reserved lock blocks commits of other connections (and their pending lock, which stops new readers).
+	//Main connection is not in transaction (see export_data), lock fails for read-only database only.
+	const bool hold = _db.ExecuteQuery("begin immediate");
+	if (!hold)
+		LOG_INFO("no write lock, readers may see different commits\n");
+
+	bool ok = true;
+	for (size_t i = 0; ok && i < count; ++i) {
+		_readers.emplace_back(new SQLiteDB(_db.GetDbFileName().c_str(), true));
+		SQLiteDB& db = *_readers.back();
+		//Read starts transaction (WAL snapshot or shared lock), kept until export ends
+		ok = db.Valid() && db.ExecuteQuery("begin") && db.ExecuteQuery("select count(*) from sqlite_master");
+		if (!ok)
+			fail(pr_read_error, db.LastError());
+	}
+	if (hold)
+		_db.ExecuteQuery("rollback");
+	return ok;
+}
+
+void parallel_export::read_worker()
+{
+	SQLiteDB& db = *_readers[_next_db++];
+	sqlite_statement stmt(db.GetDb());
+	std::string chunk, col_data;
+	size_t idx;
+	while (!_cancel && (idx = _next++) < _ranges.size()) {
+		if (!read_range(db, stmt, idx, chunk, col_data))
+			break;
+	}
+	{
+		std::lock_guard<std::mutex> lk(_lock);
+		--_running;
+	}
+	_cv.notify_all();
+}
+
+void parallel_export::format_worker()
+{
+	std::string chunk, col_data;
+	size_t idx;
+	while (!_cancel && (idx = _next++) < _ranges.size()) {
+		if (!format_range(*_ranges[idx], _widths, chunk, col_data))
+			break;
+	}
+	{
+		std::lock_guard<std::mutex> lk(_lock);
+		--_running;
+	}
+	_cv.notify_all();
+}
+
+bool parallel_export::read_range(SQLiteDB& db, sqlite_statement& stmt, const size_t idx, std::string& chunk, std::string& col_data)
+{
+	range& r = *_ranges[idx];
+	if (stmt.prepare(_query.c_str()) != SQLITE_OK || stmt.bind(1, r.from) != SQLITE_OK || stmt.bind(2, r.to) != SQLITE_OK) {
+		fail(pr_read_error, db.LastError());
+		return false;
+	}
+
+	const bool text = _fmt == exporter::fmt_text;
+	if (_parts) {
+		wchar_t num[16];
+		swprintf(num, sizeof(num) / sizeof(num[0]), L".%03u", static_cast<unsigned>(idx + 1));
+		r.part_name = _file_name;
+		const size_t slash = r.part_name.rfind(L'/');
+		const size_t dot = r.part_name.rfind(L'.');
+		r.part_name.insert(dot != std::wstring::npos && (slash == std::wstring::npos || dot > slash) ? dot : r.part_name.length(), num);
+		r.part.reset(new BufferedWriter());
+		if (!r.part->Open(r.part_name.c_str(), _out_flags)) {
+			fail(pr_write_error, r.part->ErrorText(), r.part_name);
+			return false;
+		}
+		if (_fmt == exporter::fmt_csv)
+			format_csv_header(_columns, chunk);
+	}
+	if (text)
+		r.widths = text_header_width(_columns);
+
+	int state = SQLITE_OK;
+	uint64_t count = 0;
+	auto next_row = [&]() {
+		++r.rows;
+		if (++count % 100 == 0)
+			_rows.fetch_add(100, std::memory_order_relaxed);
+		return !_cancel;
+	};
+	if (text) {
+		while ((state = stmt.step_execute()) == SQLITE_ROW) {
+			if (!scan_text_row(stmt, r.widths, r.spill, col_data)) {
+				spill_error();
+				return false;
+			}
+			if (!next_row())
+				return false;
+		}
+	}
+	else {
+		blob_stream blobs(db.GetDb(), _table, _columns);
+		auto flush = [&](std::string& out) {
+			return out.size() < PARALLEL_CHUNK_SIZE || emit(r, out);
+		};
+		if (!format_rows(_opts, stmt, _opts.stream_blobs ? &blobs : nullptr, chunk, next_row, flush, state)) {
+			if (!blobs.error().empty())
+				fail(pr_read_error, MB2Wide(blobs.error()));
+			return false;
+		}
+	}
+	_rows.fetch_add(count % 100, std::memory_order_relaxed);
+	if (state != SQLITE_DONE) {
+		fail(pr_read_error, db.LastError());
+		return false;
+	}
+
+	if (!text)
+		return emit(r, chunk) && finish_range(r);
+	if (!_parts)
+		return true;	//formatted after all ranges are read
+	//Part file has own columns width
+	format_text_header(_columns, r.widths, chunk);
+	return format_range(r, r.widths, chunk, col_data);
 }
 
+bool parallel_export::format_range(range& r, const std::vector<size_t>& widths, std::string& chunk, std::string& col_data)
+{
+	if (!r.spill.rewind()) {
+		spill_error();
+		return false;
+	}
+	for (uint64_t row = 0; row < r.rows; ++row) {
+		if (_cancel)
+			return false;
+		if (!format_text_row(r.spill, widths, chunk, col_data)) {
+			spill_error();
+			return false;
+		}
+		if (chunk.size() >= PARALLEL_CHUNK_SIZE && !emit(r, chunk))
+			return false;
+		if ((row + 1) % 100 == 0)
+			_rows.fetch_add(100, std::memory_order_relaxed);
+	}
+	_rows.fetch_add(r.rows % 100, std::memory_order_relaxed);
+	return emit(r, chunk) && finish_range(r);
+}
 
-bool exporter::export_data(const wchar_t* _db_object, const format fmt, const wchar_t* file_name) const
+bool parallel_export::emit(range& r, std::string& chunk)
+{
+	if (chunk.empty())
+		return true;
+	if (r.part) {
+		if (!r.part->Write(chunk)) {
+			fail(pr_write_error, r.part->ErrorText(), r.part_name);
+			return false;
+		}
+		chunk.clear();
+		return true;
+	}
+	{
+		//Writer is slower than workers, wait for it
+		std::unique_lock<std::mutex> lk(_lock);
+		_cv.wait(lk, [&] { return _cancel || r.chunks.size() < PARALLEL_MAX_CHUNKS; });
+		if (_cancel)
+			return false;
+		r.chunks.push_back(std::move(chunk));
+	}
+	_cv.notify_all();
+	chunk = std::string();
+	chunk.reserve(PARALLEL_CHUNK_SIZE + PARALLEL_CHUNK_SIZE / 4);
+	return true;
+}
+
+bool parallel_export::finish_range(range& r)
+{
+	if (r.part) {
+		if (!r.part->Close()) {
+			fail(pr_write_error, r.part->ErrorText(), r.part_name);
+			return false;
+		}
+		r.part.reset();
+		return true;
+	}
+	{
+		std::lock_guard<std::mutex> lk(_lock);
+		r.done = true;
+	}
+	_cv.notify_all();
+	return true;
+}
+
+}
+
+bool exporter::export_data(const wchar_t* _db_object, const format fmt, const wchar_t* file_name, const bool parts, const bool whole_blobs, const bool temp_file) const
 {
 	assert(_db_object && _db_object[0]);
 	assert(file_name && file_name[0]);
 
 	LOG_INFO("db_object: %S file: %S\n", _db_object, file_name);
 
-	//Get row count and  columns description
+	//Get columns description, row count estimate for progress only (table is read once)
 	uint64_t row_count = 0;
 	SQLiteDB::sq_columns columns_descr;
 	std::string db_object = Wide2MB(_db_object);
 
-	if( !_db->GetRowCount(db_object.c_str(), row_count) || !_db->ReadColumnDescription(db_object.c_str(), columns_descr) ) {
+	SQLiteDB::CancelScope cancel(*_db, progress::aborted);
+
+	if( !_db->ReadColumnDescription(db_object.c_str(), columns_descr) ) {
+		if( cancel.Cancelled() )
+			return false;
 		const std::wstring err_descr = _db->LastError();
 		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), _db->GetDbName().c_str(), err_descr.c_str() };
 		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
 		return false;
 	}
-
-	const size_t colimns_count = columns_descr.size();
+	if( !_db->GetRowCountEstimate(db_object.c_str(), row_count) )
+		row_count = 0;
 
 	progress prg_wnd(ps_reading, row_count);
 
-	//Get maximum with for each column
-	std::vector<size_t> columns_width(colimns_count);
-	if (fmt == fmt_text) {
-		std::string query = "select ";
-		for (size_t i = 0; i < columns_width.size(); ++i) {
-			if (i)
-				query += ", ";
-			query += "max(length([";
-			query += columns_descr[i].name;
-			query += "]))";
-		}
-		query += " from '";
-		query += db_object;
-		query += '\'';
+	//SQL dump: schema and transaction around data
+	const SQLiteDB::obj_type obj_type = _db->GetDbObjectType(db_object.c_str());
+	std::string header, footer;
+	if (fmt == fmt_csv)
+		format_csv_header(columns_descr, header);
+	else if (fmt == fmt_sql && !get_sql_frame(db_object, obj_type, header, footer)) {
+		prg_wnd.hide();
+		const std::wstring err_descr = _db->LastError();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), _db->GetDbName().c_str(), err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return false;
+	}
 
+	//Rows are read by rowid ranges and whole blobs by rowid, so table must have rowid
+	//(not a view, WITHOUT ROWID table or table with columns named as all rowid aliases)
+	sqlite3_int64 min_rowid, max_rowid;
+	const char* rowid = SQLiteDB::RowidAlias(columns_descr);
+	bool has_rowid = obj_type == SQLiteDB::ot_table && rowid;
+	has_rowid = has_rowid && get_rowid_range(db_object, rowid, min_rowid, max_rowid);
 
-		sqlite_statement stmt(_db->GetDb());
-		if (stmt.prepare(query.c_str()) == SQLITE_OK && stmt.step_execute() == SQLITE_ROW ) {
-			for (size_t i = 0; i < columns_width.size(); ++i)
-				columns_width[i] = stmt.get_int(static_cast<int>(i));
-		} else {
-			for (size_t i = 0; i < columns_width.size(); ++i)
-				columns_width[i] = 20;
+	format_options opts;
+	opts.fmt = fmt == fmt_jsonl ? rf_jsonl : fmt == fmt_sql ? rf_sql : rf_csv;
+	opts.columns = columns_descr.size();
+	if (fmt == fmt_jsonl)
+		opts.keys = jsonl_keys(columns_descr);
+	else if (fmt == fmt_sql)
+		opts.insert = sql_insert_prefix(db_object, columns_descr);
+	opts.whole_blobs = whole_blobs;
+	opts.stream_blobs = whole_blobs && has_rowid && (fmt == fmt_csv || fmt == fmt_jsonl || fmt == fmt_sql);
+
+	//Exported file is not read back, temporary file is opened in viewer
+	const unsigned out_flags = temp_file ? BufferedWriter::bw_default : BufferedWriter::bw_sequential;
+
+	//Big tables (and tables split to parts) are exported in parallel by rowid ranges,
+	//SQL dump is not split (schema and transaction are in one file),
+	//Arrow file is written serially (batches and footer with their offsets),
+	//workers' connections don't see open transaction, temp objects and attached databases of main connection
+	const size_t threads = std::min(static_cast<size_t>(std::thread::hardware_concurrency()), static_cast<size_t>(PARALLEL_MAX_THREADS));
+	if (threads > 1 && fmt != fmt_arrow && ((parts && fmt != fmt_sql) || row_count >= PARALLEL_MIN_ROWS) && has_rowid && !_db->HasSessionState()) {
+		parallel_export pe(*_db, db_object, rowid, columns_descr, fmt, opts);
+		switch (pe.run(min_rowid, max_rowid, threads, file_name, parts && fmt != fmt_sql, out_flags, prg_wnd, header, footer)) {
+		case parallel_export::pr_ok:
+			return true;
+		case parallel_export::pr_cancelled:
+			return false;
+		case parallel_export::pr_read_error: {
+			prg_wnd.hide();
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), _db->GetDbName().c_str(), pe.error_text().c_str() };
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+			return false;
+		}
+		case parallel_export::pr_write_error: {
+			prg_wnd.hide();
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), pe.error_file().c_str(), pe.error_text().c_str() };
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+			return false;
 		}
-		for (size_t i = 0; i < columns_width.size(); ++i) {
-			if (columns_width[i] < columns_descr[i].name.length())
-				columns_width[i] = columns_descr[i].name.length();
-			if (columns_width[i] > MAX_TEXT_LENGTH)
-				columns_width[i] = MAX_TEXT_LENGTH;
 		}
 	}
 
 	//Create output file
-	HANDLE file = CreateFile(file_name, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-	if (file == INVALID_HANDLE_VALUE) {
+	BufferedWriter file;
+	auto write_error = [&]() {
 		prg_wnd.hide();
-		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), file_name };
-		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		const std::wstring err_descr = file.ErrorText();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), file_name, err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
 		return false;
-	}
-	DWORD bytes_written;
+	};
+	if (!file.Open(file_name, out_flags))
+		return write_error();
+
+	//Arrow file without footer is unreadable: remove it if export fails
+	struct arrow_cleanup {
+		SQLiteDB& db;
+		BufferedWriter& file;
+		const wchar_t* file_name;
+		bool read_tx;	///< Read transaction for classes scan and export
+		bool done;
+		~arrow_cleanup()
+		{
+			if (read_tx)
+				db.ExecuteQuery("rollback");
+			if (!done) {
+				file.Close();
+				DeleteFile(file_name);
+			}
+		}
+	} arrow_done{*_db, file, file_name, false, fmt != fmt_arrow};
 
 	//Write BOM for text file
 	//if (fmt == fmt_text) {
 	//	const unsigned char utf16_bom[] = { 0xff, 0xfe };
-	//	WriteFile(file, utf16_bom, sizeof(utf16_bom), &bytes_written, nullptr);
+	//	file.Write(utf16_bom, sizeof(utf16_bom));
 	//}
 
-	//Write header (columns names)
+	//Write header (columns names for csv, schema for sql), text header is written after data read (column width)
 	std::string out_text;
-	for (size_t i = 0; i < colimns_count; ++i) {
-		if (fmt == fmt_csv) {
-			out_text += columns_descr[i].name;
-			if (i != colimns_count - 1)
-				out_text += ';';
-		}
-		else {
-			std::string col_name;
-			if (i)
-				col_name = ' ';
-			col_name += columns_descr[i].name;
-			col_name.resize(columns_width[i] + (i && i != colimns_count - 1 ? 2 : 1), ' ');
-			out_text += col_name;
-			if (i != colimns_count - 1)
-				out_text += "│";//0x2502;
-		}
-	}
-	out_text += "\n";
+	file.Write(header);
 
-	//Header separator
-	if (fmt == fmt_text) {
-		for (size_t i = 0; i < columns_descr.size(); ++i) {
-			std::u32string s(columns_width[i] + (i && i != colimns_count - 1 ? 2 : 1), u'─' /*0x2500*/);
-			std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> conv;
-			std::string _col_sep = conv.to_bytes(s);
-			out_text += _col_sep;
-			if (i != colimns_count - 1)
-				out_text += "┼";//0x253C;
-		}
-		out_text += "\n";
+	//View has no data in SQL dump
+	if (fmt == fmt_sql && obj_type != SQLiteDB::ot_table) {
+		if (!file.Write(footer) || !file.Close())
+			return write_error();
+		return true;
 	}
-	WriteFile(file, out_text.c_str(), static_cast<DWORD>(out_text.length() * sizeof(char)), &bytes_written, nullptr);
 
 	//Read data
-	std::string query = "select * from '";
-	query += db_object;
-	query += '\'';
+	const std::string query = select_query(db_object, columns_descr, opts.stream_blobs, rowid ? rowid : "rowid");
 	sqlite_statement stmt(_db->GetDb());
 	if (stmt.prepare(query.c_str()) != SQLITE_OK) {
 		prg_wnd.hide();
 		const std::wstring err_descr = _db->LastError();
 		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), _db->GetDbName().c_str(), err_descr.c_str() };
 		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
-		CloseHandle(file);
 		return false;
 	}
 
+	//Maximum width (characters) for each column
+	std::vector<size_t> columns_width = text_header_width(columns_descr);
+	row_spill spill;
+	ArrowWriter arrow(file, columns_descr);
+	auto arrow_error = [&]() {
+		if (arrow.Error().empty())
+			return write_error();
+		prg_wnd.hide();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), file_name, arrow.Error().c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return false;
+	};
+	if (fmt == fmt_arrow) {
+		//Column types are chosen by all values, not by the first batch: both reads see the same snapshot
+		arrow_done.read_tx = sqlite3_get_autocommit(_db->GetDb()) && _db->ExecuteQuery("begin");
+		if (!arrow.ScanClasses(_db->GetDb(), query) && cancel.Cancelled())
+			return false;
+	}
+
 	int count = 0;
 	int state = SQLITE_OK;
-	while ((state = stmt.step_execute()) == SQLITE_ROW) {
+	std::string col_data;
+	auto next_row = [&]() {
 		if (++count % 100 == 0)
 			prg_wnd.update(count);
-		if (progress::aborted()) {
-			CloseHandle(file);
-			return false;
-		}
-
-		out_text.clear();
-		for (int i = 0; i < static_cast<int>(colimns_count); ++i) {
-			std::string col_data;
-			get_text(stmt, i, col_data);
-			if (fmt == fmt_csv) {
-				const bool use_quote = columns_descr[i].type == SQLiteDB::ct_text && col_data.find(';') != std::string::npos;
-				if (use_quote) {
-					out_text += '"';
-					//Replace quote by double quote
-					size_t qpos = 0;
-					while ((qpos = col_data.find('"', qpos)) != std::string::npos) {
-						col_data.insert(qpos, 1, '"');
-						qpos += 2;
-					}
-				}
-				out_text += col_data;
-				if (use_quote)
-					out_text += '"';
-				if (i != static_cast<int>(colimns_count) - 1)
-					out_text += ';';
+		return !progress::aborted();
+	};
+	if (fmt == fmt_text || fmt == fmt_arrow) {
+		while ((state = stmt.step_execute()) == SQLITE_ROW) {
+			if (!next_row())
+				return false;
+			if (fmt == fmt_arrow) {
+				if (!arrow.AddRow(stmt))
+					return arrow_error();
 			}
-			else {
-				if (i)
-					col_data = " " + col_data;
-				col_data.resize(columns_width[i] + (i && i != static_cast<int>(colimns_count) - 1 ? 2 : 1), ' ');
-				if (col_data.size() > MAX_TEXT_LENGTH) {
-					col_data.erase(MAX_TEXT_LENGTH - 3);
-					col_data += "...";
-				}
-				out_text += col_data;
-				if (i != static_cast<int>(colimns_count) - 1)
-					out_text += "│";//0x2502;
+			else if (!scan_text_row(stmt, columns_width, spill, col_data)) {
+				prg_wnd.hide();
+				const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), L"tmpfile()" };
+				Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+				return false;
 			}
 		}
-		out_text += "\n";
-
-		if (!WriteFile(file, out_text.c_str(), static_cast<DWORD>(out_text.length() * sizeof(char)), &bytes_written, nullptr)) {
-			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), file_name };
-			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
-			CloseHandle(file);
+	}
+	else {
+		blob_stream blobs(_db->GetDb(), db_object, columns_descr);
+		auto flush = [&](std::string& out) {
+			if (out.size() < FORMAT_CHUNK_SIZE)
+				return true;
+			if (!file.Write(out))
+				return write_error();
+			out.clear();
+			return true;
+		};
+		if (!format_rows(opts, stmt, opts.stream_blobs ? &blobs : nullptr, out_text, next_row, flush, state)) {
+			if (!cancel.Cancelled() && !blobs.error().empty()) {
+				prg_wnd.hide();
+				const std::wstring err_descr = MB2Wide(blobs.error());
+				const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), _db->GetDbName().c_str(), err_descr.c_str() };
+				Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+			}
 			return false;
 		}
 	}
 
-	CloseHandle(file);
+	if (cancel.Cancelled()) {
+		return false;
+	}
 
 	if (state != SQLITE_DONE) {
 		prg_wnd.hide();
@@ -346,6 +1061,81 @@ bool exporter::export_data(const wchar_t* _db_object, const format fmt, const wc
 		return false;
 	}
 
+	if (fmt == fmt_text) {
+		format_text_header(columns_descr, columns_width, out_text);
+
+		//Rows
+		bool res = spill.rewind();
+		for (int row = 0; res && row < count; ++row) {
+			res = format_text_row(spill, columns_width, out_text, col_data);
+			if (res && out_text.size() >= FORMAT_CHUNK_SIZE) {
+				if (!file.Write(out_text))
+					return write_error();
+				out_text.clear();
+			}
+		}
+
+		if (!res) {
+			prg_wnd.hide();
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), L"tmpfile()" };
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+			return false;
+		}
+	}
+
+	if (fmt == fmt_arrow && !arrow.Finish())
+		return arrow_error();
+
+	//Rest of formatted rows
+	out_text += footer;
+	if (!file.Write(out_text) || !file.Close())
+		return write_error();
+	arrow_done.done = true;
+	return true;
+}
+
+
+bool exporter::get_sql_frame(const std::string& db_object, const SQLiteDB::obj_type type, std::string& header, std::string& footer) const
+{
+	std::string create_sql;
+	if (!_db->GetCreationSql(db_object.c_str(), create_sql))
+		return false;
+	header = "PRAGMA foreign_keys=OFF;\nBEGIN TRANSACTION;\n";
+	header += create_sql;
+	header += ";\n";
+
+	footer.clear();
+	if (type == SQLiteDB::ot_table) {
+		//Indexes and triggers are created after data (faster insert)
+		sqlite_statement stmt(_db->GetDb());
+		if (stmt.prepare("select sql from sqlite_master where tbl_name=? and type in ('index','trigger') and sql is not null") != SQLITE_OK ||
+			stmt.bind(1, db_object.c_str()) != SQLITE_OK)
+			return false;
+		while (stmt.step_execute() == SQLITE_ROW) {
+			footer += stmt.get_text(0);
+			footer += ";\n";
+		}
+		//AUTOINCREMENT counter (sqlite_sequence may not exist)
+		if (stmt.prepare("select seq from sqlite_sequence where name=?") == SQLITE_OK && stmt.bind(1, db_object.c_str()) == SQLITE_OK &&
+			stmt.step_execute() == SQLITE_ROW) {
+			footer += "DELETE FROM sqlite_sequence WHERE name=" + sql_quote(db_object, '\'') + ";\n";
+			footer += "INSERT INTO sqlite_sequence VALUES(" + sql_quote(db_object, '\'') + ',' + std::to_string(stmt.get_int64(0)) + ");\n";
+		}
+	}
+	footer += "COMMIT;\n";
+	return true;
+}
+
+
+bool exporter::get_rowid_range(const std::string& db_object, const char* rowid, sqlite3_int64& min_rowid, sqlite3_int64& max_rowid) const
+{
+	//Fails for views and WITHOUT ROWID tables
+	const std::string query = std::string("select min(") + rowid + "), max(" + rowid + ") from '" + db_object + "'";
+	sqlite_statement stmt(_db->GetDb());
+	if (stmt.prepare(query.c_str()) != SQLITE_OK || stmt.step_execute() != SQLITE_ROW || stmt.column_type(0) == SQLITE_NULL)
+		return false;
+	min_rowid = stmt.get_int64(0);
+	max_rowid = stmt.get_int64(1);
 	return true;
 }
 
@@ -373,18 +1163,9 @@ std::wstring exporter::get_temp_file_name(const wchar_t* ext)
 void exporter::get_text(const sqlite_statement& stmt, const int idx, std::string& data)
 {
 	if (stmt.column_type(idx) == SQLITE_BLOB) {
-		const int blob_len = stmt.get_length(idx);
-		data = "[";
-		data += std::to_string(blob_len);
-		data += "]:0x";
-		const unsigned char* blob_data = static_cast<const unsigned char*>(stmt.get_blob(idx));
-		for (int j = 0; j < blob_len && j < MAX_BLOB_LENGTH; ++j) {
-			char h[3];
-			snprintf(h, sizeof(h)/sizeof(h[0]), "%02x", blob_data[j]);
-			data += h;
-		}
-		if (blob_len >= MAX_BLOB_LENGTH)
-			data += "...";
+		const void* blob_data = stmt.get_blob(idx);
+		data.clear();
+		append_blob_text(data, blob_data, stmt.get_length(idx), MAX_BLOB_LENGTH);
 	}
 	else {
 		const char* txt = stmt.get_text(idx);
@@ -393,8 +1174,64 @@ void exporter::get_text(const sqlite_statement& stmt, const int idx, std::string
 		const size_t len = data.length();
 		for (size_t i = 0; i < len; ++i) {
 			char& sym = data[i];
-			if (sym < ' ')
+			if (static_cast<unsigned char>(sym) < ' ')
 				sym = ' ';
 		}
 	}
 }
+
+bool exporter::get_blob_text(sqlite3_blob* blob, std::string& data)
+{
+	unsigned char head[MAX_BLOB_LENGTH];
+	const int size = sqlite3_blob_bytes(blob);
+	data.clear();
+	if (sqlite3_blob_read(blob, head, std::min(size, MAX_BLOB_LENGTH), 0) != SQLITE_OK)
+		return false;
+	append_blob_text(data, head, size, MAX_BLOB_LENGTH);
+	return true;
+}
+
+std::string exporter::select_query(const std::string& table, const SQLiteDB::sq_columns& columns, const bool stream_blobs, const char* rowid)
+{
+	//typeof() doesn't read the value, so replaced blobs are not loaded
+	if (!stream_blobs)
+		return "select * from '" + table + "'";
+	std::string query = "select ";
+	std::string flags;
+	for (const auto& col : columns) {
+		const std::string name = sql_quote(col.name, '"');
+		query += "CASE WHEN typeof(" + name + ")='blob' THEN NULL ELSE " + name + " END,";
+		if (!flags.empty())
+			flags += "||";
+		flags += "(typeof(" + name + ")='blob')";
+	}
+	query += rowid;
+	query += ',';
+	query += flags.empty() ? std::string("''") : flags;
+	query += " from '" + table + "'";
+	return query;
+}
+
+const wchar_t* exporter::get_text(const sqlite_statement& stmt, const int idx, struct arena* a, size_t& len)
+{
+	std::string blob_text;
+	const char* txt;
+	size_t txt_len;
+
+	if (stmt.column_type(idx) == SQLITE_BLOB) {
+		get_text(stmt, idx, blob_text);
+		txt = blob_text.c_str();
+		txt_len = blob_text.length();
+	}
+	else {
+		txt = stmt.get_text(idx);
+		txt_len = txt ? static_cast<size_t>(stmt.get_length(idx)) : 0;
+	}
+
+	wchar_t* wtxt = static_cast<wchar_t*>(arena_alloc(a, (txt_len + 1) * sizeof(wchar_t)));
+	if (!wtxt)
+		return nullptr;
+	len = Utf8ToWideChar(txt, txt_len, wtxt, 1 /* replace unreadable symbols */);
+	wtxt[len] = 0;
+	return wtxt;
+}
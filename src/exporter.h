@@ -39,7 +39,10 @@ public:
 	//Export formats.
 	enum format {
 		fmt_csv,
-		fmt_text
+		fmt_text,
+		fmt_jsonl,	///< JSON Lines: object per row, blobs in base64
+		fmt_sql,		///< SQL dump: schema and multi-row INSERTs in transaction
+		fmt_arrow	///< Arrow IPC file: typed columns in record batches
 	};
 
 	/**
@@ -65,6 +68,36 @@ public:
 	 */
 	static void get_text(const sqlite_statement& stmt, const int idx, std::string& data);
 
+	/**
+	 * Get wide text from SQL statement (directly from column buffer).
+	 * \param stmt SQL statement
+	 * \param idx column index
+	 * \param a arena for the result string
+	 * \param len result string length (characters)
+	 * \return zero terminated string allocated in arena (nullptr on out of memory)
+	 */
+	static const wchar_t* get_text(const sqlite_statement& stmt, const int idx, struct arena* a, size_t& len);
+
+	/**
+	 * Get blob description from opened blob (only first bytes are read).
+	 * \param blob blob handle
+	 * \param data blob description ([size]:0x<hex>)
+	 * \return false on read error
+	 */
+	static bool get_blob_text(sqlite3_blob* blob, std::string& data);
+
+	/**
+	 * Get select query of table data.
+	 * If blobs are streamed they are replaced by NULL, rowid and blob flags
+	 * ("0010", one per column) are added after columns.
+	 * \param table table name
+	 * \param columns table columns description
+	 * \param stream_blobs replace blobs (to be read by incremental blob I/O)
+	 * \param rowid rowid alias not hidden by column name
+	 * \return select query
+	 */
+	static std::string select_query(const std::string& table, const SQLiteDB::sq_columns& columns, const bool stream_blobs, const char* rowid = "rowid");
+
 	/**
 	 * Get temporary file name.
 	 * \param ext file extension
@@ -78,9 +111,32 @@ private:
 	 * \param db_object DB object name (table or view)
 	 * \param fmt export format
 	 * \param file_name output file name
+	 * \param parts split table to part files (name.NNN.ext), one per worker
+	 * \param whole_blobs write whole blobs (csv), tables blobs are read by chunks
+	 * \param temp_file temporary file for viewer (written pages are kept in cache)
 	 * \return operation result status (false on error)
 	 */
-	bool export_data(const wchar_t* db_object, const format fmt, const wchar_t* file_name) const;
+	bool export_data(const wchar_t* db_object, const format fmt, const wchar_t* file_name, const bool parts = false, const bool whole_blobs = false, const bool temp_file = false) const;
+
+	/**
+	 * Get SQL dump statements around table data.
+	 * \param db_object DB object name
+	 * \param type DB object type
+	 * \param header transaction start and creation SQL
+	 * \param footer indexes, triggers and transaction commit
+	 * \return false on error
+	 */
+	bool get_sql_frame(const std::string& db_object, const SQLiteDB::obj_type type, std::string& header, std::string& footer) const;
+
+	/**
+	 * Get rowid range of table.
+	 * \param db_object table name
+	 * \param rowid rowid alias not hidden by column name
+	 * \param min_rowid minimal rowid
+	 * \param max_rowid maximal rowid
+	 * \return false if table has no rowid or is empty
+	 */
+	bool get_rowid_range(const std::string& db_object, const char* rowid, sqlite3_int64& min_rowid, sqlite3_int64& max_rowid) const;
 
 private:
 	std::unique_ptr<SQLiteDB> & _db;	///< DB instance
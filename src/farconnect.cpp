@@ -46,7 +46,7 @@ SHAREDSYMBOL int WINAPI _export ProcessEventW(HANDLE hPlugin,int event,void *par
 		clock_t t1 = clock();
 		LOG_INFO("FE_IDLE %p time %f\n", param, ((double)t1 - t) / CLOCKS_PER_SEC);
 		t = t1;
-		res = FALSE;
+		res = gSql->ProcessEvent(hPlugin, event, param);
 		}
 		break;
 	case FE_CLOSE:
@@ -7,10 +7,13 @@
 #include <utils.h>
 
 #include <common/log.h>
+#include <common/arena.h>
 
 extern const char * LOG_FILE;
 #define LOG_SOURCE_FILE "farpanel.cpp"
 
+std::map<const PluginPanelItem *, struct arena *> FarPanel::findDataArenas;
+
 FarPanel::FarPanel():
 	index(NO_PANEL_INDEX),
 	data(nullptr)
@@ -44,6 +47,11 @@ const wchar_t * FarPanel::GetPanelTitle(void)
 	return data->openInfo.PanelTitle;
 }
 
+int FarPanel::ProcessEvent(HANDLE hPlugin, int event, void * param)
+{
+	return int(false);
+}
+
 int FarPanel::SetDirectory(const wchar_t *dir, int opMode)
 {
 	LOG_INFO("\n");
@@ -88,9 +96,28 @@ bool FarPanel::IsPanelProcessKey(int key, unsigned int controlState) const
 	return GetPanelTitleKey(key, controlState) != 0;
 }
 
+void FarPanel::BindFindDataArena(const PluginPanelItem * panelItem, struct arena * a)
+{
+	assert( findDataArenas.find(panelItem) == findDataArenas.end() );
+	findDataArenas[panelItem] = a;
+}
+
+bool FarPanel::FreeFindDataArena(const PluginPanelItem * panelItem)
+{
+	auto it = findDataArenas.find(panelItem);
+	if( it == findDataArenas.end() )
+		return false;
+	LOG_INFO("arena size %zu\n", arena_size(it->second));
+	arena_destroy(it->second);
+	findDataArenas.erase(it);
+	return true;
+}
+
 void FarPanel::FreeFindData(struct PluginPanelItem * panelItem, int itemsNumber)
 {
 	LOG_INFO("\n");
+	if( FreeFindDataArena(panelItem) )
+		return;
 	while( itemsNumber-- ) {
 		while( (panelItem+itemsNumber)->CustomColumnNumber-- )
 			free((void *)(panelItem+itemsNumber)->CustomColumnData[(panelItem+itemsNumber)->CustomColumnNumber]);
@@ -3,8 +3,11 @@
 
 #include <farplug-wide.h>
 #include <memory>
+#include <map>
 #include "plugincfg.h"
 
+struct arena;
+
 #define NO_PANEL_INDEX (PanelIndex)(-1)
 
 struct PanelData {
@@ -26,8 +29,16 @@ class FarPanel: public PluginCfg {
 private:
 	PanelIndex index;
 	std::unique_ptr<PanelData> data;
+
+	// find data allocated from arena (items array and custom column data)
+	static std::map<const PluginPanelItem *, struct arena *> findDataArenas;
+protected:
+	static void BindFindDataArena(const PluginPanelItem * panelItem, struct arena * a);
 public:
+	static bool FreeFindDataArena(const PluginPanelItem * panelItem);
+
 	virtual int ProcessKey(HANDLE hPlugin, int key, unsigned int controlState, bool & change) = 0;
+	virtual int ProcessEvent(HANDLE hPlugin, int event, void * param);
 	virtual int GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber) = 0;
 	virtual void GetOpenPluginInfo(struct OpenPluginInfo * info);
 	virtual void FreeFindData(struct PluginPanelItem * panelItem, int itemsNumber);
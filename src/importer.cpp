@@ -0,0 +1,498 @@
+#include "importer.h"
+#include "csvreader.h"
+#include "progress.h"
+#include <cassert>
+#include <utils.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <charconv>
+
+#include <common/log.h>
+
+extern const char * LOG_FILE;
+#define LOG_SOURCE_FILE "importer.cpp"
+
+#define IMPORT_SAMPLE_ROWS 1000		// rows for column types inference
+#define IMPORT_BATCH_ROWS 100000	// rows per transaction
+#define IMPORT_PROGRESS_ROWS 4096	// rows between progress updates
+
+namespace {
+
+std::string quote_name(const std::string& name)
+{
+	std::string quoted = "\"";
+	for (const char c : name) {
+		if (c == '"')
+			quoted += '"';
+		quoted += c;
+	}
+	quoted += '"';
+	return quoted;
+}
+
+bool parse_int64(const char* data, const size_t size, sqlite3_int64& val)
+{
+	const auto res = std::from_chars(data, data + size, val);
+	return size && res.ec == std::errc() && res.ptr == data + size;
+}
+
+//Decimal point doesn't depend on locale; inf, nan and hex numbers are left as text
+bool parse_double(const char* data, size_t size, double& val)
+{
+	if (size && data[0] == '+') {
+		++data;
+		--size;
+	}
+	if (!size || !(isdigit(static_cast<unsigned char>(data[0])) || data[0] == '-' || data[0] == '.'))
+		return false;
+	for (size_t i = 0; i < size; ++i) {
+		if (data[i] == 'n' || data[i] == 'N')
+			return false;
+	}
+	const auto res = std::from_chars(data, data + size, val);
+	return res.ec == std::errc() && res.ptr == data + size;
+}
+
+//Column names of new table: empty name is replaced by cN, repeated name gets _2, _3... suffix
+void unique_names(std::vector<std::string>& names)
+{
+	auto used = [&names](const std::string& name, const size_t count) {
+		for (size_t i = 0; i < count; ++i) {
+			if (sqlite3_stricmp(names[i].c_str(), name.c_str()) == 0)
+				return true;
+		}
+		return false;
+	};
+	for (size_t i = 0; i < names.size(); ++i) {
+		if (names[i].empty())
+			names[i] = "c" + std::to_string(i + 1);
+		if (!used(names[i], i))
+			continue;
+		std::string name;
+		for (size_t n = 2; name.empty() || used(name, i); ++n)
+			name = names[i] + '_' + std::to_string(n);
+		names[i] = name;
+	}
+}
+
+SQLiteDB::col_type value_type(const CsvReader::Field& field)
+{
+	sqlite3_int64 ival;
+	double dval;
+	if (parse_int64(field.data, field.size, ival))
+		return SQLiteDB::ct_integer;
+	if (parse_double(field.data, field.size, dval))
+		return SQLiteDB::ct_float;
+	return SQLiteDB::ct_text;
+}
+
+//Numbers are bound by value for numeric columns (no affinity conversion), empty field is NULL
+int bind_field(sqlite_statement& stmt, const int idx, const SQLiteDB::col_type type, const CsvReader::Field& field)
+{
+	if (type == SQLiteDB::ct_integer || type == SQLiteDB::ct_float) {
+		sqlite3_int64 ival;
+		double dval;
+		if (!field.size)
+			return stmt.bind_null(idx);
+		if (type == SQLiteDB::ct_integer && parse_int64(field.data, field.size, ival))
+			return stmt.bind(idx, ival);
+		if (parse_double(field.data, field.size, dval))
+			return stmt.bind(idx, dval);
+	}
+	return stmt.bind_static(idx, field.data, static_cast<int>(field.size));
+}
+
+} // namespace
+
+importer::importer(std::unique_ptr<SQLiteDB> & db)
+: FarPanel(), _db(db)
+{
+	assert(_db);
+}
+
+bool importer::import_data(const wchar_t* table_name) const
+{
+	LOG_INFO("\n");
+
+	std::wstring dst_table;
+	if (table_name)
+		dst_table = table_name;
+	else if (PluginPanelItem * ppi = GetCurrentPanelItem()) {
+		if (Plugin::FSF.LStricmp(ppi->FindData.lpwszFileName, L"..") != 0 && ppi->FindData.nPhysicalSize == SQLiteDB::ot_table)
+			dst_table = ppi->FindData.lpwszFileName;
+		FreePanelItem(ppi);
+	}
+
+	//Get source path
+	std::wstring src_file_name;
+	wchar_t dir[512];
+	Plugin::psi.Control(PANEL_PASSIVE,FCTL_GETPANELDIR,sizeof(dir)/sizeof(dir[0]),(LONG_PTR)dir);
+	src_file_name = dir;
+
+	if (!src_file_name.empty() && *src_file_name.rbegin() != L'/')
+		src_file_name += L'/';
+	src_file_name += dst_table.empty() ? L"data" : dst_table;
+	src_file_name += L".csv";
+
+	FarDialogItem dlg_items[15];
+	memset(dlg_items, 0, sizeof(dlg_items));
+
+	dlg_items[0].Type = DI_DOUBLEBOX;
+	dlg_items[0].X1 = 3;
+	dlg_items[0].X2 = 56;
+	dlg_items[0].Y1 = 1;
+	dlg_items[0].Y2 = 12;
+	dlg_items[0].PtrData = GetMsg(ps_imp_title);
+
+	dlg_items[1].Type = DI_TEXT;
+	dlg_items[1].X1 = 5;
+	dlg_items[1].X2 = 54;
+	dlg_items[1].Y1 = 2;
+	dlg_items[1].PtrData = GetMsg(ps_imp_main);
+
+	dlg_items[2].Type = DI_EDIT;
+	dlg_items[2].X1 = 5;
+	dlg_items[2].X2 = 54;
+	dlg_items[2].Y1 = 3;
+	dlg_items[2].PtrData = src_file_name.c_str();
+
+	dlg_items[3].Type = DI_TEXT;
+	dlg_items[3].X1 = 5;
+	dlg_items[3].X2 = 54;
+	dlg_items[3].Y1 = 4;
+	dlg_items[3].PtrData = GetMsg(ps_imp_table);
+
+	dlg_items[4].Type = DI_EDIT;
+	dlg_items[4].X1 = 5;
+	dlg_items[4].X2 = 54;
+	dlg_items[4].Y1 = 5;
+	dlg_items[4].PtrData = dst_table.c_str();
+
+	dlg_items[5].Type = DI_TEXT;
+	dlg_items[5].Y1 = 6;
+	dlg_items[5].Flags = DIF_SEPARATOR;
+
+	dlg_items[6].Type = DI_TEXT;
+	dlg_items[6].X1 = 5;
+	dlg_items[6].X2 = 20;
+	dlg_items[6].Y1 = 7;
+	dlg_items[6].PtrData = GetMsg(ps_imp_sep);
+
+	dlg_items[7].Type = DI_RADIOBUTTON;
+	dlg_items[7].X1 = 21;
+	dlg_items[7].X2 = 30;
+	dlg_items[7].Y1 = 7;
+	dlg_items[7].PtrData = GetMsg(ps_imp_comma);
+	dlg_items[7].Selected = 1;
+
+	dlg_items[8].Type = DI_RADIOBUTTON;
+	dlg_items[8].X1 = 31;
+	dlg_items[8].X2 = 44;
+	dlg_items[8].Y1 = 7;
+	dlg_items[8].PtrData = GetMsg(ps_imp_semicolon);
+
+	dlg_items[9].Type = DI_RADIOBUTTON;
+	dlg_items[9].X1 = 45;
+	dlg_items[9].X2 = 54;
+	dlg_items[9].Y1 = 7;
+	dlg_items[9].PtrData = GetMsg(ps_imp_tab);
+
+	dlg_items[10].Type = DI_CHECKBOX;
+	dlg_items[10].X1 = 5;
+	dlg_items[10].X2 = 54;
+	dlg_items[10].Y1 = 8;
+	dlg_items[10].PtrData = GetMsg(ps_imp_header);
+	dlg_items[10].Selected = 1;
+
+	dlg_items[11].Type = DI_CHECKBOX;
+	dlg_items[11].X1 = 5;
+	dlg_items[11].X2 = 54;
+	dlg_items[11].Y1 = 9;
+	dlg_items[11].PtrData = GetMsg(ps_imp_fast);
+
+	dlg_items[12].Type = DI_TEXT;
+	dlg_items[12].Y1 = 10;
+	dlg_items[12].Flags = DIF_SEPARATOR;
+
+	dlg_items[13].Type = DI_BUTTON;
+	dlg_items[13].PtrData = GetMsg(ps_imp_imp);
+	dlg_items[13].Y1 = 11;
+	dlg_items[13].Flags = DIF_CENTERGROUP;
+	dlg_items[13].Focus = 1;
+	dlg_items[13].DefaultButton = 1;
+
+	dlg_items[14].Type = DI_BUTTON;
+	dlg_items[14].PtrData = GetMsg(ps_cancel);
+	dlg_items[14].Y1 = 11;
+	dlg_items[14].Flags = DIF_CENTERGROUP;
+
+	const HANDLE dlg = Plugin::psi.DialogInit(Plugin::psi.ModuleNumber, -1, -1, 60, 14, nullptr, dlg_items, sizeof(dlg_items) / sizeof(dlg_items[0]), 0, 0, nullptr, (LONG_PTR)0);
+	const intptr_t rc = Plugin::psi.DialogRun(dlg);
+	if (rc < 0 || rc == 14 /* cancel */) {
+		Plugin::psi.DialogFree(dlg);
+		return false;
+	}
+	src_file_name = reinterpret_cast<const wchar_t*>(Plugin::psi.SendDlgMessage(dlg, DM_GETCONSTTEXTPTR, 2, (LONG_PTR)0));
+	dst_table = reinterpret_cast<const wchar_t*>(Plugin::psi.SendDlgMessage(dlg, DM_GETCONSTTEXTPTR, 4, (LONG_PTR)0));
+	char sep = ',';
+	if (Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, 8, (LONG_PTR)0) == BSTATE_CHECKED)
+		sep = ';';
+	else if (Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, 9, (LONG_PTR)0) == BSTATE_CHECKED)
+		sep = '\t';
+	const bool header = Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, 10, (LONG_PTR)0) == BSTATE_CHECKED;
+	const bool fast_load = Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, 11, (LONG_PTR)0) == BSTATE_CHECKED;
+	Plugin::psi.DialogFree(dlg);
+
+	//Table name by default is source file name without extension
+	if (dst_table.empty()) {
+		dst_table = src_file_name.substr(src_file_name.rfind(L'/') + 1);
+		const size_t ext_pos = dst_table.rfind(L'.');
+		if (ext_pos != std::wstring::npos && ext_pos)
+			dst_table.erase(ext_pos);
+	}
+
+	const bool ret = import_data(src_file_name.c_str(), Wide2MB(dst_table.c_str()), sep, header, fast_load);
+	Plugin::psi.Control(PANEL_ACTIVE, FCTL_UPDATEPANEL, 0, 0);
+	PanelRedrawInfo pri;
+	memset(&pri, 0, sizeof(pri));
+	Plugin::psi.Control(PANEL_ACTIVE, FCTL_REDRAWPANEL, 0, (LONG_PTR)&pri);
+	return ret;
+}
+
+bool importer::import_data(const wchar_t* file_name, const std::string& table_name, const char sep, const bool header, const bool fast_load) const
+{
+	assert(file_name && file_name[0]);
+
+	LOG_INFO("import: %S -> %s\n", file_name, table_name.c_str());
+
+	const auto start = std::chrono::steady_clock::now();
+
+	CsvReader reader;
+	std::vector<CsvReader::Field> fields;
+	if (!reader.Open(file_name, sep)) {
+		const std::wstring err_descr = reader.ErrorText();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_readf), file_name, err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return false;
+	}
+
+	progress prg_wnd(ps_importing, reader.Size());
+
+	//First rows are read to infer column types, they are inserted before the rest of file
+	std::vector<std::string> names;
+	std::vector<std::vector<std::string>> sample;
+	if (header && reader.ReadRecord(fields)) {
+		for (const auto& field : fields)
+			names.emplace_back(field.data, field.size);
+	}
+	while (sample.size() < IMPORT_SAMPLE_ROWS && reader.ReadRecord(fields)) {
+		sample.emplace_back();
+		for (const auto& field : fields)
+			sample.back().emplace_back(field.data, field.size);
+	}
+	if (reader.Error()) {
+		prg_wnd.hide();
+		const std::wstring err_descr = reader.ErrorText();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_readf), file_name, err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return false;
+	}
+
+	//Column types: declared for existing table, inferred from sample for new one
+	std::vector<SQLiteDB::col_type> types;
+	std::string query, create;
+	if (_db->GetDbObjectType(table_name.c_str()) == SQLiteDB::ot_table) {
+		SQLiteDB::sq_columns columns;
+		if (!_db->ReadColumnDescription(table_name.c_str(), columns)) {
+			prg_wnd.hide();
+			const std::wstring err_descr = _db->LastError();
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), _db->GetDbName().c_str(), err_descr.c_str() };
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+			return false;
+		}
+		if (names.empty()) {
+			for (const auto& col : columns)
+				types.push_back(col.type);
+		}
+		for (const auto& name : names) {
+			SQLiteDB::col_type type = SQLiteDB::ct_text;
+			for (const auto& col : columns) {
+				if (sqlite3_stricmp(col.name.c_str(), name.c_str()) == 0)
+					type = col.type;
+			}
+			types.push_back(type);
+		}
+	}
+	else {
+		size_t col_count = names.size();
+		for (const auto& row : sample)
+			col_count = std::max(col_count, row.size());
+		names.resize(col_count);
+		unique_names(names);
+		create = "create table " + quote_name(table_name) + " (";
+		for (size_t i = 0; i < col_count; ++i) {
+			bool has_values = false;
+			SQLiteDB::col_type type = SQLiteDB::ct_integer;
+			for (const auto& row : sample) {
+				if (i >= row.size() || row[i].empty() || type == SQLiteDB::ct_text)
+					continue;
+				const CsvReader::Field field = { row[i].c_str(), row[i].size() };
+				const SQLiteDB::col_type val_type = value_type(field);
+				if (val_type != SQLiteDB::ct_integer)
+					type = val_type;
+				has_values = true;
+			}
+			if (!has_values)
+				type = SQLiteDB::ct_text;
+			types.push_back(type);
+			if (i)
+				create += ", ";
+			create += quote_name(names[i]);
+			create += type == SQLiteDB::ct_integer ? " INTEGER" : (type == SQLiteDB::ct_float ? " REAL" : " TEXT");
+		}
+		create += ')';
+		LOG_INFO("create: %s\n", create.c_str());
+	}
+
+	//One prepared insert for all rows, columns are set by header names or by position
+	query = "insert into " + quote_name(table_name);
+	if (!names.empty()) {
+		query += " (";
+		for (size_t i = 0; i < names.size(); ++i) {
+			if (i)
+				query += ", ";
+			query += quote_name(names[i]);
+		}
+		query += ')';
+	}
+	query += " values (";
+	for (size_t i = 0; i < types.size(); ++i)
+		query += i ? ",?" : "?";
+	query += ')';
+
+	//Fast load: no fsync and rollback journal in memory (database may be corrupted by crash during import)
+	int synchronous = -1;
+	std::string journal_mode;
+	if (fast_load) {
+		sqlite_statement pragma(_db->GetDb());
+		if (pragma.prepare("pragma synchronous") == SQLITE_OK && pragma.step_execute() == SQLITE_ROW)
+			synchronous = pragma.get_int(0);
+		if (pragma.prepare("pragma journal_mode") == SQLITE_OK && pragma.step_execute() == SQLITE_ROW && pragma.get_text(0))
+			journal_mode = pragma.get_text(0);
+		pragma.close();
+		_db->ExecuteQuery("pragma synchronous=OFF");
+		_db->ExecuteQuery("pragma journal_mode=MEMORY");
+	}
+
+	sqlite_statement stmt(_db->GetDb());
+	uint64_t rows = 0, committed = 0, record = header ? 1 : 0;
+	bool aborted = false;
+	//New table is created in the first transaction and dropped if import is not finished,
+	//rows committed to existing table are reported
+	int rc = _db->ExecuteQuery("begin") ? SQLITE_OK : SQLITE_ERROR;
+	const bool create_failed = rc == SQLITE_OK && !create.empty() && !_db->ExecuteQuery(create.c_str());
+	if (create_failed)
+		rc = SQLITE_ERROR;
+	if (rc == SQLITE_OK)
+		rc = stmt.prepare(query.c_str());
+
+	auto insert_row = [&](const std::vector<CsvReader::Field>& row) {
+		for (size_t i = 0; i < types.size() && rc == SQLITE_OK; ++i)
+			rc = i < row.size() ? bind_field(stmt, static_cast<int>(i) + 1, types[i], row[i]) : stmt.bind_null(static_cast<int>(i) + 1);
+		if (rc == SQLITE_OK)
+			rc = stmt.step_execute() == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+		stmt.reset();
+		if (rc != SQLITE_OK)
+			return false;
+		if (++rows % IMPORT_BATCH_ROWS == 0) {
+			if (!_db->ExecuteQuery("commit")) {
+				rc = SQLITE_ERROR;
+				return false;
+			}
+			committed = rows;
+			if (!_db->ExecuteQuery("begin")) {
+				rc = SQLITE_ERROR;
+				return false;
+			}
+		}
+		if (rows % IMPORT_PROGRESS_ROWS == 0) {
+			prg_wnd.update(reader.Offset());
+			if (progress::aborted()) {
+				aborted = true;
+				return false;
+			}
+		}
+		return true;
+	};
+
+	for (auto it = sample.begin(); rc == SQLITE_OK && it != sample.end(); ++it) {
+		fields.resize(it->size());
+		for (size_t i = 0; i < it->size(); ++i)
+			fields[i] = { (*it)[i].c_str(), (*it)[i].size() };
+		++record;
+		if (!insert_row(fields))
+			break;
+	}
+	if (rc == SQLITE_OK && !aborted && sample.size() == IMPORT_SAMPLE_ROWS) {
+		while (reader.ReadRecord(fields)) {
+			record = reader.Records();
+			if (!insert_row(fields))
+				break;
+		}
+	}
+
+	const std::wstring err_descr = _db->LastError();
+	stmt.close();
+	const bool ok = rc == SQLITE_OK && !aborted && !reader.Error() && _db->ExecuteQuery("commit");
+	if (!ok) {
+		_db->ExecuteQuery("rollback");
+		if (!create.empty() && committed && _db->ExecuteQuery(("drop table " + quote_name(table_name)).c_str()))
+			committed = 0;
+	}
+
+	if (fast_load) {
+		if (!journal_mode.empty())
+			_db->ExecuteQuery(("pragma journal_mode=" + journal_mode).c_str());
+		if (synchronous >= 0)
+			_db->ExecuteQuery(("pragma synchronous=" + std::to_string(synchronous)).c_str());
+	}
+
+	LOG_INFO("imported %llu rows in %lld ms\n", static_cast<unsigned long long>(rows),
+		static_cast<long long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count()));
+
+	if (ok)
+		return true;
+
+	//Number of committed rows is the last line of message (omitted if nothing is left)
+	wchar_t committed_descr[128];
+	swprintf(committed_descr, sizeof(committed_descr) / sizeof(committed_descr[0]), GetMsg(ps_imp_committed), static_cast<unsigned long long>(committed));
+	const size_t committed_line = committed ? 1 : 0;
+
+	prg_wnd.hide();
+	if (aborted) {
+		if (committed) {
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), committed_descr };
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		}
+	}
+	else if (reader.Error()) {
+		const std::wstring read_err = reader.ErrorText();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_readf), file_name, read_err.c_str(), committed_descr };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]) - 1 + committed_line, 0);
+	}
+	else if (create_failed) {
+		const std::wstring query_descr = MB2Wide(create.c_str());
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), _db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str()};
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+	}
+	else {
+		wchar_t record_descr[64];
+		swprintf(record_descr, sizeof(record_descr) / sizeof(record_descr[0]), GetMsg(ps_err_record), static_cast<unsigned long long>(record));
+		const std::wstring query_descr = MB2Wide(query.c_str());
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), _db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str(), record_descr, committed_descr};
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]) - 1 + committed_line, 0);
+	}
+	return false;
+}
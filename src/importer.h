@@ -0,0 +1,44 @@
+#ifndef __IMPORTER_H__
+#define __IMPORTER_H__
+
+#include "plugin.h"
+#include "farpanel.h"
+#include <sqlite/sqlitedb.h>
+
+// CSV/TSV import: file is parsed by blocks, rows are inserted by one prepared
+// statement in large batched transactions.
+class importer : FarPanel
+{
+public:
+	/**
+	 * Constructor.
+	 * \param db DB instance
+	 */
+	importer(std::unique_ptr<SQLiteDB> & db);
+
+	int ProcessKey(HANDLE hPlugin, int key, unsigned int controlState, bool & change) override {return 0;};
+	int GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber) override {return 0;};
+
+	/**
+	 * Import data from file (GUI mode).
+	 * \param table_name target table name (current panel item if nullptr)
+	 * \return operation result status (false on error or cancel)
+	 */
+	bool import_data(const wchar_t* table_name = nullptr) const;
+
+	/**
+	 * Import data from file.
+	 * \param file_name source file name
+	 * \param table_name target table name (created with types inferred from first rows if not exists)
+	 * \param sep field separator
+	 * \param header first record contains column names
+	 * \param fast_load synchronous=OFF and journal_mode=MEMORY while loading
+	 * \return operation result status (false on error or cancel)
+	 */
+	bool import_data(const wchar_t* file_name, const std::string& table_name, const char sep, const bool header, const bool fast_load) const;
+
+private:
+	std::unique_ptr<SQLiteDB> & _db;	///< DB instance
+};
+
+#endif //__IMPORTER_H__
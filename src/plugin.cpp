@@ -96,6 +96,11 @@ int Plugin::ProcessKey(HANDLE hPlugin,int key,unsigned int controlState)
 	return res;
 }
 
+int Plugin::ProcessEvent(HANDLE hPlugin,int event,void *param)
+{
+	return static_cast<FarPanel *>(hPlugin)->ProcessEvent(hPlugin, event, param);
+}
+
 int Plugin::SetDirectory(HANDLE hPlugin, const wchar_t *dir, int opMode)
 {
 	LOG_INFO("\n");
@@ -41,6 +41,7 @@ class Plugin {
 		virtual int SetDirectory(HANDLE hPlugin, const wchar_t *dir, int opMode);
 		virtual int DeleteFiles(HANDLE hPlugin, struct PluginPanelItem *panelItem, int itemsNumber, int opMode);
 		virtual int ProcessKey(HANDLE hPlugin,int key,unsigned int controlState);
+		virtual int ProcessEvent(HANDLE hPlugin,int event,void *param);
 		virtual int Configure(int itemNumber);
 };
 
@@ -23,12 +23,16 @@ const char * LOG_FILE = initial_log;
 #define INI_LOCATION InMyConfig("plugins/sql/config.ini")
 #define INI_SECTION "Settings"
 #define DEFAULT_PREFIX L"sql"
+#define DEFAULT_TABLE_PAGE_SIZE 10000
+#define DEFAULT_TABLE_MEMORY_LIMIT 64
+#define DEFAULT_PROFILE_LOG InMyConfig("plugins/sql/profile.log")
 
 const char * PluginCfg::GetPanelName(PanelIndex index) const
 {
 	static const char * names[] = {
 		"SqliteDb",	// SqliteDbPanelIndex,
 		"SqliteTable",	// SqliteTablePanelIndex,
+		"SqliteSpace",	// SqliteSpacePanelIndex,
 		"max"		// MaxPanelIndex
 	};
 	assert( index < (ARRAYSIZE(names)-1) );
@@ -38,16 +42,16 @@ const char * PluginCfg::GetPanelName(PanelIndex index) const
 size_t PluginCfg::init = 0;
 std::map<PanelIndex, CfgDefaults> PluginCfg::def = {\
 		{SqliteDbPanelIndex, {
-		L"N,C0,SF",
-		L"0,8,10",
+		L"N,C0,C1",
+		L"0,8,12",
 		// name                       N
 		// type                       C0
-		// size                       SF
-		{L"N,C0,SF", L"N,C0,SF"},
-		{L"0,8,10", L"0,8,10"},
-		{{L"name",L"type",L"size", 0}, {L"name",L"type",L"size",0}},
+		// rows (~estimate, ?pending) C1
+		{L"N,C0,C1", L"N,C0,C1"},
+		{L"0,8,12", L"0,8,12"},
+		{{L"name",L"type",L"rows", 0}, {L"name",L"type",L"rows",0}},
 		{0,MF2,0,MF4DDL,MF5Export,MF6SQL,MEmptyString,0,0,0,0,0},
-		{MEmptyString,MEmptyString,MEmptyString,MF4Pragma,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString},
+		{MEmptyString,MEmptyString,MEmptyString,MF4Pragma,MF5Import,MF6SQLFile,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString},
 		MPanelSqlTitle,
 		MFormatSqlitePanel,
 		OPIF_USEFILTER|OPIF_USEHIGHLIGHTING|OPIF_SHOWPRESERVECASE|OPIF_ADDDOTS
@@ -60,16 +64,40 @@ std::map<PanelIndex, CfgDefaults> PluginCfg::def = {\
 		{L"0", L"0"},
 		{{L"id", 0}, {L"id",0}},
 		{0,MF2,MEmptyString,MF4,MEmptyString,MF6SQL,MEmptyString,0,0,0,0,0},
-		{MEmptyString,MEmptyString,MEmptyString,MF4Create,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString},
+		{MEmptyString,MEmptyString,MEmptyString,MF4Create,MF5Import,MF6SQLFile,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString},
 		MPanelSqlTitle,
 		MFormatSqlitePanel,
 		OPIF_USEFILTER|OPIF_USEHIGHLIGHTING|OPIF_SHOWPRESERVECASE
 		}},
+		{SqliteSpacePanelIndex, {
+		L"N,C0,S",
+		L"0,6,10",
+		// name                       N
+		// type                       C0
+		// size                       S
+		// pages                      C1
+		// payload                    C2
+		// unused                     C3
+		// overflow pages             C4
+		// fanout                     C5
+		// fragmentation              C6
+		{L"N,C0,S,C1,C2,C3,C4,C5,C6", L"N,C0,S,C1,C2,C3,C4,C5,C6"},
+		{L"0,6,10,8,11,10,8,7,6", L"0,6,10,8,11,10,8,7,6"},
+		{{L"name",L"type",L"size",L"pages",L"payload",L"unused",L"overflow",L"fanout",L"frag%",0}, {L"name",L"type",L"size",L"pages",L"payload",L"unused",L"overflow",L"fanout",L"frag%",0}},
+		{0,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MF6SQL,MEmptyString,0,0,0,0,0},
+		{MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MF6SQLFile,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString,MEmptyString},
+		MPanelSqlTitle,
+		MFormatSqlitePanel,
+		OPIF_USEFILTER|OPIF_USEHIGHLIGHTING|OPIF_SHOWPRESERVECASE|OPIF_ADDDOTS
+		}},
 		};
 
 bool PluginCfg::logEnable = true;
 bool PluginCfg::sqlAddToDisksMenu = false;
 bool PluginCfg::sqlAddToPluginsMenu = false;
+uint32_t PluginCfg::tablePageSize = DEFAULT_TABLE_PAGE_SIZE;
+uint32_t PluginCfg::tableMemoryLimit = DEFAULT_TABLE_MEMORY_LIMIT;
+std::string PluginCfg::profileLog;
 
 void PluginCfg::ReloadPanelKeyBar(struct PanelData * data, PanelIndex index)
 {
@@ -157,6 +185,12 @@ PluginCfg::PluginCfg()
 
 		prefix = kfr.GetString("prefix", DEFAULT_PREFIX);
 
+		tablePageSize = (uint32_t)kfr.GetInt("tablePageSize", DEFAULT_TABLE_PAGE_SIZE);
+		tableMemoryLimit = (uint32_t)kfr.GetInt("tableMemoryLimit", DEFAULT_TABLE_MEMORY_LIMIT);
+		if( !tableMemoryLimit )
+			tableMemoryLimit = DEFAULT_TABLE_MEMORY_LIMIT;
+		profileLog = kfr.GetString("profileLog", DEFAULT_PROFILE_LOG.c_str());
+
 		logEnable = (bool)kfr.GetInt("logEnable", true);
 	       	if( logEnable ) {
 			std::string logfile = kfr.GetString("logfile", initial_log);
@@ -243,6 +277,9 @@ void PluginCfg::SaveConfig(void) const
 	kfh.SetString(INI_SECTION, "logfile", _logfile);
 	kfh.SetInt(INI_SECTION, "logEnable", logEnable);
 	kfh.SetString(INI_SECTION, "prefix", prefix.c_str());
+	kfh.SetInt(INI_SECTION, "tablePageSize", tablePageSize);
+	kfh.SetInt(INI_SECTION, "tableMemoryLimit", tableMemoryLimit);
+	kfh.SetString(INI_SECTION, "profileLog", profileLog);
 	kfh.Save();
 }
 
@@ -38,6 +38,7 @@ typedef struct {
 typedef enum {
 	SqliteDbPanelIndex,
 	SqliteTablePanelIndex,
+	SqliteSpacePanelIndex,
 	MaxPanelIndex
 } PanelIndex;
 
@@ -61,6 +62,13 @@ class PluginCfg : public FarApi {
 
 		static bool sqlAddToDisksMenu;
 		static bool sqlAddToPluginsMenu;
+
+		// table panel keyset paging (0 - read whole table)
+		static uint32_t tablePageSize;
+		// memory limit for loaded table pages (Mb)
+		static uint32_t tableMemoryLimit;
+		// query profiles are appended to this file
+		static std::string profileLog;
 		std::wstring prefix;
 
 		void FillPanelData(struct PanelData * data, PanelIndex index);
@@ -20,6 +20,7 @@
 #include "progress.h"
 #include "sqllng.h"
 #include <cassert>
+#include <algorithm>
 
 #define PROGRESS_WIDTH 30
 
@@ -46,14 +47,13 @@ void progress::show()
 		Plugin::psi.AdvControl(Plugin::psi.ModuleNumber, ACTL_SETPROGRESSSTATE, (void*)PGS_INDETERMINATE, 0);
 	}
 
-	if (_bar.empty()) {
-		const wchar_t* msg[] = { _title, _message };
-		Plugin::psi.Message(Plugin::psi.ModuleNumber, 0,  nullptr, msg, sizeof(msg) / sizeof(msg[0]), 0);
-	}
-	else {
-		const wchar_t* msg[] = { _title, _message, _bar.c_str() };
-		Plugin::psi.Message(Plugin::psi.ModuleNumber, 0,  nullptr, msg, sizeof(msg) / sizeof(msg[0]), 0);
-	}
+	const wchar_t* msg[4] = { _title, _message };
+	int count = 2;
+	if (!_bar.empty())
+		msg[count++] = _bar.c_str();
+	if (!_info.empty())
+		msg[count++] = _info.c_str();
+	Plugin::psi.Message(Plugin::psi.ModuleNumber, 0,  nullptr, msg, count, 0);
 }
 
 
@@ -74,7 +74,8 @@ void progress::update(const uint64_t val)
 	if (!_max_value)
 		return;
 
-	const size_t percent = static_cast<size_t>((val * 100) / _max_value);
+	// max value may be an estimate
+	const size_t percent = static_cast<size_t>((std::min(val, _max_value) * 100) / _max_value);
 	assert(percent <= 100);
 
 	PROGRESSVALUE pv;
@@ -92,6 +93,15 @@ void progress::update(const uint64_t val)
 	show();
 }
 
+void progress::update(const uint64_t val, const std::wstring& info)
+{
+	_info = info;
+	if (_max_value)
+		update(val);
+	else
+		show();
+}
+
 bool progress::aborted()
 {
 	HANDLE std_in = 0; // Incorrect emulation - GetStdHandle(STD_INPUT_HANDLE) return non-zero
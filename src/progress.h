@@ -51,6 +51,13 @@ public:
 	 */
 	void update(const uint64_t val);
 
+	/**
+	 * Set progress value and info line.
+	 * \param val new progress value
+	 * \param info text shown under the progress bar
+	 */
+	void update(const uint64_t val, const std::wstring& info);
+
 	/**
 	 * Check for abort request.
 	 * \return true if user requested abort
@@ -63,6 +70,7 @@ private:
 	const wchar_t*		_message;	///< Window message
 	uint64_t	_max_value;	///< Maximum progress value
 	std::wstring				_bar;		///< Progress bar
+	std::wstring				_info;		///< Info line
 };
 
 #endif //__PROGRESS_H__
\ No newline at end of file
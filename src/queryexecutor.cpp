@@ -0,0 +1,223 @@
+#include "queryexecutor.h"
+#include "exporter.h"
+#include <sqlite/profiler.h>
+#include <chrono>
+#include <system_error>
+#include <utils.h>
+
+#include <common/log.h>
+#include <common/arena.h>
+
+extern const char * LOG_FILE;
+#define LOG_SOURCE_FILE "queryexecutor.cpp"
+
+#define BATCH_ROWS 4096
+#define BATCH_MS 50	// first rows are shown without waiting for full batch
+
+QueryExecutor::QueryExecutor(SQLiteDB & _main_db, const std::string & _query, bool _profile):
+	main_db(_main_db),
+	shared(_main_db.HasSessionState()),
+	query(_query),
+	profile(_profile),
+	conn(nullptr),
+	cancel(false),
+	prepared(false),
+	state(es_running)
+{
+}
+
+QueryExecutor::~QueryExecutor()
+{
+	Cancel();
+	if( worker.joinable() )
+		worker.join();
+
+	row_batch * batch;
+	while( queue.pop(batch) )
+		FreeBatch(batch);
+	for( auto item : backlog )
+		FreeBatch(item);
+}
+
+bool QueryExecutor::Start(SQLiteDB::CancelScope::aborted_fn aborted)
+{
+	//UI thread waits until query is done, as with other statements on main connection
+	if( shared ) {
+		SQLiteDB::CancelScope cancel_scope(main_db, aborted);
+		Run(&cancel_scope);
+		return true;
+	}
+
+	try {
+		worker = std::thread(&QueryExecutor::Run, this, nullptr);
+	} catch( const std::system_error & e ) {
+		LOG_ERROR("can't start worker: %s\n", e.what());
+		error = MB2Wide(e.what());
+		state.store(es_error, std::memory_order_release);
+		return false;
+	}
+	return true;
+}
+
+void QueryExecutor::Cancel(void)
+{
+	cancel = true;
+	std::lock_guard<std::mutex> lk(lock);
+	if( conn )
+		sqlite3_interrupt(conn->GetDb());
+}
+
+bool QueryExecutor::Pop(row_batch *& batch)
+{
+	if( queue.pop(batch) )
+		return true;
+	// synchronous run keeps batches which don't fit queue
+	if( !shared || backlog.empty() )
+		return false;
+	batch = backlog.front();
+	backlog.pop_front();
+	return true;
+}
+
+void QueryExecutor::FreeBatch(row_batch * batch)
+{
+	arena_destroy(batch->a);
+	delete batch;
+}
+
+bool QueryExecutor::Push(row_batch * batch, bool wait)
+{
+	// UI thread is slower than worker, wait for free slot or keep batch in backlog
+	if( batch )
+		backlog.push_back(batch);
+	while( !backlog.empty() ) {
+		if( queue.push(backlog.front()) ) {
+			backlog.pop_front();
+			continue;
+		}
+		if( cancel ) {
+			for( auto item : backlog )
+				FreeBatch(item);
+			backlog.clear();
+			return false;
+		}
+		if( !wait )
+			break;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return true;
+}
+
+void QueryExecutor::Finish(exec_state st)
+{
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		conn = nullptr;
+	}
+	state.store(cancel ? es_cancelled : st, std::memory_order_release);
+	LOG_INFO("state %u\n", State());
+}
+
+void QueryExecutor::Run(const SQLiteDB::CancelScope * cancel_scope)
+{
+	LOG_INFO("%s (%s connection)\n", query.c_str(), shared ? "main" : "own");
+
+	//Temp objects, attached databases and open transaction are visible on main connection only
+	std::unique_ptr<SQLiteDB> own;
+	if( !shared ) {
+		own = std::make_unique<SQLiteDB>(main_db.GetDbFileName().c_str(), true);
+		if( !own->Valid() ) {
+			error = own->LastError();
+			Finish(es_error);
+			return;
+		}
+	}
+	SQLiteDB & db = shared ? main_db : *own;
+
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		conn = &db;
+	}
+	if( cancel ) {
+		Finish(es_cancelled);
+		return;
+	}
+
+	std::unique_ptr<SQLiteProfiler> profiler;
+	if( profile )
+		profiler = std::make_unique<SQLiteProfiler>(db);
+
+	sqlite_statement stmt(db.GetDb());
+	exec_state st = es_error;
+	const int rc = stmt.prepare(query.c_str());
+	if( rc != SQLITE_OK )
+		error = db.LastError();
+	else {
+		const int col_count = stmt.column_count();
+		for( int i = 0; i < col_count; ++i )
+			columns.push_back(stmt.column_name(i));
+		prepared.store(true, std::memory_order_release);
+		st = Fetch(db, stmt);
+	}
+
+	if( profiler ) {
+		//Not finished (cancelled) statement is traced on reset
+		stmt.close();
+		profiler->Finish();
+		profile_report = profiler->Report();
+		profiler.reset();
+	}
+	stmt.close();
+	//Incomplete rows are shown if user stopped synchronous query
+	if( cancel_scope && cancel_scope->Cancelled() )
+		cancel = true;
+	Finish(st);
+}
+
+QueryExecutor::exec_state QueryExecutor::Fetch(SQLiteDB & db, sqlite_statement & stmt)
+{
+	const int col_count = stmt.column_count();
+	row_batch * batch = nullptr;
+	auto batch_start = std::chrono::steady_clock::now();
+	int rc;
+	size_t len;
+	for( ;; ) {
+		rc = stmt.step_execute();
+		if( rc != SQLITE_ROW ) {
+			if( rc != SQLITE_DONE )
+				error = db.LastError();
+			break;
+		}
+		if( !batch ) {
+			batch = new row_batch;
+			batch->a = arena_create(0);
+			batch_start = std::chrono::steady_clock::now();
+		}
+
+		const wchar_t ** cells = batch->a ? (const wchar_t **)arena_alloc(batch->a, col_count * sizeof(const wchar_t *)) : nullptr;
+		if( cells ) {
+			for( int j = 0; j < col_count; ++j )
+				cells[j] = exporter::get_text(stmt, j, batch->a, len);
+		}
+		if( !cells ) {
+			FreeBatch(batch);
+			error = L"Error: out of memory";
+			return es_error;
+		}
+		batch->rows.push_back(cells);
+
+		//Profiled statement doesn't wait for UI (statement time is measured until the last step),
+		//synchronous run has nobody to wait for
+		if( batch->rows.size() >= BATCH_ROWS ||
+			std::chrono::steady_clock::now() - batch_start >= std::chrono::milliseconds(BATCH_MS) ) {
+			if( !Push(batch, !profile && !shared) )
+				return es_cancelled;
+			batch = nullptr;
+		}
+	}
+
+	if( !Push(batch, !shared) )
+		return es_cancelled;
+
+	return rc == SQLITE_DONE ? es_done : es_error;
+}
@@ -0,0 +1,101 @@
+#ifndef __QUERYEXECUTOR_H__
+#define __QUERYEXECUTOR_H__
+
+#include "spscqueue.h"
+#include "sqlite/sqlitedb.h"
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <deque>
+
+struct arena;
+
+// Runs SELECT query in worker thread on separate read-only connection,
+// rows are converted to panel text and passed to UI thread by batches.
+// Connection with session state (temp objects, attached databases, open
+// transaction) is used by UI thread too (cancel handler, interrupt, DDL and
+// commit), so on it the query runs synchronously in calling thread.
+// In profiling mode batches are not limited by queue size, so that statement
+// time doesn't include waiting for UI.
+class QueryExecutor {
+public:
+	//! Converted rows, cells are allocated in batch arena.
+	struct row_batch {
+		struct arena * a;
+		std::vector<const wchar_t **> rows;
+	};
+
+	//! Query result received from executor (owns batches).
+	struct query_result {
+		std::vector<std::string> columns;
+		std::vector<row_batch *> batches;
+		size_t rows = 0;
+		SQLiteDB::db_version version;	///< Database version at query start
+		~query_result() { for( auto batch : batches ) FreeBatch(batch); };
+	};
+
+	//! Execution state.
+	enum exec_state {
+		es_running,
+		es_done,
+		es_error,
+		es_cancelled
+	};
+
+	/**
+	 * Start query (on main connection it is executed before return).
+	 * \param aborted abort callback of synchronous execution
+	 * \return false if worker can't be started
+	 */
+	bool Start(SQLiteDB::CancelScope::aborted_fn aborted);
+	void Cancel(void);
+
+	// statement is prepared, columns are available
+	bool Prepared(void) const { return prepared.load(std::memory_order_acquire); };
+	const std::vector<std::string> & Columns(void) const { return columns; };
+
+	exec_state State(void) const { return state.load(std::memory_order_acquire); };
+	// error description (es_error state)
+	const std::wstring & Error(void) const { return error; };
+
+	// statements profile report (profiling mode, after final state)
+	const std::string & Profile(void) const { return profile_report; };
+
+	// get next batch (caller frees it by FreeBatch)
+	bool Pop(row_batch *& batch);
+	static void FreeBatch(row_batch * batch);
+
+	QueryExecutor(SQLiteDB & main_db, const std::string & query, bool profile = false);
+	~QueryExecutor();
+
+private:
+	SQLiteDB & main_db;
+	bool shared;	///< Query runs on main connection in calling thread
+	std::string query;
+	bool profile;
+
+	std::thread worker;
+	std::mutex lock;
+	SQLiteDB * conn;	///< Worker connection (for interrupt)
+	std::atomic<bool> cancel;
+
+	std::atomic<bool> prepared;
+	std::vector<std::string> columns;
+	std::atomic<exec_state> state;
+	std::wstring error;
+	std::string profile_report;
+
+	spsc_queue<row_batch *, 64> queue;
+	std::deque<row_batch *> backlog;	///< Batches waiting for free queue slot (worker or synchronous run)
+
+	void Run(const SQLiteDB::CancelScope * cancel_scope);
+	exec_state Fetch(SQLiteDB & db, sqlite_statement & stmt);
+	bool Push(row_batch * batch, bool wait);
+	void Finish(exec_state st);
+
+	// copy and assignment not allowed
+	QueryExecutor(const QueryExecutor&) = delete;
+	void operator=(const QueryExecutor&) = delete;
+};
+
+#endif /* __QUERYEXECUTOR_H__ */
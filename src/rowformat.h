@@ -0,0 +1,509 @@
+#ifndef __ROWFORMAT_H__
+#define __ROWFORMAT_H__
+
+#include "sqlite/sqlitedb.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <charconv>
+
+#include <common/encode.h>
+
+// Row formatters of csv, jsonl and sql export. They depend on SQLite only
+// (exporter and benchmarks share them).
+
+#define MAX_BLOB_LENGTH 100
+#define SQL_BATCH_ROWS 1000
+#define SQL_BATCH_SIZE (256 * 1024)
+#define BLOB_CHUNK_SIZE (192 * 1024)	// multiple of 3 for base64
+
+//Formats of row formatters
+enum row_format {
+	rf_csv,
+	rf_jsonl,
+	rf_sql
+};
+
+//Append escaped string (without quotes), escaped characters are rare so they are looked up by blocks
+inline void append_json_string(std::string& out, const char* str, const size_t len)
+{
+	size_t pos = 0;
+	while (pos < len) {
+		const size_t n = JsonEscapeScan(str + pos, len - pos);
+		out.append(str + pos, n);
+		pos += n;
+		if (pos < len) {
+			char esc[6];
+			out.append(esc, JsonEscapeChar(static_cast<unsigned char>(str[pos]), esc));
+			++pos;
+		}
+	}
+}
+
+//Append shortest text of double which reads back to the same value (JSON has no infinity)
+inline void append_json_number(std::string& out, const double val)
+{
+	if (!std::isfinite(val)) {
+		out += "null";
+		return;
+	}
+	char num[32];
+	int len = snprintf(num, sizeof(num), "%.15g", val);
+	if (strtod(num, nullptr) != val)
+		len = snprintf(num, sizeof(num), "%.17g", val);
+	//Decimal separator depends on locale
+	for (int i = 0; i < len; ++i) {
+		if (num[i] == ',')
+			num[i] = '.';
+	}
+	out.append(num, len);
+}
+
+//Append integer without text conversion in SQLite (it allocates text copy of value)
+inline void append_int64(std::string& out, const sqlite3_int64 val)
+{
+	char num[24];
+	out.append(num, std::to_chars(num, num + sizeof(num), val).ptr - num);
+}
+
+//Append CSV field: value with separator or quotes is quoted, control characters are replaced by spaces
+inline void append_csv_text(std::string& out, const char* txt, const size_t len)
+{
+	//Most values have nothing to quote, they are checked by one scan
+	const size_t plain = CsvQuoteScan(txt, len, ';');
+	if (plain == len) {
+		out.append(txt, len);
+		return;
+	}
+	const bool quote = memchr(txt + plain, ';', len - plain) || memchr(txt + plain, '"', len - plain);
+	if (quote)
+		out += '"';
+	out.append(txt, plain);
+	for (size_t i = plain; i < len; ++i) {
+		const unsigned char c = static_cast<unsigned char>(txt[i]);
+		if (c == '"')
+			out += "\"\"";
+		else
+			out += c < ' ' ? ' ' : static_cast<char>(c);
+	}
+	if (quote)
+		out += '"';
+}
+
+inline void format_csv_header(const SQLiteDB::sq_columns& columns, std::string& out)
+{
+	for (size_t i = 0; i < columns.size(); ++i) {
+		append_csv_text(out, columns[i].name.c_str(), columns[i].name.length());
+		if (i != columns.size() - 1)
+			out += ';';
+	}
+	out += "\n";
+}
+
+inline std::string sql_quote(const std::string& str, const char quote)
+{
+	std::string res(1, quote);
+	for (const char c : str) {
+		res += c;
+		if (c == quote)
+			res += quote;
+	}
+	res += quote;
+	return res;
+}
+
+//Append data in lowercase hex
+inline void append_hex(std::string& out, const void* data, const size_t len)
+{
+	const size_t pos = out.length();
+	out.resize(pos + len * 2);
+	HexEncode(data, len, &out[pos]);
+}
+
+//Append blob description: [size]:0x<hex>, data is cut to max_len bytes
+inline void append_blob_text(std::string& out, const void* data, const size_t len, const size_t max_len)
+{
+	out += '[';
+	append_int64(out, static_cast<sqlite3_int64>(len));
+	out += "]:0x";
+	append_hex(out, data, std::min(len, max_len));
+	if (len > max_len)
+		out += "...";
+}
+
+//Whole blobs of table read by chunks (incremental blob I/O) instead of loading them to memory,
+//statement is made by select_query with blob streaming
+class blob_stream
+{
+public:
+	blob_stream(sqlite3* db, const std::string& table, const SQLiteDB::sq_columns& columns)
+	: _db(db), _table(table), _columns(columns), _blobs(columns.size(), nullptr), _blob(nullptr), _size(0) {}
+
+	~blob_stream()
+	{
+		for (sqlite3_blob* blob : _blobs) {
+			if (blob)
+				sqlite3_blob_close(blob);
+		}
+	}
+
+	//Check if NULL value of column is blob
+	bool is_blob(const sqlite_statement& stmt, const int i) const
+	{
+		const char* flags = stmt.get_text(static_cast<int>(_columns.size()) + 1);
+		return flags && flags[i] == '1';
+	}
+
+	//Open blob of current row, return its size (-1 on error)
+	int open(const sqlite_statement& stmt, const int i)
+	{
+		const sqlite3_int64 rowid = stmt.get_int64(static_cast<int>(_columns.size()));
+		sqlite3_blob*& blob = _blobs[i];
+		//Handle is moved to other row of the same column
+		int rc = blob ? sqlite3_blob_reopen(blob, rowid) : SQLITE_ERROR;
+		if (rc != SQLITE_OK) {
+			if (blob)
+				sqlite3_blob_close(blob);
+			blob = nullptr;
+			rc = sqlite3_blob_open(_db, "main", _table.c_str(), _columns[i].name.c_str(), rowid, 0, &blob);
+		}
+		if (rc != SQLITE_OK) {
+			_error = sqlite3_errmsg(_db);
+			return -1;
+		}
+		_blob = blob;
+		_size = sqlite3_blob_bytes(blob);
+		return _size;
+	}
+
+	//Read opened blob by chunks (size is multiple of 3 except the last one), chunk handler stops reading on false
+	template <class Chunk>
+	bool read(Chunk chunk)
+	{
+		if (_buff.empty())
+			_buff.resize(BLOB_CHUNK_SIZE);
+		for (int offset = 0; offset < _size; offset += BLOB_CHUNK_SIZE) {
+			const int len = std::min(_size - offset, BLOB_CHUNK_SIZE);
+			if (sqlite3_blob_read(_blob, _buff.data(), len, offset) != SQLITE_OK) {
+				_error = sqlite3_errmsg(_db);
+				return false;
+			}
+			if (!chunk(_buff.data(), static_cast<size_t>(len)))
+				return false;
+		}
+		return true;
+	}
+
+	//Read error description in UTF-8 (empty if there was no error)
+	const std::string& error() const { return _error; }
+
+private:
+	sqlite3*			_db;
+	const std::string&	_table;
+	const SQLiteDB::sq_columns&	_columns;
+	std::vector<sqlite3_blob*>	_blobs;	///< Open handles by column
+	sqlite3_blob*		_blob;	///< Current blob
+	int					_size;	///< Current blob size
+	std::vector<char>	_buff;
+	std::string			_error;
+};
+
+//Formatting settings of export (shared by workers)
+struct format_options {
+	row_format fmt = rf_csv;
+	size_t columns = 0;
+	std::vector<std::string> keys;	///< JSON keys of columns
+	std::string insert;			///< INSERT statement prefix
+	bool whole_blobs = false;	///< Write whole blobs in csv
+	bool stream_blobs = false;	///< Blobs are read by blob_stream
+};
+
+//Row formatters: the format is chosen once per export, rows loop (format_rows) is instantiated for each of them,
+//cells are formatted by their storage class; flush writes output if it is big enough (on streaming blobs)
+
+class csv_formatter
+{
+public:
+	csv_formatter(const format_options& opts, blob_stream* blobs)
+	: _columns(static_cast<int>(opts.columns)), _max_blob(opts.whole_blobs ? SIZE_MAX : MAX_BLOB_LENGTH), _blobs(blobs) {}
+
+	template <class Flush>
+	bool row(const sqlite_statement& stmt, std::string& out, Flush& flush)
+	{
+		for (int i = 0; i < _columns; ++i) {
+			if (i)
+				out += ';';
+			switch (stmt.column_type(i)) {
+				case SQLITE_INTEGER:
+					append_int64(out, stmt.get_int64(i));
+					break;
+				case SQLITE_FLOAT: {
+					//Numbers have nothing to quote
+					const char* txt = stmt.get_text(i);
+					out.append(txt, stmt.get_length(i));
+					break;
+				}
+				case SQLITE_TEXT: {
+					const char* txt = stmt.get_text(i);
+					append_csv_text(out, txt, stmt.get_length(i));
+					break;
+				}
+				case SQLITE_BLOB: {
+					const void* data = stmt.get_blob(i);
+					append_blob_text(out, data, stmt.get_length(i), _max_blob);
+					break;
+				}
+				default:
+					if (_blobs && _blobs->is_blob(stmt, i)) {
+						const int size = _blobs->open(stmt, i);
+						if (size < 0)
+							return false;
+						out += '[';
+						append_int64(out, size);
+						out += "]:0x";
+						if (!_blobs->read([&](const void* data, const size_t len) { append_hex(out, data, len); return flush(out); }))
+							return false;
+					}
+					break;
+			}
+		}
+		out += '\n';
+		return true;
+	}
+
+	void finish(std::string&) {}
+
+private:
+	const int		_columns;
+	const size_t	_max_blob;	///< Maximum size of blob data
+	blob_stream*	_blobs;
+};
+
+//JSON object keys: {"name": for the first column, ,"name": for others
+inline std::vector<std::string> jsonl_keys(const SQLiteDB::sq_columns& columns)
+{
+	std::vector<std::string> keys(columns.size());
+	for (size_t i = 0; i < columns.size(); ++i) {
+		keys[i] = i ? ",\"" : "{\"";
+		append_json_string(keys[i], columns[i].name.c_str(), columns[i].name.length());
+		keys[i] += "\":";
+	}
+	return keys;
+}
+
+class jsonl_formatter
+{
+public:
+	jsonl_formatter(const format_options& opts, blob_stream* blobs) : _keys(opts.keys), _blobs(blobs) {}
+
+	template <class Flush>
+	bool row(const sqlite_statement& stmt, std::string& out, Flush& flush)
+	{
+		for (int i = 0; i < static_cast<int>(_keys.size()); ++i) {
+			out += _keys[i];
+			switch (stmt.column_type(i)) {
+				case SQLITE_INTEGER:
+					append_int64(out, stmt.get_int64(i));
+					break;
+				case SQLITE_FLOAT:
+					append_json_number(out, stmt.get_double(i));
+					break;
+				case SQLITE_TEXT:
+					out += '"';
+					append_json_string(out, stmt.get_text(i), stmt.get_length(i));
+					out += '"';
+					break;
+				case SQLITE_BLOB: {
+					const size_t len = stmt.get_length(i);
+					const size_t pos = out.length();
+					out.resize(pos + BASE64_ENCODED_SIZE(len) + 2);
+					out[pos] = '"';
+					const size_t enc_len = Base64Encode(stmt.get_blob(i), len, &out[pos + 1]);
+					out[pos + 1 + enc_len] = '"';
+					break;
+				}
+				default:
+					if (_blobs && _blobs->is_blob(stmt, i)) {
+						if (_blobs->open(stmt, i) < 0)
+							return false;
+						out += '"';
+						auto chunk = [&](const void* data, const size_t len) {
+							const size_t pos = out.length();
+							out.resize(pos + BASE64_ENCODED_SIZE(len));
+							Base64Encode(data, len, &out[pos]);
+							return flush(out);
+						};
+						if (!_blobs->read(chunk))
+							return false;
+						out += '"';
+					}
+					else
+						out += "null";
+					break;
+			}
+		}
+		out += _keys.empty() ? "{}\n" : "}\n";
+		return true;
+	}
+
+	void finish(std::string&) {}
+
+private:
+	const std::vector<std::string>&	_keys;	///< JSON keys of columns
+	blob_stream*	_blobs;
+};
+
+//INSERT INTO "table"("col1","col2") VALUES
+inline std::string sql_insert_prefix(const std::string& table, const SQLiteDB::sq_columns& columns)
+{
+	std::string prefix = "INSERT INTO " + sql_quote(table, '"') + '(';
+	for (size_t i = 0; i < columns.size(); ++i) {
+		if (i)
+			prefix += ',';
+		prefix += sql_quote(columns[i].name, '"');
+	}
+	prefix += ") VALUES";
+	return prefix;
+}
+
+//Append SQL literal which is read back to exactly the same value
+inline void append_sql_value(const sqlite_statement& stmt, const int i, std::string& out)
+{
+	switch (stmt.column_type(i)) {
+		case SQLITE_INTEGER:
+			append_int64(out, stmt.get_int64(i));
+			break;
+		case SQLITE_FLOAT: {
+			const double val = stmt.get_double(i);
+			if (std::isinf(val))
+				out += val > 0 ? "1e999" : "-1e999";
+			else {
+				char num[32];
+				sqlite3_snprintf(sizeof(num), num, "%!.17g", val);
+				out += num;
+			}
+			break;
+		}
+		case SQLITE_TEXT: {
+			const char* txt = stmt.get_text(i);
+			const size_t len = stmt.get_length(i);
+			out += '\'';
+			for (size_t pos = 0; pos < len; ) {
+				const char* quote = static_cast<const char*>(memchr(txt + pos, '\'', len - pos));
+				const size_t n = quote ? quote - (txt + pos) + 1 : len - pos;
+				out.append(txt + pos, n);
+				if (quote)
+					out += '\'';
+				pos += n;
+			}
+			out += '\'';
+			break;
+		}
+		case SQLITE_BLOB: {
+			const void* data = stmt.get_blob(i);
+			out += "X'";
+			append_hex(out, data, stmt.get_length(i));
+			out += '\'';
+			break;
+		}
+		default:
+			out += "NULL";
+			break;
+	}
+}
+
+//Rows are grouped to multi-row INSERT statements
+class sql_formatter
+{
+public:
+	sql_formatter(const format_options& opts, blob_stream* blobs)
+	: _prefix(opts.insert), _columns(static_cast<int>(opts.columns)), _blobs(blobs), _rows(0), _bytes(0) {}
+
+	template <class Flush>
+	bool row(const sqlite_statement& stmt, std::string& out, Flush& flush)
+	{
+		size_t start = out.length();
+		if (_rows)
+			out += ",\n(";
+		else {
+			out += _prefix;
+			out += "\n(";
+		}
+		for (int i = 0; i < _columns; ++i) {
+			if (i)
+				out += ',';
+			if (!_blobs || stmt.column_type(i) != SQLITE_NULL || !_blobs->is_blob(stmt, i)) {
+				append_sql_value(stmt, i, out);
+				continue;
+			}
+			//Output is flushed while blob is streamed, so its size is counted separately
+			_bytes += out.length() - start;
+			const int size = _blobs->open(stmt, i);
+			if (size < 0)
+				return false;
+			out += "X'";
+			if (!_blobs->read([&](const void* data, const size_t len) { append_hex(out, data, len); return flush(out); }))
+				return false;
+			out += '\'';
+			_bytes += static_cast<size_t>(size) * 2;
+			start = out.length();
+		}
+		out += ')';
+		_bytes += out.length() - start;
+		if (++_rows >= SQL_BATCH_ROWS || _bytes >= SQL_BATCH_SIZE)
+			finish(out);
+		return true;
+	}
+
+	//Close multi-row INSERT statement
+	void finish(std::string& out)
+	{
+		if (_rows)
+			out += ";\n";
+		_rows = 0;
+		_bytes = 0;
+	}
+
+private:
+	const std::string&	_prefix;	///< INSERT statement prefix
+	const int	_columns;
+	blob_stream*	_blobs;
+	size_t		_rows;		///< Rows in current statement
+	size_t		_bytes;		///< Size of current statement
+};
+
+//Rows loop, next_row is called after each row (progress) and flush writes output if it is big enough,
+//they stop the loop on false
+template <class Formatter, class NextRow, class Flush>
+bool format_rows(sqlite_statement& stmt, Formatter& formatter, std::string& out, NextRow& next_row, Flush& flush, int& state)
+{
+	while ((state = stmt.step_execute()) == SQLITE_ROW) {
+		if (!formatter.row(stmt, out, flush) || !next_row() || !flush(out))
+			return false;
+	}
+	formatter.finish(out);
+	return true;
+}
+
+//Rows loop for csv, jsonl and sql formats
+template <class NextRow, class Flush>
+bool format_rows(const format_options& opts, sqlite_statement& stmt, blob_stream* blobs, std::string& out, NextRow& next_row, Flush& flush, int& state)
+{
+	switch (opts.fmt) {
+		case rf_jsonl: {
+			jsonl_formatter formatter(opts, blobs);
+			return format_rows(stmt, formatter, out, next_row, flush, state);
+		}
+		case rf_sql: {
+			sql_formatter formatter(opts, blobs);
+			return format_rows(stmt, formatter, out, next_row, flush, state);
+		}
+		default: {
+			csv_formatter formatter(opts, blobs);
+			return format_rows(stmt, formatter, out, next_row, flush, state);
+		}
+	}
+}
+
+#endif // __ROWFORMAT_H__
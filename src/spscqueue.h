@@ -0,0 +1,50 @@
+#ifndef __SPSCQUEUE_H__
+#define __SPSCQUEUE_H__
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Lock-free bounded queue for one producer and one consumer thread.
+ * \param T item type (trivially copyable, usually pointer)
+ * \param N capacity (power of two)
+ */
+template <typename T, size_t N>
+class spsc_queue
+{
+	static_assert(N && (N & (N - 1)) == 0, "capacity must be power of two");
+
+public:
+	spsc_queue() : _head(0), _tail(0) {}
+
+	//Producer: add item, false if queue is full
+	bool push(const T& item)
+	{
+		const size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail - _head.load(std::memory_order_acquire) == N)
+			return false;
+		_items[tail & (N - 1)] = item;
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	//Consumer: get item, false if queue is empty
+	bool pop(T& item)
+	{
+		const size_t head = _head.load(std::memory_order_relaxed);
+		if (head == _tail.load(std::memory_order_acquire))
+			return false;
+		item = _items[head & (N - 1)];
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+
+private:
+	T _items[N];
+	alignas(64) std::atomic<size_t> _head;	///< Next item to pop (consumer)
+	alignas(64) std::atomic<size_t> _tail;	///< Next item to push (producer)
+};
+
+#endif /* __SPSCQUEUE_H__ */
@@ -0,0 +1,66 @@
+#include "advisor.h"
+#include <utils.h>
+#include <cstring>
+
+#include <common/log.h>
+
+extern "C" {
+#include <engine/sqlite3expert.h>
+}
+
+extern const char * LOG_FILE;
+#define LOG_SOURCE_FILE "advisor.cpp"
+
+namespace {
+
+// Report line by line (lines are terminated with '\n')
+void split_lines(const char * report, std::vector<std::string> & lines)
+{
+	while( report && *report ) {
+		const char * end = strchr(report, '\n');
+		if( !end )
+			end = report + strlen(report);
+		if( end != report )
+			lines.emplace_back(report, end);
+		report = *end ? end + 1 : end;
+	}
+}
+
+} // namespace
+
+SQLiteAdvisor::SQLiteAdvisor(SQLiteDB & _db):
+	db(_db)
+{
+}
+
+bool SQLiteAdvisor::Analyze(const char * query)
+{
+	advices.clear();
+	error.clear();
+
+	char * err = nullptr;
+	sqlite3expert * expert = sqlite3_expert_new(db.GetDb(), &err);
+	//Schema only: statistics of candidate indexes are not sampled from data
+	if( expert && sqlite3_expert_config(expert, EXPERT_CONFIG_SAMPLE, 0) == SQLITE_OK
+		&& sqlite3_expert_sql(expert, query, &err) == SQLITE_OK
+		&& sqlite3_expert_analyze(expert, &err) == SQLITE_OK ) {
+		const int count = sqlite3_expert_count(expert);
+		for( int i = 0; i < count; ++i ) {
+			advice item;
+			item.sql = sqlite3_expert_report(expert, i, EXPERT_REPORT_SQL);
+			split_lines(sqlite3_expert_report(expert, i, EXPERT_REPORT_INDEXES), item.indexes);
+			const char * plan = sqlite3_expert_report(expert, i, EXPERT_REPORT_PLAN);
+			item.plan_after = plan ? plan : "";
+			db.GetQueryPlan(item.sql.c_str(), item.plan_before);
+			LOG_INFO("%s: %zu indexes\n", item.sql.c_str(), item.indexes.size());
+			advices.push_back(std::move(item));
+		}
+	}
+	else {
+		error = MB2Wide(err ? err : sqlite3_errstr(SQLITE_NOMEM));
+		LOG_ERROR("expert: %s ... %S\n", query, error.c_str());
+	}
+	sqlite3_free(err);
+	sqlite3_expert_destroy(expert);
+	return error.empty();
+}
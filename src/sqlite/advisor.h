@@ -0,0 +1,37 @@
+#ifndef __ADVISOR_H__
+#define __ADVISOR_H__
+
+#include "sqlitedb.h"
+
+// Index advisor: query is analyzed by sqlite3expert on in-memory copy of the
+// schema (without data), candidate indexes are checked by the planner there.
+class SQLiteAdvisor {
+public:
+	//! Advice for one statement of the query.
+	struct advice {
+		std::string sql;			///< Analyzed statement
+		std::vector<std::string> indexes;	///< Candidate CREATE INDEX statements
+		std::string plan_before;		///< Plan on database
+		std::string plan_after;			///< Plan with candidate indexes
+	};
+
+	// analyze query (one or more statements), false on error
+	bool Analyze(const char * query);
+
+	const std::vector<advice> & Advices(void) const { return advices; };
+	// error description (Analyze failed)
+	const std::wstring & Error(void) const { return error; };
+
+	explicit SQLiteAdvisor(SQLiteDB & db);
+
+private:
+	SQLiteDB & db;
+	std::vector<advice> advices;
+	std::wstring error;
+
+	// copy and assignment not allowed
+	SQLiteAdvisor(const SQLiteAdvisor&) = delete;
+	void operator=(const SQLiteAdvisor&) = delete;
+};
+
+#endif /* __ADVISOR_H__ */
@@ -0,0 +1,174 @@
+#include "profiler.h"
+#include <utils.h>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include <common/log.h>
+
+extern const char * LOG_FILE;
+#define LOG_SOURCE_FILE "profiler.cpp"
+
+#define PROFILE_MAX_STATEMENTS 10000	// statements recorded, the rest is counted in totals only
+#define PROFILE_PLAN_STATEMENTS 20	// slowest statements with query plans in report
+
+namespace {
+
+// Transaction service statements of the plugin (not user statements)
+bool service_statement(const char * sql)
+{
+	static const char * const service[] = {
+		"BEGIN", "COMMIT", "ROLLBACK",
+		"SAVEPOINT script_stmt", "RELEASE script_stmt", "ROLLBACK TO script_stmt"
+	};
+	for( auto item : service ) {
+		if( strcmp(sql, item) == 0 )
+			return true;
+	}
+	return false;
+}
+
+} // namespace
+
+SQLiteProfiler::SQLiteProfiler(SQLiteDB & _db):
+	db(_db),
+	thread(std::this_thread::get_id()),
+	tracing(false),
+	last_stmt(nullptr),
+	last_run(nullptr),
+	skipped(0),
+	skipped_ns(0)
+{
+	if( sqlite3_trace_v2(db.GetDb(), SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, &SQLiteProfiler::Trace, this) == SQLITE_OK )
+		tracing = true;
+	else
+		LOG_ERROR("sqlite3_trace_v2 ... %S\n", db.LastError().c_str());
+}
+
+SQLiteProfiler::~SQLiteProfiler()
+{
+	if( tracing )
+		sqlite3_trace_v2(db.GetDb(), 0, nullptr, nullptr);
+}
+
+int SQLiteProfiler::Trace(unsigned type, void * param, void * p, void * x)
+{
+	SQLiteProfiler * profiler = static_cast<SQLiteProfiler *>(param);
+	sqlite3_stmt * stmt = static_cast<sqlite3_stmt *>(p);
+	if( std::this_thread::get_id() != profiler->thread )
+		return 0;
+
+	if( type == SQLITE_TRACE_STMT ) {
+		//Trigger programs are reported with "-- " comment
+		const char * text = static_cast<const char *>(x);
+		if( text && text[0] == '-' && text[1] == '-' )
+			return 0;
+		stmt_run & run = profiler->running[stmt];
+		run.start = std::chrono::steady_clock::now();
+		run.rows = 0;
+		return 0;
+	}
+	if( type == SQLITE_TRACE_ROW ) {
+		//Usually rows of one statement go in a row
+		if( stmt != profiler->last_stmt ) {
+			profiler->last_stmt = stmt;
+			profiler->last_run = &profiler->running[stmt];
+		}
+		++profiler->last_run->rows;
+		return 0;
+	}
+	if( type != SQLITE_TRACE_PROFILE )
+		return 0;
+
+	//Statement is finished (reset or done), counters are reset for the next run.
+	//Profile time of sqlite has milliseconds resolution (VFS time), own clock is used if start is known
+	stmt_profile item;
+	item.time_ns = static_cast<uint64_t>(*static_cast<sqlite3_int64 *>(x));
+	item.rows = 0;
+	auto it = profiler->running.find(stmt);
+	if( it != profiler->running.end() ) {
+		if( it->second.start != std::chrono::steady_clock::time_point() )
+			item.time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - it->second.start).count();
+		item.rows = it->second.rows;
+		profiler->running.erase(it);
+		if( stmt == profiler->last_stmt )
+			profiler->last_stmt = nullptr;
+	}
+	item.vm_steps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+	item.fullscan_steps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_FULLSCAN_STEP, 1);
+	item.sorts = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_SORT, 1);
+	item.autoindexes = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_AUTOINDEX, 1);
+
+	const char * sql = sqlite3_sql(stmt);
+	if( !sql || service_statement(sql) )
+		return 0;
+	if( profiler->statements.size() >= PROFILE_MAX_STATEMENTS ) {
+		++profiler->skipped;
+		profiler->skipped_ns += item.time_ns;
+		return 0;
+	}
+	//Statement of script is prepared with white spaces before it
+	while( isspace(static_cast<unsigned char>(*sql)) )
+		++sql;
+	item.sql = sql;
+	while( !item.sql.empty() && isspace(static_cast<unsigned char>(item.sql.back())) )
+		item.sql.pop_back();
+	profiler->statements.push_back(std::move(item));
+	return 0;
+}
+
+void SQLiteProfiler::Finish(void)
+{
+	if( tracing ) {
+		sqlite3_trace_v2(db.GetDb(), 0, nullptr, nullptr);
+		tracing = false;
+	}
+	running.clear();
+	last_stmt = nullptr;
+
+	LOG_INFO("%zu statements\n", statements.size());
+	std::stable_sort(statements.begin(), statements.end(), [](const stmt_profile & a, const stmt_profile & b) { return a.time_ns > b.time_ns; });
+	//No plan for DDL of dropped or already created object
+	for( size_t i = 0; i < statements.size() && i < PROFILE_PLAN_STATEMENTS; ++i )
+		db.GetQueryPlan(statements[i].sql.c_str(), statements[i].plan);
+}
+
+std::string SQLiteProfiler::Report(void) const
+{
+	uint64_t time_ns = skipped_ns, total_rows = 0;
+	uint64_t fullscan = 0, sorts = 0, autoindexes = 0;
+	for( const auto & item : statements ) {
+		time_ns += item.time_ns;
+		total_rows += item.rows;
+		fullscan += item.fullscan_steps != 0;
+		sorts += item.sorts != 0;
+		autoindexes += item.autoindexes != 0;
+	}
+
+	std::string report;
+	char line[256];
+	snprintf(line, sizeof(line), "Statements: %llu, time: %.3f ms, rows: %llu\n",
+		static_cast<unsigned long long>(statements.size() + skipped), time_ns / 1e6, static_cast<unsigned long long>(total_rows));
+	report += line;
+	snprintf(line, sizeof(line), "With full scan: %llu, sort: %llu, automatic index: %llu\n",
+		static_cast<unsigned long long>(fullscan), static_cast<unsigned long long>(sorts), static_cast<unsigned long long>(autoindexes));
+	report += line;
+	if( skipped ) {
+		snprintf(line, sizeof(line), "Not recorded: %llu statements (%.3f ms)\n", static_cast<unsigned long long>(skipped), skipped_ns / 1e6);
+		report += line;
+	}
+
+	for( size_t i = 0; i < statements.size() && i < PROFILE_PLAN_STATEMENTS; ++i ) {
+		const auto & item = statements[i];
+		snprintf(line, sizeof(line), "\n%.3f ms, rows: %llu, VM steps: %d, full scan steps: %d, sorts: %d, automatic index rows: %d\n",
+			item.time_ns / 1e6, static_cast<unsigned long long>(item.rows), item.vm_steps, item.fullscan_steps, item.sorts, item.autoindexes);
+		report += line;
+		report += item.sql;
+		report += '\n';
+		if( !item.plan.empty() ) {
+			report += "QUERY PLAN\n";
+			report += item.plan;
+		}
+	}
+	return report;
+}
@@ -0,0 +1,59 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include "sqlitedb.h"
+#include <chrono>
+#include <thread>
+
+// Statements profiler: statements executed on the connection while profiler
+// is alive are traced (sqlite3_trace_v2) with their run time and counters.
+// Only statements of the thread which created profiler are recorded (connection may be shared).
+class SQLiteProfiler {
+public:
+	//! Statement profile.
+	struct stmt_profile {
+		std::string sql;
+		uint64_t time_ns;	///< Run time (from SQLITE_TRACE_STMT to SQLITE_TRACE_PROFILE)
+		uint64_t rows;		///< Rows returned
+		int vm_steps;		///< Virtual machine operations
+		int fullscan_steps;	///< Forward steps in full table scans
+		int sorts;		///< Sort operations (temp b-tree)
+		int autoindexes;	///< Rows inserted into automatic indexes
+		std::string plan;	///< EXPLAIN QUERY PLAN tree
+	};
+
+	// stop tracing and read query plans of the slowest statements
+	void Finish(void);
+
+	const std::vector<stmt_profile> & Statements(void) const { return statements; };
+
+	// text report: totals and the slowest statements with plans
+	std::string Report(void) const;
+
+	explicit SQLiteProfiler(SQLiteDB & db);
+	~SQLiteProfiler();
+
+private:
+	static int Trace(unsigned type, void * param, void * p, void * x);
+
+	SQLiteDB & db;
+	std::thread::id thread;	///< Profiled thread
+	bool tracing;
+	std::vector<stmt_profile> statements;
+	//! Running statement.
+	struct stmt_run {
+		std::chrono::steady_clock::time_point start;
+		uint64_t rows;
+	};
+	std::map<sqlite3_stmt *, stmt_run> running;
+	sqlite3_stmt * last_stmt;	///< Statement of the last row
+	stmt_run * last_run;
+	uint64_t skipped;	///< Statements not recorded (limit)
+	uint64_t skipped_ns;
+
+	// copy and assignment not allowed
+	SQLiteProfiler(const SQLiteProfiler&) = delete;
+	void operator=(const SQLiteProfiler&) = delete;
+};
+
+#endif /* __PROFILER_H__ */
@@ -0,0 +1,135 @@
+#include "rowcounter.h"
+#include <utils.h>
+#include <cstring>
+#include <cassert>
+
+#include <common/log.h>
+
+extern const char * LOG_FILE;
+#define LOG_SOURCE_FILE "rowcounter.cpp"
+
+SQLiteRowCounter::SQLiteRowCounter(SQLiteDB & _main_db):
+	main_db(_main_db),
+	db_filename(_main_db.GetDbFileName()),
+	stop(false),
+	open_failed(false),
+	generation(0),
+	counting(nullptr),
+	updated(false)
+{
+	memset(&version, 0, sizeof(version));
+	main_db.SetBusyCallback(MainBusy, this);
+}
+
+SQLiteRowCounter::~SQLiteRowCounter()
+{
+	main_db.SetBusyCallback(nullptr, nullptr);
+	{
+		std::lock_guard<std::mutex> lk(lock);
+		stop = true;
+		if( counting )
+			sqlite3_interrupt(counting->GetDb());
+	}
+	cv.notify_all();
+	if( worker.joinable() )
+		worker.join();
+}
+
+void SQLiteRowCounter::SetVersion(const SQLiteDB::db_version & v)
+{
+	std::lock_guard<std::mutex> lk(lock);
+	if( v == version )
+		return;
+
+	LOG_INFO("version changed, drop %zu counts\n", counts.size());
+	version = v;
+	generation++;
+	counts.clear();
+	requested.clear();
+	failed.clear();
+	queue.clear();
+	if( counting )
+		sqlite3_interrupt(counting->GetDb());
+}
+
+void SQLiteRowCounter::MainBusy(void * param)
+{
+	// called from main thread while it waits for lock, worker queues object again
+	SQLiteRowCounter * self = static_cast<SQLiteRowCounter *>(param);
+	std::lock_guard<std::mutex> lk(self->lock);
+	if( self->counting )
+		sqlite3_interrupt(self->counting->GetDb());
+}
+
+SQLiteDB::count_state SQLiteRowCounter::Get(const std::string & name, uint64_t & count, bool queue_count)
+{
+	std::lock_guard<std::mutex> lk(lock);
+
+	auto it = counts.find(name);
+	if( it != counts.end() ) {
+		count = it->second;
+		return SQLiteDB::cs_exact;
+	}
+	if( open_failed || failed.count(name) )
+		return SQLiteDB::cs_failed;
+
+	if( queue_count && requested.insert(name).second ) {
+		queue.push_back(name);
+		if( !worker.joinable() )
+			worker = std::thread(&SQLiteRowCounter::Run, this);
+		cv.notify_one();
+	}
+	return SQLiteDB::cs_pending;
+}
+
+void SQLiteRowCounter::Run(void)
+{
+	LOG_INFO("start %S\n", db_filename.c_str());
+
+	SQLiteDB db(db_filename.c_str(), true);
+	if( !db.Valid() ) {
+		LOG_ERROR("can't open %S for counting\n", db_filename.c_str());
+		std::lock_guard<std::mutex> lk(lock);
+		open_failed = true;
+		queue.clear();
+		updated = true;
+		return;
+	}
+
+	std::unique_lock<std::mutex> lk(lock);
+	for( ;; ) {
+		cv.wait(lk, [this] { return stop || !queue.empty(); });
+		if( stop )
+			break;
+
+		const std::string name = queue.front();
+		const uint64_t gen = generation;
+		queue.pop_front();
+		counting = &db;
+		lk.unlock();
+
+		uint64_t count = 0;
+		const bool res = db.GetRowCount(name.c_str(), count);
+		const int rc = res ? SQLITE_OK : sqlite3_errcode(db.GetDb()) & 0xff;
+
+		lk.lock();
+		counting = nullptr;
+		// result of previous database version is dropped, failed objects are not counted again
+		// (until database change) except interrupted by main connection write or locked by other connection
+		if( gen != generation || stop )
+			continue;
+		if( res ) {
+			counts[name] = count;
+			updated = true;
+		} else if( rc == SQLITE_INTERRUPT || rc == SQLITE_BUSY ) {
+			LOG_INFO("count %s again (%d)\n", name.c_str(), rc);
+			queue.push_back(name);
+		} else {
+			LOG_ERROR("can't count %s (%d)\n", name.c_str(), rc);
+			failed.insert(name);
+			updated = true;
+		}
+	}
+
+	LOG_INFO("stop %S\n", db_filename.c_str());
+}
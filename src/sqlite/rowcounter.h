@@ -0,0 +1,61 @@
+#ifndef __ROWCOUNTER_H__
+#define __ROWCOUNTER_H__
+
+#include "sqlitedb.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <set>
+
+// Exact row counts (count(*)) calculated in background thread
+// on separate read-only connection. Count holds shared lock for the whole
+// scan, so it is interrupted and queued again when main connection waits
+// for lock to write.
+class SQLiteRowCounter {
+private:
+	SQLiteDB & main_db;
+	std::wstring db_filename;
+
+	std::thread worker;
+	std::mutex lock;
+	std::condition_variable cv;
+	bool stop;
+
+	std::deque<std::string> queue;		///< Objects to count
+	std::set<std::string> requested;	///< Queued, in progress or failed objects
+	std::map<std::string, uint64_t> counts;	///< Counted objects
+	std::set<std::string> failed;		///< Objects failed to count (until database change)
+	bool open_failed;			///< Worker connection can't be opened
+
+	SQLiteDB::db_version version;		///< Database version of counts
+	uint64_t generation;			///< Incremented on version change
+	SQLiteDB * counting;			///< Worker connection while count is in progress
+
+	std::atomic<bool> updated;
+
+	void Run(void);
+	static void MainBusy(void * param);
+
+	// copy and assignment not allowed
+	SQLiteRowCounter(const SQLiteRowCounter&) = delete;
+	void operator=(const SQLiteRowCounter&) = delete;
+
+public:
+	// drop all counts if database was changed
+	void SetVersion(const SQLiteDB::db_version & v);
+
+	// get count (cs_exact), queue object for counting if it is not counted (cs_pending),
+	// cs_failed if count failed with error
+	SQLiteDB::count_state Get(const std::string & name, uint64_t & count, bool queue_count = true);
+
+	// true once after new counts (or failures) are ready
+	bool Updated(void) { return updated.exchange(false); };
+
+	explicit SQLiteRowCounter(SQLiteDB & main_db);
+	~SQLiteRowCounter();
+};
+
+#endif /* __ROWCOUNTER_H__ */
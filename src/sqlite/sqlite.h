@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <list>
 #include <memory>
 #include <cassert>
 #include <stdint.h>
@@ -19,17 +20,69 @@ extern "C" {
 }
 #endif
 
+/**
+ * Cache of prepared statements (LRU, keyed by SQL text).
+ * Statements are re-prepared by sqlite itself after schema change.
+ */
+class sqlite_stmt_cache
+{
+public:
+	sqlite_stmt_cache(const size_t capacity = 32) : _capacity(capacity) {}
+	~sqlite_stmt_cache()												{ close(); }
+
+	//Get statement (reset, without bindings) from cache or prepare new one
+	int acquire(sqlite3* db, const char* query, sqlite3_stmt** stmt)
+	{
+		for (auto it = _idle.begin(); it != _idle.end(); ++it) {
+			if (it->first == query) {
+				*stmt = it->second;
+				_idle.erase(it);
+				return SQLITE_OK;
+			}
+		}
+		return sqlite3_prepare_v3(db, query, -1, SQLITE_PREPARE_PERSISTENT, stmt, NULL);
+	}
+
+	//Return statement to cache
+	void release(sqlite3_stmt* stmt)
+	{
+		sqlite3_reset(stmt);
+		sqlite3_clear_bindings(stmt);
+		_idle.emplace_front(sqlite3_sql(stmt), stmt);
+		if (_idle.size() > _capacity) {
+			sqlite3_finalize(_idle.back().second);
+			_idle.pop_back();
+		}
+	}
+
+	//Finalize idle statements
+	void flush()
+	{
+		for (auto & item : _idle)
+			sqlite3_finalize(item.second);
+		_idle.clear();
+	}
+
+	//Finalize all statements (before database close)
+	void close()													{ flush(); }
+
+private:
+	size_t			_capacity;		///< Maximum number of idle statements
+	std::list<std::pair<std::string, sqlite3_stmt*>> _idle;	///< Idle statements, most recently used first
+};
+
 /**
  * SQLite statement wrapper.
  */
 class sqlite_statement
 {
 public:
-	sqlite_statement(sqlite3* db) : _stmt(NULL), _db(db)				{ assert(_db); }
+	sqlite_statement(sqlite3* db) : _stmt(NULL), _db(db), _cache(NULL)	{ assert(_db); }
+	sqlite_statement(sqlite3* db, sqlite_stmt_cache* cache) : _stmt(NULL), _db(db), _cache(cache) { assert(_db); }
 	~sqlite_statement()													{ close(); }
 
-	//Prepare query
-	inline int prepare(const char* query)							{ close(); return sqlite3_prepare_v2(_db, query, -1, &_stmt, NULL); }
+	//Prepare query (or get it from cache)
+	inline int prepare(const char* query)							{ close(); return _cache ? _cache->acquire(_db, query, &_stmt) : sqlite3_prepare_v2(_db, query, -1, &_stmt, NULL); }
 
 	//Bind query parameter
 	inline int bind(const int index, const void* val, const int size)	{ return sqlite3_bind_blob(_stmt, index, val, size, SQLITE_TRANSIENT); }
@@ -38,9 +91,13 @@ public:
 	inline int bind(const int index, const sqlite3_int64 val)			{ return sqlite3_bind_int64(_stmt, index, val); }
 	inline int bind(const int index, const char* val)					{ return sqlite3_bind_text(_stmt, index, val, static_cast<int>(strlen(val)), SQLITE_TRANSIENT); }
 	inline int bind_null(const int index)								{ return sqlite3_bind_null(_stmt, index); }
+	//Bind text without copy, value must be valid until step_execute
+	inline int bind_static(const int index, const char* val, const int size)	{ return sqlite3_bind_text(_stmt, index, val, size, SQLITE_STATIC); }
 
 	//Execute query step
 	inline int step_execute()											{ return sqlite3_step(_stmt); }
+	//Reset executed query for next step (bindings are kept)
+	inline int reset()													{ return sqlite3_reset(_stmt); }
 
 	//Query result - get column properties
 	inline int column_count() const										{ return sqlite3_column_count(_stmt); };
@@ -52,14 +109,16 @@ public:
 	inline const void* get_blob(const int index) const					{ return sqlite3_column_blob(_stmt, index); }
 	inline int get_int(const int index) const							{ return sqlite3_column_int(_stmt, index); }
 	inline sqlite3_int64 get_int64(const int index) const				{ return sqlite3_column_int64(_stmt, index); }
+	inline double get_double(const int index) const						{ return sqlite3_column_double(_stmt, index); }
 	inline const char* get_text(const int index) const				{ return reinterpret_cast<const char *>(sqlite3_column_text(_stmt, index)); }
 
 	//Close statement
-	inline void close()													{ if (_stmt) { sqlite3_finalize(_stmt); _stmt = NULL; }	}
+	inline void close()													{ if (_stmt) { if (_cache) _cache->release(_stmt); else sqlite3_finalize(_stmt); _stmt = NULL; } }
 
 private:
 	sqlite3_stmt*	_stmt;	///< SQLite statement
 	sqlite3*		_db;	///< SQLite database
+	sqlite_stmt_cache*	_cache;	///< Statement cache (optional)
 };
 
 #endif /* __SQLITE_H__ */
@@ -12,6 +12,12 @@
 extern const char * LOG_FILE;
 #define LOG_SOURCE_FILE "sqlitedb.cpp"
 
+#define BUSY_TIMEOUT 5000 // ms
+#define BUSY_SLEEP 10 // ms, wait step of busy callback
+#define CANCEL_CHECK_OPS 1000 // VM instructions
+#define CANCEL_CHECK_MS 100
+#define ESTIMATE_PAGES 256 // dbstat pages read for row count estimate
+
 std::wstring SQLiteDB::LastError(void) const
 {
 	std::wstring rc;
@@ -42,20 +48,31 @@ bool SQLiteDB::ValidFormat(const unsigned char* file_hdr, const size_t file_hdr_
 
 }
 
-SQLiteDB::SQLiteDB(const wchar_t * _db_filename):
+SQLiteDB::SQLiteDB(const wchar_t * _db_filename, bool read_only):
 	db_filename(_db_filename),
-	db(nullptr)
+	db(nullptr),
+	cancel_scope(nullptr),
+	busy_callback(nullptr),
+	busy_param(nullptr),
+	schema_version(-1),
+	space_valid(false)
 {
 
-	if( sqlite3_open(
+	if( sqlite3_open_v2(
 			Wide2MB(_db_filename).c_str(),	/* Database filename (UTF-8) */
-			&db)          			/* OUT: SQLite db handle */ != SQLITE_OK ) {
+			&db,          			/* OUT: SQLite db handle */
+			read_only ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+			nullptr) != SQLITE_OK ) {
 		LOG_ERROR("sqlite3_open(%S) ... %S\n", _db_filename, LastError().c_str());
 		db = nullptr;
 		return;
 	}
 
+	// wait for other connections (background readers, commits) instead of SQLITE_BUSY
+	sqlite3_busy_timeout(db, BUSY_TIMEOUT);
+
 	if( !InitTokenizers() || !InitCollations() ) {
+		stmt_cache.close();
 		sqlite3_close(db);
 		db = nullptr;
 		return;
@@ -64,9 +81,75 @@ SQLiteDB::SQLiteDB(const wchar_t * _db_filename):
 	db_name = db_name = ExtractFileName(db_filename);
 }
 
+SQLiteDB::CancelScope::CancelScope(SQLiteDB & _db, aborted_fn _aborted):
+	db(_db),
+	aborted(_aborted),
+	prev(_db.cancel_scope),
+	next_check(std::chrono::steady_clock::now()),
+	cancelled(false)
+{
+	db.cancel_scope = this;
+	if( db.db )
+		sqlite3_progress_handler(db.db, CANCEL_CHECK_OPS, Handler, this);
+}
+
+SQLiteDB::CancelScope::~CancelScope()
+{
+	db.cancel_scope = prev;
+	if( db.db ) {
+		if( prev )
+			sqlite3_progress_handler(db.db, CANCEL_CHECK_OPS, Handler, prev);
+		else
+			sqlite3_progress_handler(db.db, 0, nullptr, nullptr);
+	}
+}
+
+int SQLiteDB::CancelScope::Handler(void * param)
+{
+	CancelScope * scope = static_cast<CancelScope *>(param);
+	if( scope->cancelled )
+		return 1;
+
+	const auto now = std::chrono::steady_clock::now();
+	if( now < scope->next_check )
+		return 0;
+	scope->next_check = now + std::chrono::milliseconds(CANCEL_CHECK_MS);
+
+	if( scope->aborted() ) {
+		LOG_INFO("cancelled by user\n");
+		scope->cancelled = true;
+		return 1;	// SQLITE_INTERRUPT
+	}
+	return 0;
+}
+
+void SQLiteDB::SetBusyCallback(busy_fn callback, void * param)
+{
+	busy_callback = callback;
+	busy_param = param;
+	if( !db )
+		return;
+	if( callback )
+		sqlite3_busy_handler(db, BusyHandler, this);
+	else
+		sqlite3_busy_timeout(db, BUSY_TIMEOUT);
+}
+
+int SQLiteDB::BusyHandler(void * param, int count)
+{
+	SQLiteDB * self = static_cast<SQLiteDB *>(param);
+	if( count * BUSY_SLEEP >= BUSY_TIMEOUT )
+		return 0;	// SQLITE_BUSY
+	if( self->busy_callback )
+		self->busy_callback(self->busy_param);
+	sqlite3_sleep(BUSY_SLEEP);
+	return 1;
+}
+
 SQLiteDB::~SQLiteDB(void)
 {
 	if( db != nullptr ) {
+		stmt_cache.close();
 		if( sqlite3_close(db) != SQLITE_OK ) {
 			LOG_ERROR("sqlite3_close(%S) ... %S\n", db_filename.c_str(), LastError().c_str());
 		}
@@ -105,41 +188,135 @@ const wchar_t * SQLiteDB::ObjectNameByType(SQLiteDB::obj_type type) const
 }
 
 
-bool SQLiteDB::GetObjectsList(sq_objects& objects) const
+bool SQLiteDB::RefreshSchema(void) const
 {
 	assert(db);
 
+	sqlite_statement stmt(db, &stmt_cache);
+	if( stmt.prepare("pragma schema_version") != SQLITE_OK || stmt.step_execute() != SQLITE_ROW ) {
+		LOG_ERROR("pragma schema_version ... %S\n", LastError().c_str());
+		return false;
+	}
+	const sqlite3_int64 version = stmt.get_int64(0);
+	if( version == schema_version && !schema.empty() )
+		return true;
+
+	LOG_INFO("schema version %lld -> %lld\n", (long long)schema_version, (long long)version);
+	schema.clear();
+	schema_version = -1;
+
 	//Add master table
+	sq_schema_object master_table;
+	master_table.type = ot_master;
+	master_table.columns_loaded = false;
+	schema[SQLITE_MASTER] = master_table;
+
+	//Add tables/views/indexes
+	if( stmt.prepare("select name,type,sql,tbl_name from " SQLITE_MASTER) != SQLITE_OK ) {
+		LOG_ERROR("prepare: select name,type,sql,tbl_name from " SQLITE_MASTER " ... %S\n", LastError().c_str());
+		return false;
+	}
+
+	std::vector<std::pair<std::string, std::string>> indexes;
+	while( stmt.step_execute() == SQLITE_ROW ) {
+		sq_schema_object obj;
+		const char* name = stmt.get_text(0);
+		if( !name )
+			continue;
+		obj.type = ObjectTypeByName(stmt.get_text(1));
+		obj.sql = stmt.get_text(2) ? stmt.get_text(2) : "";
+		obj.columns_loaded = false;
+		if( obj.type == ot_index && stmt.get_text(3) )
+			indexes.emplace_back(stmt.get_text(3), name);
+		schema[name] = std::move(obj);
+	}
+
+	for( auto & item : indexes ) {
+		auto it = schema.find(item.first);
+		if( it != schema.end() )
+			it->second.indexes.push_back(item.second);
+	}
+
+	schema_version = version;
+	return true;
+}
+
+bool SQLiteDB::LoadColumns(const char* object_name, sq_schema_object & obj) const
+{
+	sqlite_statement stmt(db, &stmt_cache);
+	if( stmt.prepare("select name,type,\"notnull\",pk from pragma_table_info(?)") != SQLITE_OK || stmt.bind(1, object_name) != SQLITE_OK ) {
+		LOG_ERROR("pragma table_info('%s') ... %S\n", object_name, LastError().c_str());
+		return false;
+	}
+
+	obj.columns.clear();
+	int state;
+	while( (state = stmt.step_execute()) == SQLITE_ROW ) {
+		sq_column col;
+		col.name = stmt.get_text(0);
+		col.decl_type = stmt.get_text(1) ? stmt.get_text(1) : "";
+		col.type = CoumnTypeByName(col.decl_type.c_str());
+		col.not_null = stmt.get_int(2) != 0;
+		col.pk = stmt.get_int(3);
+		obj.columns.push_back(col);
+	}
+
+	// error in view definition
+	if( state != SQLITE_DONE ) {
+		LOG_ERROR("pragma table_info('%s') ... %S\n", object_name, LastError().c_str());
+		return false;
+	}
+	obj.columns_loaded = true;
+	return true;
+}
+
+const SQLiteDB::sq_schema_object * SQLiteDB::GetSchemaObject(const char* object_name) const
+{
+	assert(object_name && object_name[0]);
+
+	if( !RefreshSchema() )
+		return nullptr;
+
+	auto it = schema.find(StrCiCmp(object_name, SQLITE_MASTER) == 0 ? SQLITE_MASTER : object_name);
+	if( it == schema.end() )
+		return nullptr;
+
+	if( !it->second.columns_loaded && (it->second.type == ot_master || it->second.type == ot_table || it->second.type == ot_view) )
+		LoadColumns(object_name, it->second);
+
+	return &it->second;
+}
+
+bool SQLiteDB::GetObjectsList(sq_objects& objects) const
+{
+	assert(db);
+
+	if( !RefreshSchema() )
+		return false;
+
+	//Master table first, then tables/views/indexes
 	sq_object master_table;
 	master_table.name = SQLITE_MASTER;
 	master_table.row_count = 0;
+	master_table.count = cs_pending;
 	master_table.type = ot_master;
 	objects.push_back(master_table);
 
-	//Add tables/views
-	sqlite_statement stmt(db);
-	if( stmt.prepare("select name,type from " SQLITE_MASTER) != SQLITE_OK )
-		return false;
-
-	while( stmt.step_execute() == SQLITE_ROW ) {
+	for( const auto & item : schema ) {
+		if( item.second.type == ot_master )
+			continue;
 		sq_object obj;
-		LOG_INFO("stmt.get_text(0) %s\n", stmt.get_text(0));
-		obj.name = stmt.get_text(0);
+		obj.name = item.first;
 		obj.row_count = 0;
-		obj.type = ObjectTypeByName(stmt.get_text(1));
-		LOG_INFO("stmt.get_text(1) %s\n", stmt.get_text(1));
+		obj.count = cs_pending;
+		obj.type = item.second.type;
 		objects.push_back(obj);
 	}
 
-	//Get tables row count
+	//Estimate tables row count, views may be expensive and stay pending
 	for( std::vector<sq_object>::iterator it = objects.begin(); it != objects.end(); ++it ) {
-		if( it->type == ot_master || it->type == ot_table || it->type == ot_view ) {
-			std::string query = "select count(*) from '";
-			query += it->name;
-			query += '\'';
-			if( stmt.prepare(query.c_str() ) == SQLITE_OK && stmt.step_execute() == SQLITE_ROW )
-				it->row_count = stmt.get_int64(0);
-		}
+		if( (it->type == ot_master || it->type == ot_table) && GetRowCountEstimate(it->name.c_str(), it->row_count) )
+			it->count = cs_estimate;
 	}
 	return true;
 }
@@ -152,22 +329,33 @@ SQLiteDB::obj_type SQLiteDB::GetDbObjectType(const char* object_name) const
 	if( StrCiCmp(object_name, SQLITE_MASTER) == 0 )
 		return ot_master;
 
-	sqlite_statement stmt(db);
-	if( stmt.prepare("select type from " SQLITE_MASTER " where name=?") != SQLITE_OK ) {
-		LOG_ERROR("prepare: select type from " SQLITE_MASTER " where name=%s ... %S\n", object_name, LastError().c_str());
+	if( !RefreshSchema() )
 		return ot_unknown;
-	}
 
-	if (stmt.bind(1, object_name) != SQLITE_OK) {
-		LOG_ERROR("bind: select type from " SQLITE_MASTER " where name=%s ... %S\n", object_name, LastError().c_str());
+	auto it = schema.find(object_name);
+	if( it == schema.end() ) {
+		LOG_ERROR("unknown object %s\n", object_name);
 		return ot_unknown;
 	}
+	return it->second.type;
+}
 
-	if( stmt.step_execute() != SQLITE_ROW ) {
-		LOG_ERROR("step_execute: select type from " SQLITE_MASTER " where name=%s ... %S\n", object_name, LastError().c_str());
-		return ot_unknown;
+bool SQLiteDB::HasColumn(const sq_columns & columns, const char * name)
+{
+	for( const auto & col : columns ) {
+		if( sqlite3_stricmp(col.name.c_str(), name) == 0 )
+			return true;
 	}
-	return ObjectTypeByName(stmt.get_text(0));
+	return false;
+}
+
+const char * SQLiteDB::RowidAlias(const sq_columns & columns)
+{
+	for( const char * alias : { "rowid", "_rowid_", "oid" } ) {
+		if( !HasColumn(columns, alias) )
+			return alias;
+	}
+	return nullptr;
 }
 
 SQLiteDB::col_type SQLiteDB::CoumnTypeByName(const char* ct) const
@@ -198,23 +386,19 @@ bool SQLiteDB::ReadColumnDescription(const char* object_name, sq_columns & colum
 	assert(db);
 	assert(object_name && object_name[0]);
 
-	std::string query = "pragma table_info('";
-	query += object_name;
-	query += "')";
-	sqlite_statement stmt(db);
-	if( stmt.prepare(query.c_str()) != SQLITE_OK ) {
-		LOG_ERROR("pragma table_info('%s') ... %S\n", object_name, LastError().c_str());
-		return false;
+	const sq_schema_object * obj = GetSchemaObject(object_name);
+	if( !obj ) {
+		//Not in main schema (temp or attached database)
+		sq_schema_object tmp;
+		if( !LoadColumns(object_name, tmp) )
+			return false;
+		columns = tmp.columns;
+		return true;
 	}
+	if( !obj->columns_loaded )
+		return false;
 
-	while( stmt.step_execute() == SQLITE_ROW ) {
-		sq_column col;
-		col.name = stmt.get_text(1);
-		LOG_INFO("stmt.get_text(1) %s\n", stmt.get_text(1));
-		col.type = CoumnTypeByName(stmt.get_text(2));
-		LOG_INFO("stmt.get_text(2) %s\n", stmt.get_text(2));
-		columns.push_back(col);
-	}
+	columns = obj->columns;
 	return true;
 }
 
@@ -226,7 +410,7 @@ bool SQLiteDB::GetRowCount(const char* object_name, uint64_t& count) const
 	std::string query = "select count(*) from '";
 	query += object_name;
 	query += '\'';
-	sqlite_statement stmt(db);
+	sqlite_statement stmt(db, &stmt_cache);
 
 	if( stmt.prepare(query.c_str()) != SQLITE_OK ) {
 		LOG_ERROR("prepare: select count(*) from '%s' ... %S\n", object_name, LastError().c_str());
@@ -241,33 +425,209 @@ bool SQLiteDB::GetRowCount(const char* object_name, uint64_t& count) const
 	return true;
 }
 
-bool SQLiteDB::GetCreationSql(const char* object_name, std::string& query) const
+bool SQLiteDB::GetRowCountEstimate(const char* object_name, uint64_t& count) const
 {
 	assert(db);
 	assert(object_name && object_name[0]);
 
-	if( StrCiCmp(object_name, SQLITE_MASTER) == 0 )
+	// collected by ANALYZE: first number of stat is the row count
+	sqlite_statement stmt(db, &stmt_cache);
+	if( stmt.prepare("select stat from sqlite_stat1 where tbl=? limit 1") == SQLITE_OK &&
+		stmt.bind(1, object_name) == SQLITE_OK &&
+		stmt.step_execute() == SQLITE_ROW ) {
+		const char * stat = stmt.get_text(0);
+		if( stat && *stat >= '0' && *stat <= '9' ) {
+			count = strtoull(stat, nullptr, 10);
+			return true;
+		}
+	}
+
+	// dbstat walks b-tree depth first, so the first pages are root, first pages of each level
+	// and first leaves: leaf pages = product of average fanouts of levels, rows = leaf pages *
+	// average cells of leaf (exact count if the whole b-tree is read)
+	if( stmt.prepare("select path, pagetype, ncell from dbstat where name=? limit ?") != SQLITE_OK ||
+		stmt.bind(1, object_name) != SQLITE_OK ||
+		stmt.bind(2, ESTIMATE_PAGES) != SQLITE_OK ) {
+		LOG_INFO("no row count estimate for '%s' ... %S\n", object_name, LastError().c_str());
 		return false;
-	sqlite_statement stmt(db);
-	if( stmt.prepare("select sql from " SQLITE_MASTER " where name=?") != SQLITE_OK ) {
-		LOG_ERROR("prepare: select sql from " SQLITE_MASTER " where name=%s ... %S\n", object_name, LastError().c_str());
+	}
+	std::vector<std::pair<uint64_t, uint64_t>> fanouts;	// internal pages by level: children, pages
+	uint64_t leaf_cells = 0, leaf_pages = 0, pages = 0;
+	int rc;
+	while( (rc = stmt.step_execute()) == SQLITE_ROW ) {
+		++pages;
+		const char * path = stmt.get_text(0);
+		const char * type = stmt.get_text(1);
+		const uint64_t cells = static_cast<uint64_t>(stmt.get_int64(2));
+		if( !path || !type )
+			continue;
+		if( strcmp(type, "leaf") == 0 ) {
+			leaf_cells += cells;
+			++leaf_pages;
+		}
+		else if( strcmp(type, "internal") == 0 ) {
+			// root is "/", each level adds "xxx/"
+			const size_t level = (strlen(path) - 1) / 4;
+			if( fanouts.size() <= level )
+				fanouts.resize(level + 1);
+			fanouts[level].first += cells + 1;
+			++fanouts[level].second;
+		}
+	}
+	if( rc != SQLITE_DONE || !leaf_pages ) {
+		LOG_INFO("no row count estimate for '%s' ... %S\n", object_name, LastError().c_str());
+		return false;
+	}
+	if( pages < ESTIMATE_PAGES ) {
+		count = leaf_cells;
+		return true;
+	}
+	double leaves = 1;
+	for( const auto & level : fanouts ) {
+		if( level.second )
+			leaves *= static_cast<double>(level.first) / level.second;
+	}
+	count = static_cast<uint64_t>(leaves * leaf_cells / leaf_pages);
+	return true;
+}
+
+bool SQLiteDB::GetVersion(db_version & version) const
+{
+	assert(db);
+
+	sqlite_statement stmt(db, &stmt_cache);
+	if( stmt.prepare("pragma data_version") != SQLITE_OK || stmt.step_execute() != SQLITE_ROW ) {
+		LOG_ERROR("pragma data_version ... %S\n", LastError().c_str());
+		return false;
+	}
+	version.data = stmt.get_int64(0);
+
+	if( stmt.prepare("pragma schema_version") != SQLITE_OK || stmt.step_execute() != SQLITE_ROW ) {
+		LOG_ERROR("pragma schema_version ... %S\n", LastError().c_str());
 		return false;
 	}
+	version.schema = stmt.get_int64(0);
+
+	version.changes = sqlite3_total_changes64(db);
+	return true;
+}
+
+bool SQLiteDB::HasSessionState(void) const
+{
+	assert(db);
+
+	if( !sqlite3_get_autocommit(db) )
+		return true;
+
+	sqlite_statement stmt(db, &stmt_cache);
+	if( stmt.prepare("pragma database_list") != SQLITE_OK ) {
+		LOG_ERROR("pragma database_list ... %S\n", LastError().c_str());
+		return true;
+	}
+	while( stmt.step_execute() == SQLITE_ROW ) {
+		const char * name = stmt.get_text(1);
+		if( name && strcmp(name, "main") != 0 && strcmp(name, "temp") != 0 )
+			return true;
+	}
 
-	if (stmt.bind(1, object_name) != SQLITE_OK) {
-		LOG_ERROR("bind: select sql from " SQLITE_MASTER " where name=%s ... %S\n", object_name, LastError().c_str());
+	if( stmt.prepare("SELECT 1 FROM temp." SQLITE_MASTER " LIMIT 1") != SQLITE_OK ) {
+		LOG_ERROR("temp schema ... %S\n", LastError().c_str());
+		return true;
+	}
+	return stmt.step_execute() == SQLITE_ROW;
+}
+
+// Pages of one b-tree are listed together, in b-tree order (leaves in key order)
+bool SQLiteDB::GetSpaceUsage(sq_spaces & objects) const
+{
+	assert(db);
+
+	db_version version;
+	const bool versioned = GetVersion(version);
+	if( versioned && space_valid && version == space_version ) {
+		objects = space;
+		return true;
+	}
+
+	sqlite_statement stmt(db);
+	if( stmt.prepare("SELECT name, pagetype, pageno, ncell, payload, unused, pgsize FROM dbstat") != SQLITE_OK ) {
+		LOG_ERROR("prepare dbstat ... %S\n", LastError().c_str());
 		return false;
 	}
 
-	if (stmt.step_execute() != SQLITE_ROW) {
-		LOG_ERROR("step_execute: select sql from " SQLITE_MASTER " where name=%s ... %S\n", object_name, LastError().c_str());
+	//! Counters for fanout and fragmentation.
+	struct btree_walk {
+		uint64_t internal_cells;
+		uint64_t gaps;
+		int64_t prev_leaf;
+	};
+	sq_spaces result;
+	std::vector<btree_walk> walks;
+	int state;
+	while( (state = stmt.step_execute()) == SQLITE_ROW ) {
+		const char * name = stmt.get_text(0);
+		const char * page_type = stmt.get_text(1);
+		if( !name || !page_type )
+			continue;
+		if( result.empty() || result.back().name != name ) {
+			sq_space obj {};
+			obj.name = name;
+			result.push_back(std::move(obj));
+			walks.push_back({0, 0, 0});
+		}
+		sq_space & obj = result.back();
+		btree_walk & walk = walks.back();
+		const int64_t page_no = stmt.get_int64(2);
+		++obj.pages;
+		obj.size += stmt.get_int64(6);
+		obj.payload += stmt.get_int64(4);
+		obj.unused += stmt.get_int64(5);
+		if( strcmp(page_type, "leaf") == 0 ) {
+			if( walk.prev_leaf && page_no != walk.prev_leaf + 1 )
+				++walk.gaps;
+			walk.prev_leaf = page_no;
+			++obj.leaf_pages;
+		}
+		else if( strcmp(page_type, "overflow") == 0 )
+			++obj.overflow_pages;
+		else
+			walk.internal_cells += stmt.get_int(3);
+	}
+	if( state != SQLITE_DONE ) {
+		LOG_ERROR("dbstat ... %S\n", LastError().c_str());
 		return false;
 	}
 
-	const char* txt = stmt.get_text(0);
-	if( !txt )
+	//Internal page has ncell children and the right child
+	for( size_t i = 0; i < result.size(); ++i ) {
+		sq_space & obj = result[i];
+		const uint64_t internal_pages = obj.pages - obj.leaf_pages - obj.overflow_pages;
+		obj.type = GetDbObjectType(obj.name.c_str());
+		obj.fanout = internal_pages ? static_cast<double>(walks[i].internal_cells + internal_pages) / internal_pages : 0;
+		obj.fragmentation = obj.leaf_pages > 1 ? walks[i].gaps * 100.0 / (obj.leaf_pages - 1) : 0;
+	}
+	LOG_INFO("%zu objects\n", result.size());
+
+	space.swap(result);
+	space_version = version;
+	space_valid = versioned;
+	objects = space;
+	return true;
+}
+
+bool SQLiteDB::GetCreationSql(const char* object_name, std::string& query) const
+{
+	assert(db);
+	assert(object_name && object_name[0]);
+
+	if( StrCiCmp(object_name, SQLITE_MASTER) == 0 )
+		return false;
+
+	const sq_schema_object * obj = GetSchemaObject(object_name);
+	if( !obj || obj->sql.empty() )
 		return false;
-	query = txt;
+
+	query = obj->sql;
 	return true;
 }
 
@@ -282,6 +642,32 @@ bool SQLiteDB::ExecuteQuery(const char* query) const
 	return state == SQLITE_DONE || state == SQLITE_OK || state == SQLITE_ROW;
 }
 
+// Plan rows are ordered, parent is one of previous rows
+bool SQLiteDB::GetQueryPlan(const char* query, std::string& plan) const
+{
+	const std::string eqp_query = std::string("EXPLAIN QUERY PLAN ") + query;
+	sqlite_statement eqp(db);
+	if( eqp.prepare(eqp_query.c_str()) != SQLITE_OK ) {
+		LOG_INFO("prepare: %s ... %S\n", eqp_query.c_str(), LastError().c_str());
+		return false;
+	}
+	std::vector<int> parents;
+	int state;
+	while( (state = eqp.step_execute()) == SQLITE_ROW ) {
+		const int id = eqp.get_int(0);
+		const int parent = eqp.get_int(1);
+		while( !parents.empty() && parents.back() != parent )
+			parents.pop_back();
+		for( size_t i = 0; i < parents.size(); ++i )
+			plan += "|  ";
+		plan += "|--";
+		plan += eqp.get_text(3);
+		plan += '\n';
+		parents.push_back(id);
+	}
+	return state == SQLITE_DONE;
+}
+
 
 //Custom tokenizer support
 static sqlite3_tokenizer	_tokinizer = { nullptr };
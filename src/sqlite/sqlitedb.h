@@ -2,6 +2,8 @@
 #define __SQLITEDB_H__
 
 #include "sqlite.h"
+#include <map>
+#include <chrono>
 
 //#define SQLITE_MASTER "sqlite_master"
 #define SQLITE_MASTER "sqlite_schema"
@@ -11,6 +13,7 @@ private:
 	std::wstring db_name;
 	std::wstring db_filename;
 	sqlite3 * db;
+	mutable sqlite_stmt_cache stmt_cache;
 
 	// copy and assignment not allowed
 	SQLiteDB(const SQLiteDB&) = delete;
@@ -22,6 +25,7 @@ private:
 public:
 
 	sqlite3 * GetDb() { return db; };	
+	sqlite_stmt_cache * GetStmtCache() { return &stmt_cache; };
 
 	//! Database object types.
 	enum obj_type {
@@ -36,14 +40,24 @@ public:
 	const wchar_t * ObjectNameByType(obj_type type) const;
 	obj_type GetDbObjectType(const char* object_name) const;
 
+	//! Row count state.
+	enum count_state {
+		cs_exact,	///< Counted with count(*)
+		cs_estimate,	///< Estimated (sqlite_stat1 or dbstat pages)
+		cs_pending,	///< Not known yet
+		cs_failed	///< Count failed (or database can't be opened for counting)
+	};
+
 	//! Database object description.
 	struct sq_object {
 		std::string name;	///< Object name
 		obj_type type;		///< Object type
-		uint64_t row_count;	///< Number of records (count), only for tables and views
+		uint64_t row_count;	///< Number of records, only for tables and views
+		count_state count;	///< Row count state
 	};
 	typedef std::vector<sq_object> sq_objects;
 
+	// objects list with estimated (not exact) row counts
 	bool GetObjectsList(sq_objects& objects) const;
 
 	//! Column types.
@@ -60,18 +74,133 @@ public:
 	//! Column description.
 	struct sq_column {
 		std::string name;	///< Name
-		col_type type;		///< Type
+		col_type type;		///< Type (affinity)
+		std::string decl_type;	///< Declared type
+		bool not_null = false;	///< NOT NULL constraint
+		int pk = 0;		///< Index in primary key (1-based), 0 if not in primary key
 	};
 	typedef std::vector<sq_column> sq_columns;
 
+	//! Schema object description (cached until schema change).
+	struct sq_schema_object {
+		obj_type type;		///< Object type
+		std::string sql;	///< Creation SQL
+		bool columns_loaded;	///< Columns are read (on first use)
+		sq_columns columns;	///< Columns (tables and views)
+		std::vector<std::string> indexes;	///< Index names (tables)
+	};
+
+	const sq_schema_object * GetSchemaObject(const char* object_name) const;
+
 	bool ReadColumnDescription(const char* object_name, sq_columns & columns) const;
 
 	bool GetRowCount(const char* object_name, uint64_t& count) const;
 
+	// cheap row count estimate (sqlite_stat1 or first pages of b-tree in dbstat), without full table scan
+	bool GetRowCountEstimate(const char* object_name, uint64_t& count) const;
+
 	bool GetCreationSql(const char* object_name, std::string& query) const;
 
 	bool ExecuteQuery(const char* query) const;
 
+	// EXPLAIN QUERY PLAN of the first statement as tree (as in sqlite shell)
+	bool GetQueryPlan(const char* query, std::string& plan) const;
+
+	//! Database content version, changed on any commit (own or other connection) or schema change.
+	struct db_version {
+		int64_t data;		///< PRAGMA data_version (commits of other connections)
+		int64_t changes;	///< sqlite3_total_changes64 (own changes)
+		int64_t schema;		///< PRAGMA schema_version
+		bool operator==(const db_version & v) const { return data == v.data && changes == v.changes && schema == v.schema; };
+		bool operator!=(const db_version & v) const { return !(*this == v); };
+	};
+
+	bool GetVersion(db_version & version) const;
+
+	// connection has state other connections can't see: open transaction,
+	// temp objects or attached databases
+	bool HasSessionState(void) const;
+
+	//! Space usage of database object (table or index b-tree), read from dbstat.
+	struct sq_space {
+		std::string name;		///< Object name
+		obj_type type;			///< Object type
+		uint64_t size;			///< Bytes of all pages
+		uint64_t pages;			///< All pages (internal, leaf and overflow)
+		uint64_t leaf_pages;		///< Leaf pages
+		uint64_t overflow_pages;	///< Overflow pages
+		uint64_t payload;		///< Payload bytes
+		uint64_t unused;		///< Unused bytes
+		double fanout;			///< Average children of internal page (0 without internal pages)
+		double fragmentation;		///< Leaf pages not following the previous leaf on disk, percent
+	};
+	typedef std::vector<sq_space> sq_spaces;
+
+	// column with name exists (case insensitive), e.g. column hides rowid
+	static bool HasColumn(const sq_columns & columns, const char * name);
+	// rowid alias not hidden by column name (rowid, _rowid_, oid), nullptr if all are hidden
+	static const char * RowidAlias(const sq_columns & columns);
+
+	// space usage of objects (one pass over dbstat), cached until database change
+	bool GetSpaceUsage(sq_spaces & objects) const;
+
+	/**
+	 * Callback on waiting for lock held by other connection (busy timeout is kept),
+	 * e.g. to stop own background readers.
+	 * \param callback function, nullptr restores plain busy timeout
+	 * \param param callback parameter
+	 */
+	typedef void (*busy_fn)(void * param);
+	void SetBusyCallback(busy_fn callback, void * param);
+
+	/**
+	 * Cancellation of long running statements while scope is alive.
+	 * Abort callback is checked (not more often than every CANCEL_CHECK_MS)
+	 * from sqlite progress handler, statement is interrupted with SQLITE_INTERRUPT.
+	 */
+	class CancelScope {
+	public:
+		typedef bool (*aborted_fn)(void);
+
+		CancelScope(SQLiteDB & db, aborted_fn aborted);
+		~CancelScope();
+
+		// statement was interrupted by user
+		bool Cancelled(void) const { return cancelled; };
+
+	private:
+		static int Handler(void * param);
+
+		SQLiteDB & db;
+		aborted_fn aborted;
+		CancelScope * prev;
+		std::chrono::steady_clock::time_point next_check;
+		bool cancelled;
+
+		// copy and assignment not allowed
+		CancelScope(const CancelScope&) = delete;
+		void operator=(const CancelScope&) = delete;
+	};
+
+private:
+	CancelScope * cancel_scope;
+
+	busy_fn busy_callback;
+	void * busy_param;
+	static int BusyHandler(void * param, int count);
+
+	mutable std::map<std::string, sq_schema_object> schema;
+	mutable sqlite3_int64 schema_version;
+
+	mutable sq_spaces space;
+	mutable db_version space_version;
+	mutable bool space_valid;
+
+	bool RefreshSchema(void) const;
+	bool LoadColumns(const char* object_name, sq_schema_object & obj) const;
+
+public:
+
 	// check db without create object
 	static bool ValidFormat(const unsigned char* data, const size_t size);
 
@@ -81,8 +210,9 @@ public:
 	std::wstring LastError(void) const;
 
 	const std::wstring & GetDbName(void) const {return db_name;};
+	const std::wstring & GetDbFileName(void) const {return db_filename;};
 
-	SQLiteDB(const wchar_t * db_filename);
+	SQLiteDB(const wchar_t * db_filename, bool read_only = false);
 	~SQLiteDB();
 
 };
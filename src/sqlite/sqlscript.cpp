@@ -0,0 +1,339 @@
+#include "sqlscript.h"
+#include <utils.h>
+#include <cctype>
+#include <cstring>
+
+#include <common/log.h>
+#include <common/utf8util.h>
+
+extern const char * LOG_FILE;
+#define LOG_SOURCE_FILE "sqlscript.cpp"
+
+namespace {
+
+const char * skip_spaces(const char * sql)
+{
+	while( isspace(static_cast<unsigned char>(*sql)) )
+		++sql;
+	return sql;
+}
+
+// Read keyword (upper case) at SQL text, leading white spaces and comments are skipped
+const char * read_keyword(const char * sql, std::string & word)
+{
+	word.clear();
+	for( ;; ) {
+		sql = skip_spaces(sql);
+		if( sql[0] == '-' && sql[1] == '-' ) {
+			sql = strchr(sql, '\n');
+			if( !sql )
+				return "";
+		}
+		else if( sql[0] == '/' && sql[1] == '*' ) {
+			const char * end = strstr(sql + 2, "*/");
+			if( !end )
+				return "";
+			sql = end + 2;
+		}
+		else
+			break;
+	}
+	while( isalpha(static_cast<unsigned char>(*sql)) )
+		word += static_cast<char>(toupper(static_cast<unsigned char>(*sql++)));
+	return sql;
+}
+
+// Identifier character as in sqlite tokenizer
+bool id_char(const char c)
+{
+	return isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+// End of the first complete statement (after ';'), nullptr if statement is not complete.
+// Used for statements which can't be prepared: parser stops at error position.
+// Text is scanned once by the state machine of sqlite3_complete (';' inside strings,
+// comments and trigger bodies doesn't end statement), calling sqlite3_complete for
+// each ';' would scan the text from the start again.
+const char * statement_end(const char * sql, const char * end)
+{
+	enum { tk_semi, tk_ws, tk_other, tk_explain, tk_create, tk_temp, tk_trigger, tk_end };
+	static const unsigned char trans[8][8] = {
+		/* invalid */ { 1, 0, 2, 3, 4, 2, 2, 2 },
+		/* start   */ { 1, 1, 2, 3, 4, 2, 2, 2 },
+		/* normal  */ { 1, 2, 2, 2, 2, 2, 2, 2 },
+		/* explain */ { 1, 3, 3, 2, 4, 2, 2, 2 },
+		/* create  */ { 1, 4, 2, 2, 2, 4, 5, 2 },
+		/* trigger */ { 6, 5, 5, 5, 5, 5, 5, 5 },
+		/* semi    */ { 6, 6, 5, 5, 5, 5, 5, 7 },
+		/* end     */ { 1, 7, 5, 5, 5, 5, 5, 5 },
+	};
+	auto keyword = [](const char * word, size_t len, const char * kw) {
+		return strlen(kw) == len && StrnCiCmp(word, kw, len) == 0;
+	};
+
+	unsigned char state = 0;
+	for( const char * p = sql; p < end; ++p ) {
+		int token;
+		switch( *p ) {
+		case ';':
+			token = tk_semi;
+			break;
+		case ' ': case '\r': case '\t': case '\n': case '\f':
+			token = tk_ws;
+			break;
+		case '/':
+			if( p + 1 < end && p[1] == '*' ) {
+				const char * close = p + 2;
+				while( (close = static_cast<const char *>(memchr(close, '*', end - close))) && (close + 1 >= end || close[1] != '/') )
+					++close;
+				if( !close )
+					return nullptr;
+				p = close + 1;
+				token = tk_ws;
+			}
+			else
+				token = tk_other;
+			break;
+		case '-':
+			if( p + 1 < end && p[1] == '-' ) {
+				p = static_cast<const char *>(memchr(p, '\n', end - p));
+				if( !p )
+					return nullptr;
+				token = tk_ws;
+			}
+			else
+				token = tk_other;
+			break;
+		case '[':
+		case '`': case '"': case '\'':
+			p = static_cast<const char *>(memchr(p + 1, *p == '[' ? ']' : *p, end - p - 1));
+			if( !p )
+				return nullptr;
+			token = tk_other;
+			break;
+		default:
+			token = tk_other;
+			if( id_char(*p) ) {
+				const char * word = p;
+				while( p + 1 < end && id_char(p[1]) )
+					++p;
+				const size_t len = p + 1 - word;
+				if( keyword(word, len, "create") )
+					token = tk_create;
+				else if( keyword(word, len, "trigger") )
+					token = tk_trigger;
+				else if( keyword(word, len, "temp") || keyword(word, len, "temporary") )
+					token = tk_temp;
+				else if( keyword(word, len, "end") )
+					token = tk_end;
+				else if( keyword(word, len, "explain") )
+					token = tk_explain;
+			}
+			break;
+		}
+		state = trans[state][token];
+		if( token == tk_semi && state == 1 )
+			return p + 1;
+	}
+	return nullptr;
+}
+
+} // namespace
+
+SQLiteScript::SQLiteScript(SQLiteDB & _db, Handler & _handler, bool _transaction):
+	db(_db),
+	handler(_handler),
+	transaction(_transaction),
+	in_transaction(false),
+	statements(0),
+	bytes(0)
+{
+}
+
+SQLiteScript::~SQLiteScript()
+{
+	if( in_transaction ) {
+		LOG_INFO("rollback not committed script\n");
+		Exec("ROLLBACK");
+	}
+}
+
+bool SQLiteScript::Execute(const char * text, size_t size, bool more)
+{
+	//Statements are prepared from zero terminated text: with length sqlite copies the whole rest
+	const char * p = text;
+	if( more || !pending.empty() ) {
+		pending.append(text, size);
+		p = pending.c_str();
+		size = pending.size();
+	}
+	const char * const end = p + size;
+
+	bool ok = true;
+	while( p < end ) {
+		sqlite3_stmt * stmt = nullptr;
+		const char * tail = nullptr;
+		const int rc = sqlite3_prepare_v2(db.GetDb(), p, -1, &stmt, &tail);
+		if( rc != SQLITE_OK ) {
+			const std::wstring error = db.LastError();
+			const char * next = statement_end(p, end);
+			if( !next ) {
+				if( more )
+					break;
+				next = end;
+			}
+			const char * query = skip_spaces(p);
+			LOG_ERROR("prepare: %.*s ... %S\n", static_cast<int>(next - query), query, error.c_str());
+			if( !handler.Error(std::string(query, next), error, true) ) {
+				ok = false;
+				break;
+			}
+			tail = next;
+		}
+		else if( !stmt ) {
+			//White spaces, comments or zero character
+			if( more && tail == end )
+				break;
+			if( tail <= p )
+				tail = p + 1;
+			p = tail;
+			continue;
+		}
+		else if( more && tail == end && !sqlite3_complete(p) ) {
+			//Statement may continue in the next part
+			sqlite3_finalize(stmt);
+			break;
+		}
+		else {
+			ok = Run(stmt);
+			sqlite3_finalize(stmt);
+			if( !ok )
+				break;
+		}
+		bytes += tail - p;
+		p = tail;
+		++statements;
+		if( !handler.Progress(statements, bytes) ) {
+			ok = false;
+			break;
+		}
+	}
+
+	if( !ok ) {
+		pending.clear();
+		Rollback();
+		return false;
+	}
+	if( !pending.empty() )
+		pending.erase(0, p - pending.c_str());
+	return true;
+}
+
+bool SQLiteScript::Commit(void)
+{
+	if( !in_transaction )
+		return true;
+	in_transaction = false;
+	if( !Exec("COMMIT") ) {
+		handler.Error("COMMIT", db.LastError(), false);
+		Rollback();
+		return false;
+	}
+	return true;
+}
+
+// Execute prepared statement of the script, return false to stop the script
+bool SQLiteScript::Run(sqlite3_stmt * stmt)
+{
+	sqlite3 * handle = db.GetDb();
+	const char * sql = skip_spaces(sqlite3_sql(stmt));
+
+	std::string keyword, next;
+	const char * p = read_keyword(sql, keyword);
+	if( keyword == "ROLLBACK" ) {
+		p = read_keyword(p, next);
+		if( next == "TRANSACTION" )
+			read_keyword(p, next);
+	}
+	//Script with own transaction control, it can't be wrapped
+	const bool control = keyword == "BEGIN" || keyword == "COMMIT" || keyword == "END" || (keyword == "ROLLBACK" && next != "TO");
+	//Statements not allowed in transaction
+	const bool standalone = keyword == "VACUUM" || keyword == "ATTACH" || keyword == "DETACH";
+
+	if( control || standalone ) {
+		if( in_transaction ) {
+			in_transaction = false;
+			if( !Exec("COMMIT") ) {
+				handler.Error("COMMIT", db.LastError(), false);
+				return false;
+			}
+		}
+		if( control )
+			transaction = false;
+	}
+	else if( transaction && !in_transaction ) {
+		if( !Exec("BEGIN") ) {
+			handler.Error("BEGIN", db.LastError(), false);
+			return false;
+		}
+		in_transaction = true;
+	}
+
+	//Statement is executed in savepoint to roll back only its own changes on error,
+	//user savepoints are not wrapped (release/rollback would remove the nested one)
+	const bool in_tx = !sqlite3_get_autocommit(handle);
+	const bool wrap = in_tx && !control && keyword != "SAVEPOINT" && keyword != "RELEASE" && keyword != "ROLLBACK";
+	if( wrap && !Savepoint(sp_begin) ) {
+		handler.Error("SAVEPOINT", db.LastError(), false);
+		return false;
+	}
+
+	int rc;
+	while( (rc = sqlite3_step(stmt)) == SQLITE_ROW )
+		;
+	if( rc == SQLITE_DONE ) {
+		if( wrap && !Savepoint(sp_release) ) {
+			handler.Error("RELEASE", db.LastError(), false);
+			return false;
+		}
+		return true;
+	}
+
+	const std::wstring error = db.LastError();
+	LOG_ERROR("step_execute: %s ... %S\n", sql, error.c_str());
+	sqlite3_reset(stmt);
+	if( wrap && !sqlite3_get_autocommit(handle) ) {
+		Savepoint(sp_rollback);
+		Savepoint(sp_release);
+	}
+	//Some errors (interrupt, disk full, ON CONFLICT ROLLBACK) roll back the whole transaction
+	const bool lost = in_tx && sqlite3_get_autocommit(handle);
+	if( lost )
+		in_transaction = false;
+	return handler.Error(sql, error, !lost) && !lost;
+}
+
+// Savepoint statements are executed around each statement, prepared once by statements cache
+bool SQLiteScript::Savepoint(sp_op op)
+{
+	static const char * const queries[sp_count] = { "SAVEPOINT script_stmt", "RELEASE script_stmt", "ROLLBACK TO script_stmt" };
+	return Exec(queries[op]);
+}
+
+bool SQLiteScript::Exec(const char * query)
+{
+	sqlite_statement stmt(db.GetDb(), db.GetStmtCache());
+	if( stmt.prepare(query) != SQLITE_OK || stmt.step_execute() != SQLITE_DONE ) {
+		LOG_ERROR("%s ... %S\n", query, db.LastError().c_str());
+		return false;
+	}
+	return true;
+}
+
+// Stop script: roll back script transaction (or own transaction of the script)
+void SQLiteScript::Rollback(void)
+{
+	in_transaction = false;
+	if( !sqlite3_get_autocommit(db.GetDb()) )
+		Exec("ROLLBACK");
+}
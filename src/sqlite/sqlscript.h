@@ -0,0 +1,66 @@
+#ifndef __SQLSCRIPT_H__
+#define __SQLSCRIPT_H__
+
+#include "sqlitedb.h"
+
+// Multi-statement script runner. Statements are split by sqlite3_prepare_v2
+// tail pointer, so strings, comments and trigger bodies are handled by sqlite.
+// Script runs in one transaction (opened on first statement), statements are
+// executed in savepoints: failed statement is rolled back alone and may be skipped.
+// Scripts with own BEGIN/COMMIT manage transactions themselves.
+class SQLiteScript {
+public:
+	// script events (UI)
+	class Handler {
+	public:
+		// called after each statement, return false to stop the script
+		virtual bool Progress(uint64_t statements, uint64_t bytes) = 0;
+		// statement failed and was rolled back, return true to skip it and continue
+		// (can_skip is false if sqlite rolled back the whole transaction)
+		virtual bool Error(const std::string & query, const std::wstring & error, bool can_skip) = 0;
+		virtual ~Handler() {};
+	};
+
+	// execute script part, with more == true the incomplete last statement is kept
+	// until the next part (text must be zero terminated at text[size] otherwise);
+	// return false on error or stop (open transaction is rolled back)
+	bool Execute(const char * text, size_t size, bool more = false);
+
+	// commit script transaction after the last part
+	bool Commit(void);
+
+	uint64_t Statements(void) const { return statements; };
+	uint64_t Bytes(void) const { return bytes; };
+
+	SQLiteScript(SQLiteDB & db, Handler & handler, bool transaction = true);
+	// not committed script transaction is rolled back
+	~SQLiteScript();
+
+private:
+	//! Statement savepoint operations.
+	enum sp_op {
+		sp_begin,
+		sp_release,
+		sp_rollback,
+		sp_count
+	};
+
+	bool Run(sqlite3_stmt * stmt);
+	bool Savepoint(sp_op op);
+	bool Exec(const char * query);
+	void Rollback(void);
+
+	SQLiteDB & db;
+	Handler & handler;
+	bool transaction;	///< wrap script in transaction
+	bool in_transaction;	///< script transaction is open
+	std::string pending;	///< incomplete statement of previous part
+	uint64_t statements;
+	uint64_t bytes;
+
+	// copy and assignment not allowed
+	SQLiteScript(const SQLiteScript&) = delete;
+	void operator=(const SQLiteScript&) = delete;
+};
+
+#endif /* __SQLSCRIPT_H__ */
@@ -2,14 +2,79 @@
 #include "fardialog.h"
 #include "progress.h"
 #include "exporter.h"
+#include "bufwriter.h"
 #include <common/log.h>
 #include <common/utf8util.h>
 #include <sqlite/sqlite.h>
+#include <sqlite/sqlscript.h>
+#include <sqlite/profiler.h>
 #include <utils.h>
+#include <chrono>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 extern const char * LOG_FILE;
 #define LOG_SOURCE_FILE "sqlitepanel.cpp"
 
+#define SCRIPT_PROGRESS_MS 100	// script progress window update interval
+#define SQL_FILE_CHUNK_SIZE (1024 * 1024)	// SQL file is read and executed by chunks
+
+namespace {
+
+// Script execution UI: executed statements counter, error with skip/cancel choice
+class ScriptHandler : public SQLiteScript::Handler {
+public:
+	ScriptHandler(SQLiteDB & _db, progress & _prg_wnd, const SQLiteDB::CancelScope & _cancel):
+		db(_db),
+		prg_wnd(_prg_wnd),
+		cancel(_cancel),
+		next_update(std::chrono::steady_clock::now() + std::chrono::milliseconds(SCRIPT_PROGRESS_MS))
+	{
+	}
+
+	bool Progress(uint64_t statements, uint64_t bytes) override
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if( now < next_update )
+			return true;
+		next_update = now + std::chrono::milliseconds(SCRIPT_PROGRESS_MS);
+		wchar_t info[64];
+		swprintf(info, sizeof(info) / sizeof(info[0]), GetMsg(ps_exec_count), static_cast<unsigned long long>(statements));
+		prg_wnd.update(bytes, info);
+		return !progress::aborted();
+	}
+
+	bool Error(const std::string & query, const std::wstring & error, bool can_skip) override
+	{
+		prg_wnd.hide();
+		if( cancel.Cancelled() )
+			return false;
+		const std::wstring query_descr = MB2Wide(query.c_str());
+		if( !can_skip ) {
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), db.GetDbName().c_str(), query_descr.c_str(), error.c_str() };
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+			return false;
+		}
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), db.GetDbName().c_str(), query_descr.c_str(), error.c_str(), GetMsg(ps_skip), GetMsg(ps_cancel) };
+		if( Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 2) != 0 )
+			return false;
+		prg_wnd.show();
+		return true;
+	}
+
+private:
+	static const wchar_t * GetMsg(int id) { return Plugin::psi.GetMsg(Plugin::psi.ModuleNumber, id); }
+
+	SQLiteDB & db;
+	progress & prg_wnd;
+	const SQLiteDB::CancelScope & cancel;
+	std::chrono::steady_clock::time_point next_update;
+};
+
+} // namespace
+
 SqlitePanel::SqlitePanel(const wchar_t * name, const unsigned char * data, int dataSize, int opMode):
 	FarPanel()
 {
@@ -61,7 +126,7 @@ SqlitePanel::~SqlitePanel()
 	LOG_INFO("\n");
 }
 
-bool SqlitePanel::OpenQuery(const char* query)
+bool SqlitePanel::OpenQuery(const char* query, bool profile)
 {
 	LOG_INFO("%s\n", query);
 
@@ -79,28 +144,31 @@ bool SqlitePanel::OpenQuery(const char* query)
 	if( StrnCiCmp(select_word, "select", 6) != 0 ) {
 
 		LOG_INFO("NOT SELECT: %s\n", query);
-		//Update query - just execute without read result
-		progress prg_wnd(ps_execsql);
-		for (auto ps = query; ps; ) {
-			auto pe = strstr(ps, ";\n");
-			const char* next = pe ? pe + 2 : nullptr;
-			while (isspace(*ps)) ++ps;
-			std::string one_query(ps, next ? size_t(next - ps - 1) : strlen(ps));
-			if (*ps && !(*ps=='-' && ps[1]=='-') && !db->ExecuteQuery(one_query.c_str())) {
-				prg_wnd.hide();
-				const std::wstring query_descr = MB2Wide(one_query.c_str());
-				const std::wstring err_descr = db->LastError();
-				const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str() };
-				Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
-				return false;
-			}
-			ps = next;
+		//Update query - execute script in one transaction without read result
+		const size_t size = strlen(query);
+		progress prg_wnd(ps_execsql, size);
+		SQLiteDB::CancelScope cancel(*db, progress::aborted);
+		ScriptHandler handler(*db, prg_wnd, cancel);
+		std::unique_ptr<SQLiteProfiler> profiler;
+		if( profile )
+			profiler = std::make_unique<SQLiteProfiler>(*db);
+		SQLiteScript script(*db, handler);
+		const bool ok = script.Execute(query, size) && script.Commit();
+		if( profiler ) {
+			prg_wnd.hide();
+			profiler->Finish();
+			SqlitePanelQuery::ShowProfile(db->GetDbFileName(), profiler->Report());
 		}
+		if( !ok )
+			return false;
+		LOG_INFO("%llu statements executed\n", static_cast<unsigned long long>(script.Statements()));
+		prg_wnd.hide();
+		CloseScriptTransaction();
 	}
 	else {
 
 		LOG_INFO("SELECT: %s\n", query);
-		panels.push_back(std::make_unique<SqlitePanelQuery>(SqliteTablePanelIndex, db, query));
+		panels.push_back(std::make_unique<SqlitePanelQuery>(SqliteTablePanelIndex, db, query, profile));
 		if( !panels[++active]->Valid() ) {
 			panels.pop_back();
 			active--;
@@ -127,30 +195,21 @@ void SqlitePanel::StorePosition(void)
 	}
 }
 
-void SqlitePanel::EditSqlQuery(void)
+void SqlitePanel::EditSqlQuery(bool profile)
 {
 
 	LOG_INFO("\n");
 
 	const std::wstring tmp_file_name = exporter::get_temp_file_name(L"sql");
 
-	HANDLE file = CreateFile(tmp_file_name.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-	if( file == INVALID_HANDLE_VALUE ) {
-		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), tmp_file_name.c_str() };
-		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
-		return;
-	}
 	//Save last used query
-	if( !_last_sql_query.empty() ) {
-		DWORD bytes_written;
-		if( !WriteFile(file, _last_sql_query.c_str(), static_cast<DWORD>(_last_sql_query.length()), &bytes_written, nullptr)) {
-			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), tmp_file_name.c_str() };
-			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
-			CloseHandle(file);
-			return;
-		}
+	BufferedWriter file(_last_sql_query.length());
+	if( !file.Open(tmp_file_name.c_str(), BufferedWriter::bw_default) || !file.Write(_last_sql_query) || !file.Close() ) {
+		const std::wstring err_descr = file.ErrorText();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), tmp_file_name.c_str(), err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return;
 	}
-	CloseHandle(file);
 
 	//Open query editor
 	if( Plugin::psi.Editor(tmp_file_name.c_str(), L"SQLite query", 0, 0, -1, -1, EF_DISABLEHISTORY, 1, 1, CP_UTF8) == EEC_MODIFIED) {
@@ -163,7 +222,7 @@ void SqlitePanel::EditSqlQuery(void)
 			return;
 		}
 		DWORD bytes_read = static_cast<DWORD>(file_size.QuadPart);
-		if (bytes_read > 1024 * 1024)	//I think SQL query is not so big...
+		if (!bytes_read)
 			return;
 		std::vector<char> file_buff(bytes_read);
 		if( !ReadFile(file, &file_buff.front(), bytes_read, &bytes_read, nullptr) ) {
@@ -201,7 +260,127 @@ void SqlitePanel::EditSqlQuery(void)
 		while ((r_pos = _last_sql_query.find('\r', r_pos)) != std::string::npos)
 			_last_sql_query.erase(r_pos, 1);
 
-		OpenQuery(_last_sql_query.c_str());
+		OpenQuery(_last_sql_query.c_str(), profile);
+	}
+}
+
+void SqlitePanel::ExecuteSqlFile(void)
+{
+	LOG_INFO("\n");
+
+	//File under cursor of passive panel
+	std::wstring file_name;
+	wchar_t dir[512];
+	Plugin::psi.Control(PANEL_PASSIVE, FCTL_GETPANELDIR, sizeof(dir) / sizeof(dir[0]), (LONG_PTR)dir);
+	file_name = dir;
+	if( !file_name.empty() && *file_name.rbegin() != L'/' )
+		file_name += L'/';
+
+	PanelInfo pi = {0};
+	Plugin::psi.Control(PANEL_PASSIVE, FCTL_GETPANELINFO, 0, (LONG_PTR)&pi);
+	if( !pi.Plugin && pi.ItemsNumber > 0 ) {
+		const auto size = Plugin::psi.Control(PANEL_PASSIVE, FCTL_GETPANELITEM, pi.CurrentItem, 0);
+		if( PluginPanelItem * ppi = static_cast<PluginPanelItem *>(malloc(size)) ) {
+			Plugin::psi.Control(PANEL_PASSIVE, FCTL_GETPANELITEM, pi.CurrentItem, (LONG_PTR)ppi);
+			if( (ppi->FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 )
+				file_name += ppi->FindData.lpwszFileName;
+			free(ppi);
+		}
+	}
+
+	wchar_t dst_file_name[1024];
+	if( !Plugin::psi.InputBox(GetMsg(ps_sqlf_title), GetMsg(ps_sqlf_main), L"SQLiteSqlFile", file_name.c_str(),
+			dst_file_name, sizeof(dst_file_name) / sizeof(dst_file_name[0]), nullptr, FIB_BUTTONS | FIB_EXPANDENV) || !dst_file_name[0] )
+		return;
+
+	ExecuteSqlFile(dst_file_name);
+
+	Plugin::psi.Control(PANEL_ACTIVE, FCTL_UPDATEPANEL, 0, 0);
+	PanelRedrawInfo pri;
+	memset(&pri, 0, sizeof(pri));
+	Plugin::psi.Control(PANEL_ACTIVE, FCTL_REDRAWPANEL, 0, (LONG_PTR)&pri);
+}
+
+bool SqlitePanel::ExecuteSqlFile(const wchar_t* file_name)
+{
+	LOG_INFO("%S\n", file_name);
+
+	const std::string name = Wide2MB(file_name);
+	const int fd = open(name.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if( fd == -1 || fstat(fd, &st) != 0 ) {
+		const std::wstring err_descr = MB2Wide(strerror(errno));
+		if( fd != -1 )
+			close(fd);
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_readf), file_name, err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return false;
+	}
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+	//File is executed by chunks, incomplete statement at the chunk end is kept by the script
+	progress prg_wnd(ps_execsql, st.st_size);
+	SQLiteDB::CancelScope cancel(*db, progress::aborted);
+	ScriptHandler handler(*db, prg_wnd, cancel);
+	SQLiteScript script(*db, handler);
+	std::vector<char> buffer(SQL_FILE_CHUNK_SIZE);
+	bool first = true;
+	int read_err = 0;
+	bool ok = true;
+	for( ;; ) {
+		const ssize_t res = read(fd, buffer.data(), buffer.size());
+		if( res < 0 ) {
+			if( errno == EINTR )
+				continue;
+			read_err = errno;
+			break;
+		}
+		if( !res )
+			break;
+		size_t skip = 0;
+		if( first && res >= 3 && memcmp(buffer.data(), "\xef\xbb\xbf", 3) == 0 )	//UTF-8 BOM
+			skip = 3;
+		first = false;
+		if( !(ok = script.Execute(buffer.data() + skip, res - skip, true)) )
+			break;
+	}
+	close(fd);
+
+	if( read_err ) {
+		//Not executed rest of the file: script transaction is rolled back by destructor
+		prg_wnd.hide();
+		const std::wstring err_descr = MB2Wide(strerror(read_err));
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_readf), file_name, err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return false;
+	}
+	if( !ok || !script.Execute("", 0) || !script.Commit() )
+		return false;
+
+	LOG_INFO("%llu statements executed\n", static_cast<unsigned long long>(script.Statements()));
+	prg_wnd.hide();
+	CloseScriptTransaction();
+	return true;
+}
+
+void SqlitePanel::CloseScriptTransaction(void)
+{
+	if( sqlite3_get_autocommit(db->GetDb()) )
+		return;
+
+	LOG_INFO("transaction is open\n");
+	const wchar_t* msg[] = {GetMsg(ps_title_short), GetMsg(ps_tran_open), db->GetDbName().c_str(), GetMsg(ps_commit), GetMsg(ps_rollback), GetMsg(ps_leave_open) };
+	const int choice = Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING, nullptr, msg, sizeof(msg) / sizeof(msg[0]), 3);
+	if( choice != 0 && choice != 1 )
+		return;
+	const char* query = choice == 0 ? "commit" : "rollback";
+	if( !db->ExecuteQuery(query) ) {
+		const std::wstring query_descr = MB2Wide(query);
+		const std::wstring err_descr = db->LastError();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
 	}
 }
 
@@ -234,9 +413,24 @@ int SqlitePanel::ProcessKey(HANDLE hPlugin, int key, unsigned int controlState,
 		return TRUE;
 	}
 
+	if( controlState == PKF_CONTROL && key == VK_F6 ) {
+		EditSqlQuery(true);
+		return TRUE;
+	}
+
+	if( controlState == PKF_SHIFT && key == VK_F6 ) {
+		ExecuteSqlFile();
+		return TRUE;
+	}
+
 	return active < panels.size() ? panels[active]->ProcessKey(hPlugin, key, controlState, change):int(false);
 }
 
+int SqlitePanel::ProcessEvent(HANDLE hPlugin, int event, void * param)
+{
+	return active < panels.size() ? panels[active]->ProcessEvent(hPlugin, event, param):int(false);
+}
+
 int SqlitePanel::GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber)
 {
 	LOG_INFO("\n");
@@ -246,6 +440,9 @@ int SqlitePanel::GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNum
 void SqlitePanel::FreeFindData(struct PluginPanelItem * panelItem, int itemsNumber)
 {
 	LOG_INFO("\n");
+	//Data of already closed panel
+	if( FreeFindDataArena(panelItem) )
+		return;
 	if( active < panels.size() )
 		panels[active]->FreeFindData(panelItem, itemsNumber);
 }
@@ -276,6 +473,14 @@ int SqlitePanel::SetDirectory(const wchar_t *dir, int opMode)
 			panels.pop_back();
 			active--;
 		}
+	} else if( active == 0 && Plugin::FSF.LStricmp(dir, SPACE_DIR_NAME) == 0 ) {
+		panels.push_back(std::make_unique<SqlitePanelSpace>(SqliteSpacePanelIndex, db));
+		if( !panels[++active]->Valid() ) {
+			panels.pop_back();
+			active--;
+		} else
+			StorePosition();
+		return int(true);
 	} else {
 
 		switch( db->GetDbObjectType(Wide2MB(dir).c_str()) ) {
@@ -4,6 +4,7 @@
 #include "sqlitepaneldb.h"
 #include "sqlitepaneltable.h"
 #include "sqlitepanelquery.h"
+#include "sqlitepanelspace.h"
 
 class SqlitePanel : public FarPanel
 {
@@ -17,8 +18,14 @@ private:
 	std::vector<std::unique_ptr<FarPanel>> panels;
 
 	std::string _last_sql_query;
-	void EditSqlQuery(void);
-	bool OpenQuery(const char* query);
+	// edit and execute query (with statements profile)
+	void EditSqlQuery(bool profile = false);
+	bool OpenQuery(const char* query, bool profile = false);
+	// execute SQL file (GUI mode: file name from passive panel)
+	void ExecuteSqlFile(void);
+	bool ExecuteSqlFile(const wchar_t* file_name);
+	// script with own BEGIN left transaction open: commit, roll back or leave it
+	void CloseScriptTransaction(void);
 
 	void StorePosition(void);
 	
@@ -31,6 +38,7 @@ public:
 	bool Valid(void) override;
 
 	int ProcessKey(HANDLE hPlugin, int key, unsigned int controlState, bool & change) override;
+	int ProcessEvent(HANDLE hPlugin, int event, void * param) override;
 	int GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber) override;
 	void FreeFindData(struct PluginPanelItem * panelItem, int itemsNumber) override;
 	void GetOpenPluginInfo(struct OpenPluginInfo * info) override;
@@ -1,6 +1,8 @@
 #include "sqlitepaneldb.h"
 #include "fardialog.h"
 #include "exporter.h"
+#include "importer.h"
+#include "bufwriter.h"
 #include "editor.h"
 #include <common/log.h>
 #include <sqlite/sqlite.h>
@@ -11,7 +13,8 @@ extern const char * LOG_FILE;
 
 SqlitePanelDb::SqlitePanelDb(PanelIndex index_, std::unique_ptr<SQLiteDB> & _db):
 	FarPanel(index_),
-	db(_db)
+	db(_db),
+	counter(std::make_unique<SQLiteRowCounter>(*_db))
 {
 	LOG_INFO("\n");
 }
@@ -107,20 +110,13 @@ void SqlitePanelDb::ViewDbCreateSql(PluginPanelItem * ppi)
 	if( db->GetCreationSql( Wide2MB(ppi->FindData.lpwszFileName).c_str(), cr_sql) ) {
 		std::wstring tmp_file_name;
 		tmp_file_name = exporter::get_temp_file_name(L"sql");
-		HANDLE file = CreateFile(tmp_file_name.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-		if( file == INVALID_HANDLE_VALUE ) {
-			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), tmp_file_name.c_str() };
-			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		BufferedWriter file(cr_sql.length());
+		if( !file.Open(tmp_file_name.c_str(), BufferedWriter::bw_default) || !file.Write(cr_sql) || !file.Close() ) {
+			const std::wstring err_descr = file.ErrorText();
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), tmp_file_name.c_str(), err_descr.c_str() };
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
 			return;
 		}
-		DWORD bytes_written;
-		if( !WriteFile(file, cr_sql.c_str(), static_cast<DWORD>(cr_sql.length()), &bytes_written, nullptr)) {
-			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), tmp_file_name.c_str() };
-			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
-			CloseHandle(file);
-			return;
-		}
-		CloseHandle(file);
 		Plugin::psi.Viewer(tmp_file_name.c_str(), ppi->FindData.lpwszFileName, 0, 0, -1, -1, VF_ENABLE_F6 | VF_DISABLEHISTORY | VF_DELETEONLYFILEONCLOSE | VF_NONMODAL, CP_UTF8);
 	}
 }
@@ -140,20 +136,13 @@ void SqlitePanelDb::ViewDbObject(PluginPanelItem * ppi)
 		tmp_file_name = exporter::get_temp_file_name(L"sql");
 		LOG_INFO("tmp_file_name: %S\n", tmp_file_name.c_str());
 
-		HANDLE file = CreateFile(tmp_file_name.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
-		if( file == INVALID_HANDLE_VALUE ) {
-			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), tmp_file_name.c_str() };
-			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
-			return;
-		}
-		DWORD bytes_written;
-		if( !WriteFile(file, cr_sql.c_str(), static_cast<DWORD>(cr_sql.length()), &bytes_written, nullptr)) {
-			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), tmp_file_name.c_str() };
-			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_ERRORTYPE | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
-			CloseHandle(file);
+		BufferedWriter file(cr_sql.length());
+		if( !file.Open(tmp_file_name.c_str(), BufferedWriter::bw_default) || !file.Write(cr_sql) || !file.Close() ) {
+			const std::wstring err_descr = file.ErrorText();
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_writef), tmp_file_name.c_str(), err_descr.c_str() };
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
 			return;
 		}
-		CloseHandle(file);
 	}
 	else {
 		//Export data
@@ -177,10 +166,39 @@ void SqlitePanelDb::ViewDbObject(PluginPanelItem * ppi)
 	Plugin::psi.ViewerControl(VCTL_SETMODE, &vm);
 }
 
+void SqlitePanelDb::CountView(void)
+{
+	if( auto ppi = GetCurrentPanelItem() ) {
+		if( ppi->FindData.nPhysicalSize == SQLiteDB::ot_view ) {
+			uint64_t count;
+			counter->Get(Wide2MB(ppi->FindData.lpwszFileName), count);
+		}
+		FreePanelItem(ppi);
+	}
+}
+
+bool SqlitePanelDb::SpaceDirSelected(void) const
+{
+	bool selected = false;
+	if( auto ppi = GetCurrentPanelItem() ) {
+		selected = Plugin::FSF.LStricmp(ppi->FindData.lpwszFileName, SPACE_DIR_NAME) == 0;
+		FreePanelItem(ppi);
+	}
+	return selected;
+}
+
 int SqlitePanelDb::ProcessKey(HANDLE hPlugin, int key, unsigned int controlState, bool & change)
 {
 	LOG_INFO("\n");
 
+	//Rows of view are counted when it is opened or viewed
+	if( (controlState == 0 && (key == VK_F3 || key == VK_RETURN)) || (controlState == PKF_CONTROL && key == VK_NEXT) )
+		CountView();
+
+	//View, export and import of database object
+	if( ((controlState == 0 && (key == VK_F3 || key == VK_F4 || key == VK_F5)) || (controlState == PKF_SHIFT && key == VK_F5)) && SpaceDirSelected() )
+		return TRUE;
+
 	if( controlState == 0 ) {
 		switch( key ) {
 		case VK_F5:
@@ -206,9 +224,27 @@ int SqlitePanelDb::ProcessKey(HANDLE hPlugin, int key, unsigned int controlState
 		return TRUE;
 	}
 
+	//Shift+F5 (import CSV into table under cursor or new table)
+	if( controlState == PKF_SHIFT && key == VK_F5 ) {
+		importer im(db);
+		im.import_data();
+		return TRUE;
+	}
+
 	return IsPanelProcessKey(key, controlState);
 }
 
+int SqlitePanelDb::ProcessEvent(HANDLE hPlugin, int event, void * param)
+{
+	// show exact row counts from background counter
+	if( event == FE_IDLE && counter->Updated() ) {
+		LOG_INFO("row counts updated\n");
+		Plugin::psi.Control(hPlugin, FCTL_UPDATEPANEL, TRUE, 0);
+		Plugin::psi.Control(hPlugin, FCTL_REDRAWPANEL, 0, 0);
+	}
+	return int(false);
+}
+
 int SqlitePanelDb::GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber)
 {
 	LOG_INFO("\n");
@@ -221,11 +257,40 @@ int SqlitePanelDb::GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsN
 		return int(false);
 	}
 
-	*pItemsNumber = db_objects.size();
+	SQLiteDB::db_version version;
+	if( db->GetVersion(version) )
+		counter->SetVersion(version);
+
+	// views are counted on demand (view query may be expensive),
+	// estimate is kept if count failed
+	for( auto & item : db_objects ) {
+		if( item.type != SQLiteDB::ot_master && item.type != SQLiteDB::ot_table && item.type != SQLiteDB::ot_view )
+			continue;
+		uint64_t count;
+		const SQLiteDB::count_state state = counter->Get(item.name, count, item.type != SQLiteDB::ot_view);
+		if( state == SQLiteDB::cs_exact ) {
+			item.row_count = count;
+			item.count = state;
+		} else if( state == SQLiteDB::cs_failed && item.count == SQLiteDB::cs_pending )
+			item.count = state;
+	}
+
+	//Objects and space usage directory
+	*pItemsNumber = db_objects.size() + 1;
 	*pPanelItem = (struct PluginPanelItem *)malloc((*pItemsNumber) * sizeof(PluginPanelItem));
 	memset(*pPanelItem, 0, (*pItemsNumber) * sizeof(PluginPanelItem));
 	PluginPanelItem * pi = *pPanelItem;
 
+	pi->FindData.lpwszFileName = wcsdup(SPACE_DIR_NAME);
+	pi->FindData.dwFileAttributes = FILE_FLAG_DELETE_ON_CLOSE | FILE_ATTRIBUTE_DIRECTORY;
+	pi->FindData.nPhysicalSize = SQLiteDB::ot_unknown;
+	if( const wchar_t ** customColumnData = (const wchar_t **)calloc(SqliteColumnMaxIndex, sizeof(const wchar_t *)) ) {
+		customColumnData[SqliteColumnTypeIndex] = L"dbstat";
+		pi->CustomColumnNumber = SqliteColumnMaxIndex;
+		pi->CustomColumnData = customColumnData;
+	}
+	pi++;
+
 	for( const auto & item : db_objects ) {
 		pi->FindData.lpwszFileName = wcsdup(MB2Wide(item.name.c_str()).c_str());
 		pi->FindData.dwFileAttributes |= FILE_FLAG_DELETE_ON_CLOSE;
@@ -239,6 +304,18 @@ int SqlitePanelDb::GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsN
 		if( customColumnData ) {
 			memset(customColumnData, 0, SqliteColumnMaxIndex*sizeof(const wchar_t *));
 			customColumnData[SqliteColumnTypeIndex] = db->ObjectNameByType(item.type);
+			if( item.type == SQLiteDB::ot_master || item.type == SQLiteDB::ot_table || item.type == SQLiteDB::ot_view ) {
+				std::wstring count;
+				if( item.count == SQLiteDB::cs_pending )
+					count = L"?";
+				else if( item.count == SQLiteDB::cs_failed )
+					count = L"-";
+				else if( item.count == SQLiteDB::cs_estimate )
+					count = L"~" + std::to_wstring(item.row_count);
+				else
+					count = std::to_wstring(item.row_count);
+				customColumnData[SqliteColumnCountIndex] = wcsdup(count.c_str());
+			}
 			pi->CustomColumnNumber = SqliteColumnMaxIndex;
 			pi->CustomColumnData = customColumnData;
 		}
@@ -253,6 +330,8 @@ void SqlitePanelDb::FreeFindData(struct PluginPanelItem * panelItem, int itemsNu
 	while( itemsNumber-- ) {
 		assert( (panelItem+itemsNumber)->FindData.dwFileAttributes & FILE_FLAG_DELETE_ON_CLOSE );
 		free((void *)(panelItem+itemsNumber)->FindData.lpwszFileName);
+		if( (panelItem+itemsNumber)->CustomColumnData )
+			free((void *)(panelItem+itemsNumber)->CustomColumnData[SqliteColumnCountIndex]);
 		free((void *)(panelItem+itemsNumber)->CustomColumnData);
 	}
 	free((void *)panelItem);
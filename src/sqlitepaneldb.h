@@ -3,10 +3,13 @@
 
 #include "plugin.h"
 #include "sqlite/sqlitedb.h"
+#include "sqlite/rowcounter.h"
+#include "sqlitepanelspace.h"
 #include <memory>
 
 enum {
 	SqliteColumnTypeIndex,
+	SqliteColumnCountIndex,
 	SqliteColumnMaxIndex
 };
 
@@ -14,10 +17,15 @@ class SqlitePanelDb : public FarPanel
 {
 private:
 	std::unique_ptr<SQLiteDB> & db;
+	std::unique_ptr<SQLiteRowCounter> counter;
 
 	void ViewDbObject(PluginPanelItem * ppi);
 	void ViewDbCreateSql(PluginPanelItem * ppi);
 	void ViewPragmaStatements(void);
+	// queue row count of view under cursor
+	void CountView(void);
+	// space usage directory is under cursor
+	bool SpaceDirSelected(void) const;
 
 	// copy and assignment not allowed
 	SqlitePanelDb(const SqlitePanelDb&) = delete;
@@ -25,6 +33,7 @@ private:
 
 public:
 	int ProcessKey(HANDLE hPlugin, int key, unsigned int controlState, bool & change) override;
+	int ProcessEvent(HANDLE hPlugin, int event, void * param) override;
 	int GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber) override;
 	int DeleteFiles(struct PluginPanelItem *panelItem, int itemsNumber, int opMode) override;
 	void FreeFindData(struct PluginPanelItem * panelItem, int itemsNumber) override;
@@ -2,42 +2,85 @@
 #include "fardialog.h"
 #include "progress.h"
 #include "exporter.h"
+#include "bufwriter.h"
+#include "sqlite/advisor.h"
 
 #include <common/log.h>
+#include <common/arena.h>
 #include <sqlite/sqlite.h>
 #include <utils.h>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
 
 extern const char * LOG_FILE;
 #define LOG_SOURCE_FILE "sqlitepanelquery.cpp"
 
+#define FIRST_ROWS_WAIT_MS 200
+#define ADVISE_MAX_INDEXES 10	// candidate indexes in advisor dialog
+#define ADVISE_PLAN_LINES 6	// lines of each plan in advisor dialog
+#define ADVISE_DLG_WIDTH 76
+
 bool SqlitePanelQuery::Valid(void)
 {
 	return columns.size() != 0;
 }
 
-SqlitePanelQuery::SqlitePanelQuery(PanelIndex index_, std::unique_ptr<SQLiteDB> & _db, const char * _query):
+bool SqlitePanelQuery::Execute(bool wait_columns)
+{
+	executor.reset();
+	finished = false;
+	refresh = false;
+
+	result = std::make_shared<QueryExecutor::query_result>();
+	memset(&result->version, 0, sizeof(result->version));
+	db->GetVersion(result->version);
+
+	//Start query, columns are known after prepare (without step)
+	progress prg_wnd(ps_execsql);
+	executor = std::make_unique<QueryExecutor>(*db, query, profile);
+	profile = false;
+	executor->Start(progress::aborted);
+	while( wait_columns && !executor->Prepared() && executor->State() == QueryExecutor::es_running ) {
+		if( progress::aborted() )
+			executor->Cancel();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	if( wait_columns && !executor->Prepared() ) {
+		prg_wnd.hide();
+		if( executor->State() == QueryExecutor::es_error ) {
+			const std::wstring query_descr = MB2Wide(query.c_str());
+			const std::wstring & err_descr = executor->Error();
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str()};
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		}
+		return false;
+	}
+
+	if( executor->Prepared() )
+		result->columns = executor->Columns();
+	return true;
+}
+
+SqlitePanelQuery::SqlitePanelQuery(PanelIndex index_, std::unique_ptr<SQLiteDB> & _db, const char * _query, bool _profile):
 	FarPanel(index_),
-	db(_db)
+	db(_db),
+	finished(false),
+	refresh(false),
+	profile(_profile)
 {
 	columns.clear();
 	query = _query;
 
 	LOG_INFO("query %s\n", query.c_str());
 
-	//Get column description
-	sqlite_statement stmt(db->GetDb());
-	if( stmt.prepare(query.c_str()) != SQLITE_OK || (stmt.step_execute() != SQLITE_ROW && stmt.step_execute() != SQLITE_DONE) ) {
-		const std::wstring query_descr = MB2Wide(query.c_str());
-		const std::wstring err_descr = db->LastError();
-		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str()};
-		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+	if( !Execute(true) )
 		return;
-	}
 
-	const int col_count = stmt.column_count();
-	for (int i = 0; i < col_count; ++i) {
+	for( const auto & name : result->columns ) {
 		SQLiteDB::sq_column col;
-		col.name = stmt.column_name(i);
+		col.name = name;
 		col.type = SQLiteDB::ct_text;
 		columns.push_back(col);
 	}
@@ -73,10 +116,79 @@ SqlitePanelQuery::SqlitePanelQuery(PanelIndex index_, std::unique_ptr<SQLiteDB>
 SqlitePanelQuery::~SqlitePanelQuery()
 {
 	LOG_INFO("\n");
+	executor.reset();
 	for( auto item : columnTitles )
 		free((void *)item);
 }
 
+bool SqlitePanelQuery::ReceiveRows(void)
+{
+	if( finished || !executor )
+		return false;
+
+	// state is checked before queue, all rows are queued before final state
+	const QueryExecutor::exec_state state = executor->State();
+
+	if( result->columns.empty() && executor->Prepared() )
+		result->columns = executor->Columns();
+
+	bool received = false;
+	QueryExecutor::row_batch * batch;
+	while( executor->Pop(batch) ) {
+		result->batches.push_back(batch);
+		result->rows += batch->rows.size();
+		received = true;
+	}
+
+	if( state == QueryExecutor::es_running )
+		return received;
+
+	finished = true;
+	if( state == QueryExecutor::es_error ) {
+		const std::wstring query_descr = MB2Wide(query.c_str());
+		const std::wstring & err_descr = executor->Error();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str()};
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+	}
+	if( !executor->Profile().empty() )
+		ShowProfile(db->GetDbFileName(), executor->Profile());
+	return true;
+}
+
+void SqlitePanelQuery::ShowProfile(const std::wstring & db_filename, const std::string & report)
+{
+	char time_descr[32];
+	const time_t now = time(nullptr);
+	struct tm tm_now;
+	strftime(time_descr, sizeof(time_descr), "%Y-%m-%d %H:%M:%S", localtime_r(&now, &tm_now));
+	std::string text = "=== ";
+	text += time_descr;
+	text += ' ';
+	text += Wide2MB(db_filename.c_str());
+	text += '\n';
+	text += report;
+	text += '\n';
+
+	//Persisted log of all profiles
+	const std::wstring log_file_name = MB2Wide(profileLog.c_str());
+	BufferedWriter log(text.length());
+	if( !log.Open(log_file_name.c_str(), BufferedWriter::bw_append) || !log.Write(text) || !log.Close() ) {
+		const std::wstring err_descr = log.ErrorText();
+		const wchar_t* err_msg[] = {Plugin::psi.GetMsg(Plugin::psi.ModuleNumber, ps_title_short), Plugin::psi.GetMsg(Plugin::psi.ModuleNumber, ps_err_writef), log_file_name.c_str(), err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+	}
+
+	const std::wstring tmp_file_name = exporter::get_temp_file_name(L"txt");
+	BufferedWriter file(text.length());
+	if( !file.Open(tmp_file_name.c_str(), BufferedWriter::bw_default) || !file.Write(text) || !file.Close() ) {
+		const std::wstring err_descr = file.ErrorText();
+		const wchar_t* err_msg[] = {Plugin::psi.GetMsg(Plugin::psi.ModuleNumber, ps_title_short), Plugin::psi.GetMsg(Plugin::psi.ModuleNumber, ps_err_writef), tmp_file_name.c_str(), err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return;
+	}
+	Plugin::psi.Viewer(tmp_file_name.c_str(), Plugin::psi.GetMsg(Plugin::psi.ModuleNumber, ps_profile_title), 0, 0, -1, -1, VF_DISABLEHISTORY | VF_DELETEONLYFILEONCLOSE | VF_NONMODAL, CP_UTF8);
+}
+
 void SqlitePanelQuery::GetOpenPluginInfo(struct OpenPluginInfo * info)
 {
 	LOG_INFO("\n");
@@ -84,122 +196,233 @@ void SqlitePanelQuery::GetOpenPluginInfo(struct OpenPluginInfo * info)
 	title = info->PanelTitle;
 	title += db->GetDbName();
 	title += L" [" + MB2Wide(query.c_str()) + L"]";
+	if( !finished )
+		title += L" ...";
 	info->PanelTitle = title.c_str();
 }
 
 int SqlitePanelQuery::ProcessKey(HANDLE hPlugin, int key, unsigned int controlState, bool & change)
 {
 	LOG_INFO("\n");
-	return IsPanelProcessKey(key, controlState);
-}
-
-int SqlitePanelQuery::GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber)
-{
-	LOG_INFO("select %s\n", query.c_str());
-
-	progress prg_wnd(ps_reading);
 
-	//Read all data to buffer - we don't know rowset size
-	std::vector<PluginPanelItem> buff;
-
-	const static wchar_t * dots = L"..";
-	//All dots (..)
-	PluginPanelItem dot_item;
-	memset(&dot_item, 0, sizeof(dot_item));
-	dot_item.FindData.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
-	dot_item.FindData.lpwszFileName = dots;
-	const size_t col_num = columns.size();
-	const wchar_t ** customColumnData = (const wchar_t **)malloc(col_num*sizeof(const wchar_t *));
-	if( customColumnData ) {
-		memset(customColumnData, 0, col_num*sizeof(const wchar_t *));
-		for( size_t j = 0; j < col_num; ++j )
-			customColumnData[j] = wcsdup(dots);
-		dot_item.FindData.nPhysicalSize = 0;
-		dot_item.CustomColumnNumber = col_num;
-		dot_item.CustomColumnData = customColumnData;
+	//Esc (stop query)
+	if( controlState == 0 && key == VK_ESCAPE && !finished ) {
+		executor->Cancel();
+		return int(true);
 	}
-	buff.push_back(dot_item);
 
-	sqlite_statement stmt(db->GetDb());
-	if( stmt.prepare(query.c_str()) != SQLITE_OK ) {
-		prg_wnd.hide();
+	//Ctrl+R (refresh runs the query again, see GetFindData)
+	if( controlState == PKF_CONTROL && key == 'R' ) {
+		refresh = true;
+		return int(false);
+	}
 
-		const std::wstring query_descr = MB2Wide(query.c_str());
-		const std::wstring err_descr = db->LastError();
-		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str()};
-		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+	//Alt+F6 (index advisor)
+	if( controlState == PKF_ALT && key == VK_F6 ) {
+		AdviseIndexes(hPlugin);
+		return int(true);
+	}
 
-		for( size_t j = 0; j < col_num; ++j )
-			free((void *)customColumnData[j]);
-		free((void *)customColumnData);
+	return IsPanelProcessKey(key, controlState);
+}
 
-		return int(false);
+void SqlitePanelQuery::AdviseIndexes(HANDLE hPlugin)
+{
+	const std::wstring query_descr = MB2Wide(query.c_str());
+	SQLiteAdvisor advisor(*db);
+	{
+		progress prg_wnd(ps_execsql);
+		if( !advisor.Analyze(query.c_str()) ) {
+			prg_wnd.hide();
+			const std::wstring & err_descr = advisor.Error();
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str()};
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+			return;
+		}
 	}
 
-	int state = SQLITE_OK;
-	while ((state = stmt.step_execute()) == SQLITE_ROW) {
-		if (progress::aborted()) {
-			state = SQLITE_DONE;
-			break;	//Show incomplete data
+	//Same index may be suggested for several statements
+	std::vector<std::string> indexes;
+	std::string plan_before, plan_after;
+	for( const auto & item : advisor.Advices() ) {
+		for( const auto & index : item.indexes ) {
+			if( std::find(indexes.begin(), indexes.end(), index) == indexes.end() )
+				indexes.push_back(index);
 		}
-
-		PluginPanelItem item;
-		memset(&item, 0, sizeof(item));
-		const int col_count = stmt.column_count();
-		const wchar_t** custom_column_data = (const wchar_t **)malloc(col_count*sizeof(const wchar_t *));
-		if( custom_column_data ) {
-			memset(custom_column_data, 0, col_count*sizeof(const wchar_t *));
-			std::string data;
-			for( size_t j = 0; j < static_cast<size_t>(col_count); ++j ) {
-				exporter::get_text(stmt, static_cast<int>(j), data);
-				custom_column_data[j] = wcsdup(MB2Wide(data.c_str()).c_str());
-			}
+		plan_before += item.plan_before;
+		plan_after += item.plan_after;
+	}
+	if( indexes.empty() ) {
+		const wchar_t* msg[] = {GetMsg(ps_adv_title), GetMsg(ps_adv_none), query_descr.c_str()};
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_MB_OK, nullptr, msg, sizeof(msg) / sizeof(msg[0]), 0);
+		return;
+	}
+	if( indexes.size() > ADVISE_MAX_INDEXES )
+		indexes.resize(ADVISE_MAX_INDEXES);
+
+	//Dialog texts (items keep pointers): indexes, plan lines cut to dialog width
+	const size_t text_width = ADVISE_DLG_WIDTH - 10;
+	std::vector<std::wstring> texts;
+	for( const auto & index : indexes )
+		texts.push_back(MB2Wide(index.c_str()).substr(0, text_width - 4));
+	size_t plan_pos[3];
+	plan_pos[0] = texts.size();
+	for( size_t n = 0; n < 2; ++n ) {
+		const std::string & plan = n ? plan_after : plan_before;
+		size_t lines = 0;
+		for( size_t pos = 0; pos < plan.size() && lines < ADVISE_PLAN_LINES; ++lines ) {
+			size_t end = plan.find('\n', pos);
+			if( end == std::string::npos )
+				end = plan.size();
+			texts.push_back(MB2Wide(plan.substr(pos, end - pos).c_str()).substr(0, text_width));
+			pos = end + 1;
 		}
-		item.CustomColumnData = custom_column_data;
-		item.CustomColumnNumber = col_count;
-		buff.push_back(item);
+		plan_pos[n + 1] = texts.size();
 	}
 
-	if( state != SQLITE_DONE ) {
-		prg_wnd.hide();
+	std::vector<FarDialogItem> dlg_items;
+	auto add_item = [&dlg_items](int type, int y, const wchar_t * text) -> FarDialogItem & {
+		FarDialogItem item;
+		memset(&item, 0, sizeof(item));
+		item.Type = type;
+		item.X1 = 5;
+		item.X2 = ADVISE_DLG_WIDTH - 6;
+		item.Y1 = y;
+		item.PtrData = text;
+		dlg_items.push_back(item);
+		return dlg_items.back();
+	};
+	FarDialogItem & box = add_item(DI_DOUBLEBOX, 1, GetMsg(ps_adv_title));
+	box.X1 = 3;
+	box.X2 = ADVISE_DLG_WIDTH - 4;
+	int y = 2;
+	for( size_t i = 0; i < plan_pos[0]; ++i )
+		add_item(DI_CHECKBOX, y++, texts[i].c_str()).Selected = 1;
+	add_item(DI_TEXT, y++, nullptr).Flags = DIF_SEPARATOR;
+	add_item(DI_TEXT, y++, GetMsg(ps_adv_before));
+	for( size_t i = plan_pos[0]; i < plan_pos[1]; ++i )
+		add_item(DI_TEXT, y++, texts[i].c_str());
+	add_item(DI_TEXT, y++, GetMsg(ps_adv_after));
+	for( size_t i = plan_pos[1]; i < plan_pos[2]; ++i )
+		add_item(DI_TEXT, y++, texts[i].c_str());
+	add_item(DI_TEXT, y++, nullptr).Flags = DIF_SEPARATOR;
+	const int create_id = static_cast<int>(dlg_items.size());
+	FarDialogItem & create = add_item(DI_BUTTON, y, GetMsg(ps_adv_create));
+	create.Flags = DIF_CENTERGROUP;
+	create.Focus = 1;
+	create.DefaultButton = 1;
+	add_item(DI_BUTTON, y++, GetMsg(ps_cancel)).Flags = DIF_CENTERGROUP;
+	dlg_items[0].Y2 = y;
+
+	const HANDLE dlg = Plugin::psi.DialogInit(Plugin::psi.ModuleNumber, -1, -1, ADVISE_DLG_WIDTH, y + 2, nullptr, dlg_items.data(), dlg_items.size(), 0, 0, nullptr, (LONG_PTR)0);
+	const intptr_t rc = Plugin::psi.DialogRun(dlg);
+	std::vector<std::string> selected;
+	for( size_t i = 0; rc == create_id && i < indexes.size(); ++i ) {
+		if( Plugin::psi.SendDlgMessage(dlg, DM_GETCHECK, i + 1, (LONG_PTR)0) == BSTATE_CHECKED )
+			selected.push_back(indexes[i]);
+	}
+	Plugin::psi.DialogFree(dlg);
+	if( selected.empty() )
+		return;
 
-		const std::wstring query_descr = MB2Wide(query.c_str());
-		const std::wstring err_descr = db->LastError();
-		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), db->GetDbName().c_str(), query_descr.c_str(), err_descr.c_str()};
-		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+	//Running query reader would block index creation
+	if( !finished ) {
+		executor.reset();
+		finished = true;
+	}
 
-		auto itemsNumber = buff.size();
-		PluginPanelItem * panelItem = &buff.front();
-		while( itemsNumber-- ) {
-			while( (panelItem+itemsNumber)->CustomColumnNumber-- )
-				free((void *)(panelItem+itemsNumber)->CustomColumnData[(panelItem+itemsNumber)->CustomColumnNumber]);
-			free((void *)(panelItem+itemsNumber)->CustomColumnData);
+	progress prg_wnd(ps_adv_creating, selected.size());
+	SQLiteDB::CancelScope cancel(*db, progress::aborted);
+	for( size_t i = 0; i < selected.size(); ++i ) {
+		prg_wnd.update(i, MB2Wide(selected[i].c_str()));
+		if( !db->ExecuteQuery(selected[i].c_str()) ) {
+			prg_wnd.hide();
+			if( cancel.Cancelled() )
+				break;
+			const std::wstring index_descr = MB2Wide(selected[i].c_str());
+			const std::wstring err_descr = db->LastError();
+			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_sql), db->GetDbName().c_str(), index_descr.c_str(), err_descr.c_str()};
+			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+			break;
 		}
-		return int(false);
 	}
+	prg_wnd.hide();
 
-	*pItemsNumber = buff.size();
+	//Database is changed: query is executed again with new indexes
+	Plugin::psi.Control(hPlugin, FCTL_UPDATEPANEL, TRUE, 0);
+	Plugin::psi.Control(hPlugin, FCTL_REDRAWPANEL, 0, 0);
+}
 
-	if( buff.size() >= INT32_MAX )
-		*pItemsNumber = INT32_MAX;
-	else
-		*pItemsNumber = buff.size();
+int SqlitePanelQuery::ProcessEvent(HANDLE hPlugin, int event, void * param)
+{
+	// append rows received while user works with panel
+	if( event == FE_IDLE && ReceiveRows() ) {
+		Plugin::psi.Control(hPlugin, FCTL_UPDATEPANEL, TRUE, 0);
+		Plugin::psi.Control(hPlugin, FCTL_REDRAWPANEL, 0, 0);
+	}
+	return int(false);
+}
 
-	*pPanelItem = (struct PluginPanelItem *)malloc((*pItemsNumber) * sizeof(PluginPanelItem));
+int SqlitePanelQuery::GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber)
+{
+	LOG_INFO("select %s\n", query.c_str());
 
-	if( *pPanelItem )
-		memmove(*pPanelItem, &buff.front(), sizeof(PluginPanelItem) * (*pItemsNumber));
-	else {
+	//Rerun query on refresh or if database was changed (panel re-entry keeps rows)
+	SQLiteDB::db_version version;
+	if( refresh || (db->GetVersion(version) && version != result->version) ) {
+		LOG_INFO("refresh or database changed, rerun query\n");
+		Execute(false);
+	}
+
+	//Wait a bit for the first rows
+	const auto wait_end = std::chrono::steady_clock::now() + std::chrono::milliseconds(FIRST_ROWS_WAIT_MS);
+	ReceiveRows();
+	while( !finished && result->rows == 0 && std::chrono::steady_clock::now() < wait_end ) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		ReceiveRows();
+	}
+
+	struct arena * a = arena_create(0);
+	const size_t items_count = std::min(result->rows + 1, static_cast<size_t>(INT32_MAX));
+	*pPanelItem = a ? (struct PluginPanelItem *)arena_alloc(a, items_count * sizeof(PluginPanelItem)) : nullptr;
+	if( !*pPanelItem ) {
+		arena_destroy(a);
 		*pItemsNumber = 0;
+		return int(false);
+	}
+	memset(*pPanelItem, 0, items_count * sizeof(PluginPanelItem));
+	BindFindDataArena(*pPanelItem, a);
 
-		auto itemsNumber = buff.size();
-		PluginPanelItem * panelItem = &buff.front();
-		while( itemsNumber-- ) {
-			while( (panelItem+itemsNumber)->CustomColumnNumber-- )
-				free((void *)(panelItem+itemsNumber)->CustomColumnData[(panelItem+itemsNumber)->CustomColumnNumber]);
-			free((void *)(panelItem+itemsNumber)->CustomColumnData);
+	const static wchar_t * dots = L"..";
+	//All dots (..)
+	PluginPanelItem * pi = *pPanelItem;
+	pi->FindData.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+	pi->FindData.lpwszFileName = dots;
+	const size_t col_num = columns.size();
+	const wchar_t ** customColumnData = (const wchar_t **)arena_alloc(a, col_num*sizeof(const wchar_t *));
+	if( customColumnData ) {
+		for( size_t j = 0; j < col_num; ++j )
+			customColumnData[j] = dots;
+		pi->CustomColumnNumber = col_num;
+		pi->CustomColumnData = customColumnData;
+	}
+	pi++;
+
+	//Rows are owned by result (batches), items only point to them
+	//(columns can change on rerun after schema change)
+	const size_t row_col_num = std::min(col_num, result->columns.size());
+	size_t n = 1;
+	for( auto batch : result->batches ) {
+		for( auto row : batch->rows ) {
+			if( n >= items_count )
+				break;
+			pi->CustomColumnData = row;
+			pi->CustomColumnNumber = row_col_num;
+			pi++;
+			n++;
 		}
 	}
 
+	*pItemsNumber = static_cast<int>(items_count);
 	return int(true);
 }
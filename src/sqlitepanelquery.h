@@ -3,6 +3,7 @@
 
 #include "plugin.h"
 #include "sqlite/sqlitedb.h"
+#include "queryexecutor.h"
 #include <memory>
 
 class SqlitePanelQuery : public FarPanel
@@ -18,18 +19,35 @@ private:
 	std::wstring widths;
 	SQLiteDB::sq_columns columns;
 
+	std::unique_ptr<QueryExecutor> executor;
+	std::shared_ptr<QueryExecutor::query_result> result;	///< Rows received from executor
+	bool finished;
+	bool refresh;	///< Ctrl+R pressed, run query again on next GetFindData
+	bool profile;	///< Profile next query run
+
+	// start query, false on error
+	bool Execute(bool wait_columns);
+	// get rows from executor, true if panel should be updated
+	bool ReceiveRows(void);
+	// suggest indexes for the query and create selected ones
+	void AdviseIndexes(HANDLE hPlugin);
+
 	// copy and assignment not allowed
 	SqlitePanelQuery(const SqlitePanelQuery&) = delete;
 	void operator=(const SqlitePanelQuery&) = delete;
 
 public:
 	int ProcessKey(HANDLE hPlugin, int key, unsigned int controlState, bool & change) override;
+	int ProcessEvent(HANDLE hPlugin, int event, void * param) override;
 	int GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber) override;
 	void GetOpenPluginInfo(struct OpenPluginInfo * info) override;
- 	explicit SqlitePanelQuery(PanelIndex index_, std::unique_ptr<SQLiteDB> & db, const char * query);
+ 	explicit SqlitePanelQuery(PanelIndex index_, std::unique_ptr<SQLiteDB> & db, const char * query, bool profile = false);
 	virtual ~SqlitePanelQuery();
 
 	bool Valid(void) override;
+
+	// show statements profile in viewer and append it to profile log
+	static void ShowProfile(const std::wstring & db_filename, const std::string & report);
 };
 
 
@@ -0,0 +1,111 @@
+#include "sqlitepanelspace.h"
+#include "progress.h"
+
+#include <common/log.h>
+#include <common/arena.h>
+#include <sqlite/sqlite.h>
+#include <utils.h>
+
+extern const char * LOG_FILE;
+#define LOG_SOURCE_FILE "sqlitepanelspace.cpp"
+
+bool SqlitePanelSpace::Valid(void)
+{
+	return valid;
+}
+
+SqlitePanelSpace::SqlitePanelSpace(PanelIndex index_, std::unique_ptr<SQLiteDB> & _db):
+	FarPanel(index_),
+	db(_db),
+	valid(false)
+{
+	LOG_INFO("\n");
+	memset(&version, 0, sizeof(version));
+	valid = Read();
+}
+
+SqlitePanelSpace::~SqlitePanelSpace()
+{
+	LOG_INFO("\n");
+}
+
+bool SqlitePanelSpace::Read(void)
+{
+	db->GetVersion(version);
+	progress prg_wnd(ps_space_reading);
+	SQLiteDB::CancelScope cancel(*db, progress::aborted);
+	if( db->GetSpaceUsage(objects) )
+		return true;
+
+	prg_wnd.hide();
+	if( !cancel.Cancelled() ) {
+		const std::wstring err_descr = db->LastError();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), db->GetDbName().c_str(), err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+	}
+	return false;
+}
+
+void SqlitePanelSpace::GetOpenPluginInfo(struct OpenPluginInfo * info)
+{
+	LOG_INFO("\n");
+	FarPanel::GetOpenPluginInfo(info);
+	title = info->PanelTitle;
+	title += db->GetDbName();
+	title += L" [" SPACE_DIR_NAME L"]";
+	info->PanelTitle = title.c_str();
+}
+
+int SqlitePanelSpace::ProcessKey(HANDLE hPlugin, int key, unsigned int controlState, bool & change)
+{
+	LOG_INFO("\n");
+	return IsPanelProcessKey(key, controlState);
+}
+
+int SqlitePanelSpace::GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber)
+{
+	LOG_INFO("\n");
+
+	//Read again if database was changed (previous result is shown on error or cancel)
+	SQLiteDB::db_version current;
+	if( db->GetVersion(current) && current != version ) {
+		LOG_INFO("database changed, read space usage\n");
+		Read();
+	}
+
+	struct arena * a = arena_create(0);
+	*pPanelItem = a ? (struct PluginPanelItem *)arena_alloc(a, objects.size() * sizeof(PluginPanelItem)) : nullptr;
+	if( !*pPanelItem ) {
+		arena_destroy(a);
+		*pItemsNumber = 0;
+		return int(false);
+	}
+	memset(*pPanelItem, 0, objects.size() * sizeof(PluginPanelItem));
+	BindFindDataArena(*pPanelItem, a);
+
+	PluginPanelItem * pi = *pPanelItem;
+	wchar_t number[32];
+	for( const auto & item : objects ) {
+		const wchar_t ** customColumnData = (const wchar_t **)arena_alloc(a, SpaceColumnMaxIndex*sizeof(const wchar_t *));
+		pi->FindData.lpwszFileName = arena_wcsdup(a, MB2Wide(item.name.c_str()).c_str());
+		if( !customColumnData || !pi->FindData.lpwszFileName )
+			break;
+		pi->FindData.nFileSize = item.size;
+		pi->FindData.nPhysicalSize = item.type;
+
+		customColumnData[SpaceColumnTypeIndex] = db->ObjectNameByType(item.type);
+		customColumnData[SpaceColumnPagesIndex] = arena_wcsdup(a, std::to_wstring(item.pages).c_str());
+		customColumnData[SpaceColumnPayloadIndex] = arena_wcsdup(a, std::to_wstring(item.payload).c_str());
+		customColumnData[SpaceColumnUnusedIndex] = arena_wcsdup(a, std::to_wstring(item.unused).c_str());
+		customColumnData[SpaceColumnOverflowIndex] = arena_wcsdup(a, std::to_wstring(item.overflow_pages).c_str());
+		swprintf(number, sizeof(number) / sizeof(number[0]), L"%.2f", item.fanout);
+		customColumnData[SpaceColumnFanoutIndex] = item.fanout ? arena_wcsdup(a, number) : L"";
+		swprintf(number, sizeof(number) / sizeof(number[0]), L"%.1f", item.fragmentation);
+		customColumnData[SpaceColumnFragmentationIndex] = arena_wcsdup(a, number);
+		pi->CustomColumnNumber = SpaceColumnMaxIndex;
+		pi->CustomColumnData = customColumnData;
+		pi++;
+	}
+	*pItemsNumber = pi - *pPanelItem;
+	return int(true);
+}
@@ -0,0 +1,50 @@
+#ifndef __SQLITEPANELSPACE_H__
+#define __SQLITEPANELSPACE_H__
+
+#include "plugin.h"
+#include "sqlite/sqlitedb.h"
+#include <memory>
+
+// Virtual directory of database panel with space usage of objects
+#define SPACE_DIR_NAME L"<space>"
+
+enum {
+	SpaceColumnTypeIndex,
+	SpaceColumnPagesIndex,
+	SpaceColumnPayloadIndex,
+	SpaceColumnUnusedIndex,
+	SpaceColumnOverflowIndex,
+	SpaceColumnFanoutIndex,
+	SpaceColumnFragmentationIndex,
+	SpaceColumnMaxIndex
+};
+
+class SqlitePanelSpace : public FarPanel
+{
+private:
+	std::unique_ptr<SQLiteDB> & db;
+
+	std::wstring title;
+	SQLiteDB::sq_spaces objects;	///< Last read space usage
+	SQLiteDB::db_version version;	///< Database version of the last read
+	bool valid;
+
+	// read space usage from dbstat (cancellable), false on error or cancel
+	bool Read(void);
+
+	// copy and assignment not allowed
+	SqlitePanelSpace(const SqlitePanelSpace&) = delete;
+	void operator=(const SqlitePanelSpace&) = delete;
+
+public:
+	int ProcessKey(HANDLE hPlugin, int key, unsigned int controlState, bool & change) override;
+	int GetFindData(struct PluginPanelItem **pPanelItem, int *pItemsNumber) override;
+	void GetOpenPluginInfo(struct OpenPluginInfo * info) override;
+ 	explicit SqlitePanelSpace(PanelIndex index_, std::unique_ptr<SQLiteDB> & db);
+	virtual ~SqlitePanelSpace();
+
+	bool Valid(void) override;
+};
+
+
+#endif // __SQLITEPANELSPACE__
@@ -2,15 +2,51 @@
 #include "fardialog.h"
 #include "progress.h"
 #include "exporter.h"
+#include "importer.h"
 #include "editor.h"
 
 #include <common/log.h>
+#include <common/arena.h>
 #include <sqlite/sqlite.h>
 #include <utils.h>
 
 extern const char * LOG_FILE;
 #define LOG_SOURCE_FILE "sqlitepaneltable.cpp"
 
+static void FillDotsItem(PluginPanelItem * pi, const size_t col_num, struct arena * a)
+{
+	const static wchar_t * dots = L"..";
+
+	pi->FindData.lpwszFileName = dots;
+	pi->FindData.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+
+	const wchar_t ** customColumnData = (const wchar_t **)arena_alloc(a, col_num*sizeof(const wchar_t *));
+	if( customColumnData ) {
+		for( size_t j = 0; j < col_num; ++j )
+			customColumnData[j] = dots;
+		pi->CustomColumnNumber = col_num;
+		pi->CustomColumnData = customColumnData;
+	}
+}
+
+// return memory used by item
+static size_t FillRowItem(PluginPanelItem * pi, const sqlite_statement & stmt, const size_t col_num, struct arena * a)
+{
+	size_t bytes = sizeof(PluginPanelItem) + col_num*sizeof(const wchar_t *);
+	const wchar_t ** customColumnData = (const wchar_t **)arena_alloc(a, col_num*sizeof(const wchar_t *));
+	if( customColumnData ) {
+		size_t len = 0;
+		for( size_t j = 0; j < col_num; ++j ) {
+			customColumnData[j] = exporter::get_text(stmt, static_cast<int>(j) + 1 /* rowid */, a, len);
+			bytes += (len + 1) * sizeof(wchar_t);
+		}
+		pi->FindData.nPhysicalSize = stmt.get_int64(0);
+		pi->CustomColumnNumber = col_num;
+		pi->CustomColumnData = customColumnData;
+	}
+	return bytes;
+}
+
 bool SqlitePanelTable::Valid(void)
 {
 	return columns.size() != 0;
@@ -18,7 +54,11 @@ bool SqlitePanelTable::Valid(void)
 
 SqlitePanelTable::SqlitePanelTable(PanelIndex index_, std::unique_ptr<SQLiteDB> & _db, const wchar_t * dir):
 	FarPanel(index_),
-	db(_db)
+	db(_db),
+	paged(false),
+	eof(false),
+	last_rowid(0),
+	row_bytes(0)
 {
 	object = dir;
 	columns.clear();
@@ -55,7 +95,20 @@ SqlitePanelTable::SqlitePanelTable(PanelIndex index_, std::unique_ptr<SQLiteDB>
 	nmodes[5].ColumnWidths = widths.c_str();
 	nmodes[5].ColumnTitles = columnTitles.data();
 
-	LOG_INFO("\n");
+	//Column can hide rowid name, other aliases are used then
+	const char * alias = SQLiteDB::RowidAlias(columns);
+	rowid = alias ? alias : "";
+
+	//Keyset paging requires rowid (not available for WITHOUT ROWID tables)
+	if( PluginCfg::tablePageSize && !rowid.empty() ) {
+		std::string query = "select " + rowid + " from '";
+		query += Wide2MB(dir);
+		query += "' limit 0";
+		sqlite_statement stmt(db->GetDb());
+		paged = stmt.prepare(query.c_str()) == SQLITE_OK;
+	}
+
+	LOG_INFO("paged %d rowid %s\n", paged, rowid.c_str());
 }
 
 SqlitePanelTable::~SqlitePanelTable()
@@ -79,20 +132,65 @@ int SqlitePanelTable::ProcessKey(HANDLE hPlugin, int key, unsigned int controlSt
 {
 	LOG_INFO("\n");
 
+	//Move window to the neighbouring page when cursor leaves it
+	if( paged && controlState == 0 && (key == VK_DOWN || key == VK_NEXT || key == VK_UP || key == VK_PRIOR) ) {
+		PanelInfo pi = {0};
+		GetPanelInfo(pi);
+		size_t shift = 0;
+		int current = -1;
+		if( (key == VK_DOWN || key == VK_NEXT) && pi.CurrentItem == pi.ItemsNumber - 1 && NextPage(shift) )
+			current = pi.CurrentItem - static_cast<int>(shift);
+		else if( (key == VK_UP || key == VK_PRIOR) && pi.CurrentItem <= 1 && PrevPage(shift) )
+			current = pi.CurrentItem + static_cast<int>(shift);
+		if( current >= 0 ) {
+			PanelRedrawInfo pri;
+			pri.CurrentItem = current;
+			pri.TopPanelItem = pi.TopPanelItem + current - pi.CurrentItem;
+			if( pri.TopPanelItem < 0 )
+				pri.TopPanelItem = 0;
+			Plugin::psi.Control(hPlugin, FCTL_UPDATEPANEL, TRUE, 0);
+			Plugin::psi.Control(hPlugin, FCTL_REDRAWPANEL, 0, (LONG_PTR)&pri);
+		}
+		//Cursor movement is done by far2l
+		return int(false);
+	}
+
+	//First/last page of the table
+	if( paged && controlState == 0 && ((key == VK_HOME && FirstPage()) || (key == VK_END && LastPage())) ) {
+		Plugin::psi.Control(hPlugin, FCTL_UPDATEPANEL, TRUE, 0);
+		Plugin::psi.Control(hPlugin, FCTL_REDRAWPANEL, 0, 0);
+		//Cursor movement is done by far2l
+		return int(false);
+	}
+
+	//F3 (view blob of row)
+	if( controlState == 0 && key == VK_F3 ) {
+		editor re(db, Wide2MB(object.c_str()).c_str(), RowidName());
+		if( re.view_blob() )
+			return int(true);
+	}
+
 	//F4 (edit row)
 	if( controlState == 0 && (key == VK_F4 || key == VK_RETURN) ) {
-		editor re(db, Wide2MB(object.c_str()).c_str());
+		editor re(db, Wide2MB(object.c_str()).c_str(), RowidName());
 		re.update();
 		return int(true);
 	}
 
 	//Shift+F4 (insert row)
 	if( controlState == PKF_SHIFT && key == VK_F4 ) {
-		editor re(db, Wide2MB(object.c_str()).c_str());
+		editor re(db, Wide2MB(object.c_str()).c_str(), RowidName());
 		re.insert();
 		return int(true);
 	}
 
+	//Shift+F5 (import CSV into table)
+	if( controlState == PKF_SHIFT && key == VK_F5 ) {
+		importer im(db);
+		im.import_data(object.c_str());
+		return int(true);
+	}
+
 	return IsPanelProcessKey(key, controlState);
 }
 
@@ -100,104 +198,287 @@ int SqlitePanelTable::GetFindData(struct PluginPanelItem **pPanelItem, int *pIte
 {
 	LOG_INFO("\n");
 
-	const static wchar_t * dots = L"..";
+	if( paged )
+		return GetWindowData(pPanelItem, pItemsNumber);
+
+	// estimate is used for progress only, rows are read in a single pass
+	uint64_t row_estimate = 0;
+	if( !db->GetRowCountEstimate(Wide2MB(object.c_str()).c_str(), row_estimate) )
+		row_estimate = 0;
 
-	uint64_t row_count = 0;
-	if( !db->GetRowCount(Wide2MB(object.c_str()).c_str(), row_count) ) {
+	progress prg_wnd(ps_reading, row_estimate);
+	SQLiteDB::CancelScope cancel(*db, progress::aborted);
+
+	std::string query = "select " + std::string(RowidName()) + ",* from '";
+	query += Wide2MB(object.c_str());
+	query += '\'';
+	sqlite_statement stmt(db->GetDb());
+	if (stmt.prepare(query.c_str()) != SQLITE_OK) {
+		prg_wnd.hide();
 		const std::wstring err_descr = db->LastError();
 		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), db->GetDbName().c_str(), err_descr.c_str() };
 		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		*pPanelItem = 0;
+		*pItemsNumber = 0;
 		return int(false);
 	}
 
-	if( row_count >= INT32_MAX )
-		row_count = INT32_MAX;
-
-	progress prg_wnd(ps_reading, row_count);
+	struct arena * a = arena_create(0);
+	if( !a ) {
+		*pPanelItem = 0;
+		*pItemsNumber = 0;
+		return int(false);
+	}
 
-	*pItemsNumber = static_cast<int>(row_count)+1;
-	*pPanelItem = (struct PluginPanelItem *)malloc((*pItemsNumber) * sizeof(PluginPanelItem));
-	memset(*pPanelItem, 0, (*pItemsNumber) * sizeof(PluginPanelItem));
-	PluginPanelItem * pi = *pPanelItem;
 	const size_t col_num = columns.size();
 
-	pi->FindData.lpwszFileName = dots;
-	pi->FindData.dwFileAttributes = FILE_ATTRIBUTE_DIRECTORY;
+	// items are collected in chunks, then copied once into contiguous array
+	std::deque<PluginPanelItem> items;
+	items.emplace_back();
+	memset(&items.back(), 0, sizeof(PluginPanelItem));
+	FillDotsItem(&items.back(), col_num, a);
 
-	const wchar_t ** customColumnData = (const wchar_t **)malloc(col_num*sizeof(const wchar_t *));
-	if( customColumnData ) {
-		memset(customColumnData, 0, col_num*sizeof(const wchar_t *));
-		for( size_t j = 0; j < col_num; ++j )
-			customColumnData[j] = wcsdup(dots);
-		pi->FindData.nPhysicalSize = 0;
-		pi->CustomColumnNumber = col_num;
-		pi->CustomColumnData = customColumnData;
+	int state = SQLITE_OK;
+	while( items.size() < INT32_MAX && (state = stmt.step_execute()) == SQLITE_ROW ) {
+
+		if( items.size() % 100 == 0 ) {
+			prg_wnd.update(items.size());
+			if( progress::aborted() )
+				break;	//Show incomplete data
+		}
+
+		items.emplace_back();
+		memset(&items.back(), 0, sizeof(PluginPanelItem));
+		FillRowItem(&items.back(), stmt, col_num, a);
 	}
-	pi++;
 
-	std::string query = "select rowid,* from '";
-	query += Wide2MB(object.c_str());
-	query += '\'';
-	sqlite_statement stmt(db->GetDb());
-	if (stmt.prepare(query.c_str()) != SQLITE_OK) {
+	if( state != SQLITE_ROW && state != SQLITE_DONE && !cancel.Cancelled() ) {
 		prg_wnd.hide();
 		const std::wstring err_descr = db->LastError();
 		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), db->GetDbName().c_str(), err_descr.c_str() };
 		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
-		FreeFindData(*pPanelItem, *pItemsNumber);
+		arena_destroy(a);
 		*pPanelItem = 0;
 		*pItemsNumber = 0;
 		return int(false);
 	}
 
-	uint64_t i = 0;
+	*pPanelItem = (struct PluginPanelItem *)arena_alloc(a, items.size() * sizeof(PluginPanelItem));
+	if( !*pPanelItem ) {
+		arena_destroy(a);
+		*pItemsNumber = 0;
+		return int(false);
+	}
+	std::copy(items.begin(), items.end(), *pPanelItem);
+	*pItemsNumber = static_cast<int>(items.size());
+	BindFindDataArena(*pPanelItem, a);
 
-	while( row_count-- ) {
+	prg_wnd.update(row_estimate);
 
-		if( i % 100 == 0 )
-			prg_wnd.update(i);
+	return int(true);
+}
 
-		i++;
+int SqlitePanelTable::DeleteFiles(struct PluginPanelItem *panelItem, int itemsNumber, int opMode)
+{
+	LOG_INFO("\n");
+	editor ed(db, Wide2MB(object.c_str()).c_str(), RowidName());
+	return ed.remove(panelItem, itemsNumber);
+}
 
-		if( stmt.step_execute() != SQLITE_ROW ) {
-			prg_wnd.hide();
-			const std::wstring err_descr = db->LastError();
-			const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), db->GetDbName().c_str(), err_descr.c_str() };
-			Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
-			FreeFindData(*pPanelItem, *pItemsNumber);
-			*pPanelItem = 0;
-			*pItemsNumber = 0;
-			return int(false);
-		}
+size_t SqlitePanelTable::MaxWindowPages(void) const
+{
+	const uint64_t page_bytes = static_cast<uint64_t>(PluginCfg::tablePageSize) * (row_bytes ? row_bytes:1);
+	const uint64_t limit = static_cast<uint64_t>(PluginCfg::tableMemoryLimit) * 1024 * 1024;
+	return limit > page_bytes ? static_cast<size_t>(limit / page_bytes):1;
+}
 
-		if( progress::aborted() ) {
-			*pItemsNumber = static_cast<int>(i);
-			return true;	//Show incomplete data
-		}
+bool SqlitePanelTable::NextPage(size_t & evicted)
+{
+	if( eof || window.empty() || last_rowid == INT64_MAX )
+		return false;
 
-		const wchar_t ** customColumnData = (const wchar_t **)malloc(col_num*sizeof(const wchar_t *));
-		if( customColumnData ) {
-			memset(customColumnData, 0, col_num*sizeof(const wchar_t *));
-			std::string data;
-			for( size_t j = 0; j < col_num; ++j ) {
-				exporter::get_text(stmt, static_cast<int>(j) + 1 /* rowid */, data);
-				customColumnData[j] = wcsdup(MB2Wide(data.c_str()).c_str());
-			}
-			pi->FindData.nPhysicalSize = stmt.get_int64(0);
-			pi->CustomColumnNumber = col_num;
-			pi->CustomColumnData = customColumnData;
-		}
-		pi++;
+	window.push_back({last_rowid + 1, 0});
+
+	evicted = 0;
+	while( window.size() > MaxWindowPages() ) {
+		evicted += window.front().rows;
+		window.pop_front();
 	}
+	LOG_INFO("first rowid %lld pages %zu evicted %zu\n", static_cast<long long>(window.front().first_rowid), window.size(), evicted);
+	return true;
+}
 
-	prg_wnd.update(i+row_count);
+bool SqlitePanelTable::PrevPage(size_t & added)
+{
+	if( window.empty() )
+		return false;
 
-	return int(true);
+	std::string query = "select min(" + rowid + "), count(*) from (select " + rowid + " from '";
+	query += Wide2MB(object.c_str());
+	query += "' where " + rowid + "<? order by " + rowid + " desc limit ?)";
+
+	sqlite_statement stmt(db->GetDb());
+	if( stmt.prepare(query.c_str()) != SQLITE_OK ||
+		stmt.bind(1, static_cast<sqlite3_int64>(window.front().first_rowid)) != SQLITE_OK ||
+		stmt.bind(2, static_cast<int>(PluginCfg::tablePageSize)) != SQLITE_OK ||
+		stmt.step_execute() != SQLITE_ROW ) {
+		LOG_ERROR("%s ... %S\n", query.c_str(), db->LastError().c_str());
+		return false;
+	}
+
+	added = static_cast<size_t>(stmt.get_int64(1));
+	if( !added )
+		return false;
+
+	window.push_front({stmt.get_int64(0), added});
+
+	while( window.size() > MaxWindowPages() ) {
+		window.pop_back();
+		eof = false;
+	}
+	LOG_INFO("first rowid %lld pages %zu added %zu\n", static_cast<long long>(window.front().first_rowid), window.size(), added);
+	return true;
 }
 
-int SqlitePanelTable::DeleteFiles(struct PluginPanelItem *panelItem, int itemsNumber, int opMode)
+bool SqlitePanelTable::FirstPage(void)
 {
-	LOG_INFO("\n");
-	editor ed(db, Wide2MB(object.c_str()).c_str());
-	return ed.remove(panelItem, itemsNumber);
+	if( window.empty() )
+		return false;
+
+	std::string query = "select min(" + rowid + ") from '";
+	query += Wide2MB(object.c_str());
+	query += '\'';
+
+	sqlite_statement stmt(db->GetDb());
+	if( stmt.prepare(query.c_str()) != SQLITE_OK || stmt.step_execute() != SQLITE_ROW ) {
+		LOG_ERROR("%s ... %S\n", query.c_str(), db->LastError().c_str());
+		return false;
+	}
+	//Window already starts with the first row (or table is empty)
+	if( stmt.column_type(0) == SQLITE_NULL || window.front().first_rowid <= stmt.get_int64(0) )
+		return false;
+
+	window.assign(1, {INT64_MIN, 0});
+	eof = false;
+	LOG_INFO("first page\n");
+	return true;
+}
+
+bool SqlitePanelTable::LastPage(void)
+{
+	if( eof || window.empty() )
+		return false;
+
+	std::string query = "select min(" + rowid + "), count(*) from (select " + rowid + " from '";
+	query += Wide2MB(object.c_str());
+	query += "' order by " + rowid + " desc limit ?)";
+
+	sqlite_statement stmt(db->GetDb());
+	if( stmt.prepare(query.c_str()) != SQLITE_OK ||
+		stmt.bind(1, static_cast<int>(PluginCfg::tablePageSize)) != SQLITE_OK ||
+		stmt.step_execute() != SQLITE_ROW ) {
+		LOG_ERROR("%s ... %S\n", query.c_str(), db->LastError().c_str());
+		return false;
+	}
+	if( stmt.get_int64(1) == 0 )
+		return false;
+
+	window.assign(1, {stmt.get_int64(0), static_cast<size_t>(stmt.get_int64(1))});
+	eof = true;
+	LOG_INFO("last page, first rowid %lld\n", static_cast<long long>(window.front().first_rowid));
+	return true;
+}
+
+int SqlitePanelTable::GetWindowData(struct PluginPanelItem **pPanelItem, int *pItemsNumber)
+{
+	const size_t page_size = PluginCfg::tablePageSize;
+
+	if( window.empty() )
+		window.push_back({INT64_MIN, 0});
+
+	const size_t max_rows = page_size * window.size();
+
+	//One extra row shows that the window doesn't reach the end of the table
+	std::string query = "select " + rowid + ",* from '";
+	query += Wide2MB(object.c_str());
+	query += "' where " + rowid + ">=? order by " + rowid + " limit ?";
+	sqlite_statement stmt(db->GetDb());
+	if( stmt.prepare(query.c_str()) != SQLITE_OK ||
+		stmt.bind(1, static_cast<sqlite3_int64>(window.front().first_rowid)) != SQLITE_OK ||
+		stmt.bind(2, static_cast<sqlite3_int64>(max_rows + 1)) != SQLITE_OK ) {
+		const std::wstring err_descr = db->LastError();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), db->GetDbName().c_str(), err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		return int(false);
+	}
+
+	progress prg_wnd(ps_reading, max_rows);
+	SQLiteDB::CancelScope cancel(*db, progress::aborted);
+
+	struct arena * a = arena_create(0);
+	*pPanelItem = a ? (struct PluginPanelItem *)arena_alloc(a, (max_rows + 1) * sizeof(PluginPanelItem)):nullptr;
+	if( !*pPanelItem ) {
+		arena_destroy(a);
+		*pItemsNumber = 0;
+		return int(false);
+	}
+	memset(*pPanelItem, 0, (max_rows + 1) * sizeof(PluginPanelItem));
+	BindFindDataArena(*pPanelItem, a);
+	*pItemsNumber = 1;
+
+	PluginPanelItem * pi = *pPanelItem;
+	const size_t col_num = columns.size();
+
+	FillDotsItem(pi++, col_num, a);
+
+	size_t row = 0;
+	uint64_t bytes = 0;
+	int state = SQLITE_OK;
+	bool more = false;
+	while( (state = stmt.step_execute()) == SQLITE_ROW ) {
+
+		if( row == max_rows ) {
+			more = true;
+			break;
+		}
+
+		if( row % 100 == 0 )
+			prg_wnd.update(row);
+
+		//Refresh page bounds (rows can be deleted/inserted since last read)
+		auto & pg = window[row / page_size];
+		if( row % page_size == 0 ) {
+			pg.first_rowid = stmt.get_int64(0);
+			pg.rows = 0;
+		}
+		pg.rows++;
+		last_rowid = stmt.get_int64(0);
+
+		bytes += FillRowItem(pi++, stmt, col_num, a);
+		row++;
+	}
+	*pItemsNumber = static_cast<int>(row) + 1;
+
+	if( !more && state != SQLITE_DONE && !cancel.Cancelled() ) {
+		prg_wnd.hide();
+		const std::wstring err_descr = db->LastError();
+		const wchar_t* err_msg[] = {GetMsg(ps_title_short), GetMsg(ps_err_read), db->GetDbName().c_str(), err_descr.c_str() };
+		Plugin::psi.Message(Plugin::psi.ModuleNumber, FMSG_WARNING | FMSG_MB_OK, nullptr, err_msg, sizeof(err_msg) / sizeof(err_msg[0]), 0);
+		FreeFindData(*pPanelItem, *pItemsNumber);
+		*pPanelItem = 0;
+		*pItemsNumber = 0;
+		return int(false);
+	}
+
+	eof = !more && !cancel.Cancelled();
+
+	//Drop pages which became empty
+	while( window.size() > 1 && window.back().rows == 0 )
+		window.pop_back();
+
+	if( row )
+		row_bytes = static_cast<size_t>(bytes / row);
+
+	LOG_INFO("rows %zu pages %zu row_bytes %zu eof %d\n", row, window.size(), row_bytes, eof);
+	return int(true);
 }
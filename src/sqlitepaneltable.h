@@ -4,6 +4,7 @@
 #include "plugin.h"
 #include "sqlite/sqlitedb.h"
 #include <memory>
+#include <deque>
 
 class SqlitePanelTable : public FarPanel
 {
@@ -17,6 +18,28 @@ private:
 	std::wstring widths;
 	SQLiteDB::sq_columns columns;
 
+	//! Keyset page (rowid range) of the table window
+	struct page {
+		int64_t first_rowid;	///< First rowid of the page
+		size_t rows;		///< Number of rows in the page
+	};
+
+	std::string rowid;		///< Rowid alias not hidden by column name
+	bool paged;			///< Paged mode (only window of pages in memory)
+	bool eof;			///< Window contains last page of the table
+	int64_t last_rowid;		///< Last rowid of the window
+	size_t row_bytes;		///< Average memory usage of panel row
+	std::deque<page> window;	///< Pages loaded to the panel
+
+	// rowid alias for queries ("rowid" if all aliases are hidden by columns)
+	const char * RowidName(void) const { return rowid.empty() ? "rowid" : rowid.c_str(); }
+	size_t MaxWindowPages(void) const;
+	bool NextPage(size_t & evicted);
+	bool PrevPage(size_t & added);
+	bool FirstPage(void);
+	bool LastPage(void);
+	int GetWindowData(struct PluginPanelItem **pPanelItem, int *pItemsNumber);
+
 	// copy and assignment not allowed
 	SqlitePanelTable(const SqlitePanelTable&) = delete;
 	void operator=(const SqlitePanelTable&) = delete;
@@ -19,6 +19,8 @@ enum {
 	MF6SQL,
 
 	MF4Pragma,
+	MF5Import,
+	MF6SQLFile,
 
 	MOk,
 	MCancel,
@@ -45,25 +47,61 @@ enum {
 
 	ps_reading,
 	ps_execsql,
+	ps_blob_read,
+	ps_blob_write,
+	ps_importing,
+	ps_exec_count,
+	ps_adv_creating,
+	ps_space_reading,
 
 	ps_insert_row_title,
 	ps_edit_row_title,
 	ps_drop_question,
+	ps_blob_select,
 
 	ps_exp_title,
 	ps_exp_main,
 	ps_exp_fmt,
 	ps_exp_fmt_text,
+	ps_exp_parts,
+	ps_exp_blobs,
 	ps_exp_exp,
 
+	ps_imp_title,
+	ps_imp_main,
+	ps_imp_table,
+	ps_imp_sep,
+	ps_imp_comma,
+	ps_imp_semicolon,
+	ps_imp_tab,
+	ps_imp_header,
+	ps_imp_fast,
+	ps_imp_imp,
+
+	ps_sqlf_title,
+	ps_sqlf_main,
+	ps_profile_title,
+	ps_adv_title,
+	ps_adv_none,
+	ps_adv_before,
+	ps_adv_after,
+	ps_adv_create,
+
 	ps_err_open,
 	ps_err_read,
 	ps_err_sql,
 	ps_err_readf,
 	ps_err_writef,
+	ps_err_record,
+	ps_imp_committed,
+	ps_tran_open,
 
 	ps_save,
 	ps_cancel,
+	ps_skip,
+	ps_commit,
+	ps_rollback,
+	ps_leave_open,
 
 	MMaxString
 };